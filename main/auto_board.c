@@ -3,12 +3,28 @@
 #include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "auto_board.h"
 #include "auto_board_config.h"
+#include "time_base.h"
+#include "input_ring.h"
+#include "input_debounce.h"
+#include "input_sample.h"
+#include "scan_cycle.h"
+#include "input_counter.h"
+#include "edge_capture.h"
+#include "input_storm.h"
+#include "hotpath_audit.h"
+#include "output_image.h"
+#include "output_sched.h"
+#include "output_duty.h"
+#include "output_guard.h"
+#include "output_arbiter.h"
+#include "schedule.h"
+#include "retain.h"
+#include "logic_vm.h"
 
 // Fallback definition for IntelliSense
 #ifndef CONFIG_LOG_MAXIMUM_LEVEL
@@ -20,9 +36,7 @@ static const char *TAG = "AUTO_BOARD";
 // External variables (defined in main.c)
 extern const gpio_num_t input_gpios[];
 extern const gpio_num_t output_gpios[];
-extern input_state_t input_states[];
-extern bool output_states[];
-extern QueueHandle_t input_event_queue;
+extern TaskHandle_t input_task_handle;
 
 void configure_gpio(void)
 {
@@ -58,6 +72,9 @@ void configure_gpio(void)
     
     gpio_config(&output_conf);
     
+    // Outputs are written as one image through GPIO_OUT_W1TS/W1TC
+    output_image_init();
+    
     // Configure status LED
     gpio_config_t led_conf = {
         .pin_bit_mask = (1ULL << STATUS_LED_GPIO),
@@ -69,6 +86,9 @@ void configure_gpio(void)
     
     gpio_config(&led_conf);
     
+    // Inputs are read as one GPIO_IN_REG snapshot from here on
+    input_sample_init();
+    
     // Install GPIO ISR service
     gpio_install_isr_service(0);
     
@@ -83,63 +103,153 @@ void configure_gpio(void)
 void gpio_isr_handler(void *arg)
 {
     uint32_t input_num = (uint32_t)arg;
+    HOTPATH_BEGIN(HOTPATH_ISR);
+    
+    // Fallback pulse counting: just count, no edge record and no wakeup
+    if (input_counter_isr_edge(input_num)) {
+        HOTPATH_END(HOTPATH_ISR);
+        return;
+    }
+    
     input_event_t event = {
         .input_num = input_num,
-        .state = gpio_get_level(input_gpios[input_num])
+        .state = (input_sample_snapshot() >> input_num) & 1,
+        .timestamp_us = time_base_now_us()
     };
     
+    // A chattering input masks its own interrupt and switches to polling
+    if (input_storm_check(input_num, event.timestamp_us)) {
+        ESP_DRAM_LOGW(TAG, "Input %d interrupt storm, masked", input_num + 1);
+    }
+    
+    // Diagnostic capture keeps the newest edges, overwriting the oldest
+    edge_capture_record(event.input_num, event.state, event.timestamp_us);
+    
+    // Edges that do not fit are counted by the ring, never blocked on
+    input_ring_push(&event);
+    
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xQueueSendFromISR(input_event_queue, &event, &xHigherPriorityTaskWoken);
+    if (input_task_handle != NULL) {
+        xTaskNotifyFromISR(input_task_handle, INPUT_NOTIFY_EDGE, eSetBits, &xHigherPriorityTaskWoken);
+    }
+    
+    HOTPATH_END(HOTPATH_ISR);
     
     if (xHigherPriorityTaskWoken) {
         portYIELD_FROM_ISR();
     }
 }
 
-void debounce_inputs(void)
-{
-    uint32_t current_time = esp_timer_get_time() / 1000;
-    
-    for (int i = 0; i < NUM_INPUTS; i++) {
-        if (input_states[i].current_state != input_states[i].last_state) {
-            input_states[i].last_state = input_states[i].current_state;
-            input_states[i].last_change_time = current_time;
-        } else if ((current_time - input_states[i].last_change_time) >= DEBOUNCE_TIME_MS) {
-            if (input_states[i].debounced_state != input_states[i].current_state) {
-                input_states[i].debounced_state = input_states[i].current_state;
-                ESP_LOGI(TAG, "Input %d debounced state: %s", 
-                        i + 1, 
-                        input_states[i].debounced_state ? "ACTIVE" : "INACTIVE");
-            }
-        }
-    }
-}
-
-void set_output(uint8_t output_num, bool state)
-{
-    if (output_num < NUM_OUTPUTS) {
-        gpio_set_level(output_gpios[output_num], state ? 1 : 0);
-        output_states[output_num] = state;
-    }
-}
-
 void print_status(void)
 {
     ESP_LOGI(TAG, "=== AUTOMATION BOARD STATUS ===");
     
     // Print input states
+    uint32_t input_bits = input_debounce_get_state();
     printf("INPUTS:  ");
     for (int i = 0; i < NUM_INPUTS; i++) {
-        printf("IN%d:%s ", i + 1, input_states[i].debounced_state ? "ACT" : "INA");
+        input_counter_info_t counter;
+        input_counter_get_info(i, &counter);
+        if (counter.source != INPUT_COUNTER_NONE) {
+            printf("IN%d:%lu.%03luHz ", i + 1, counter.frequency_mhz / 1000, counter.frequency_mhz % 1000);
+        } else {
+            printf("IN%d:%s ", i + 1, (input_bits & (1UL << i)) ? "ACT" : "INA");
+        }
     }
     printf("\n");
     
     // Print output states
+    uint32_t output_bits = output_image_get();
     printf("OUTPUTS: ");
     for (int i = 0; i < NUM_OUTPUTS; i++) {
-        printf("OUT%d:%s ", i + 1, output_states[i] ? "ON" : "OFF");
+        output_duty_config_t duty;
+        output_duty_get(i, &duty);
+        if (duty.mode != OUTPUT_MODE_ONOFF) {
+            printf("OUT%d:%s(%u%%) ", i + 1, (output_bits & (1UL << i)) ? "ON" : "OFF", duty.duty_permille / 10);
+        } else {
+            printf("OUT%d:%s ", i + 1, (output_bits & (1UL << i)) ? "ON" : "OFF");
+        }
+    }
+    printf("\n");
+    
+    input_ring_stats_t ring_stats;
+    input_ring_get_stats(&ring_stats);
+    printf("EDGES:   total:%lu dropped:%lu ring_max:%lu/%d\n",
+           ring_stats.pushed, ring_stats.overflows, ring_stats.high_water, INPUT_RING_SIZE);
+    
+    debounce_latency_stats_t latency;
+    input_debounce_get_latency(&latency);
+    printf("DEBOUNCE: n:%lu excess min:%luus max:%luus hist:",
+           latency.samples, latency.min_us, latency.max_us);
+    for (int i = 0; i < DEBOUNCE_HIST_BUCKETS; i++) {
+        if (i < DEBOUNCE_HIST_BUCKETS - 1) {
+            printf(" <%lu:%lu", debounce_hist_limits_us[i], latency.buckets[i]);
+        } else {
+            printf(" >=%lu:%lu", debounce_hist_limits_us[i - 1], latency.buckets[i]);
+        }
     }
     printf("\n");
     
+    scan_stats_t scan;
+    scan_cycle_get_stats(&scan);
+    printf("SCAN:    period:%luus n:%lu min:%luus avg:%luus max:%luus overruns:%lu\n",
+           scan.period_us, scan.scan_count, scan.min_us, scan.avg_us, scan.max_us, scan.overruns);
+    printf("WAKES:   tick:%lu%s input:%lu command:%lu timer:%lu\n",
+           scan.tick_scans, scan.tick_running ? "(on)" : "(off)",
+           scan.input_scans, scan.command_scans, scan.timer_scans);
+    
+    output_sched_stats_t sched;
+    output_sched_get_stats(&sched);
+    if (sched.enabled) {
+        printf("ZC:      %s rate:%lu.%03luHz sched:%lu lat min:%luus avg:%luus max:%luus missed:%lu fallback:%lu\n",
+               sched.signal_ok ? "OK" : "LOST",
+               sched.crossing_rate_mhz / 1000, sched.crossing_rate_mhz % 1000,
+               sched.scheduled, sched.latency_min_us, sched.latency_avg_us, sched.latency_max_us,
+               sched.missed_windows, sched.fallbacks);
+    }
+    
+    schedule_status_t schedule;
+    schedule_get_status(&schedule);
+    if (schedule.active_mask != 0) {
+        printf("SCHED:   clock:%s outputs:0x%02lx on:0x%02lx next:%lld\n",
+               schedule_time_source_name(schedule.source),
+               schedule.active_mask, schedule.on_bits, (long long)schedule.next_transition);
+    }
+    
+    printf("OWNER:  ");
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        printf(" O%d:%s", i + 1, output_arbiter_level_name(output_arbiter_get_owner(i)));
+    }
+    printf("\n");
+    
+    uint32_t held = output_guard_get_held();
+    if (held != 0) {
+        printf("GUARD:  ");
+        for (uint32_t bits = held; bits; bits &= bits - 1) {
+            output_guard_info_t guard;
+            output_guard_get_info(__builtin_ctz(bits), &guard);
+            printf(" O%d->%s(%s %lums)", __builtin_ctz(bits) + 1, guard.wanted ? "ON" : "OFF",
+                   output_guard_reason_name(guard.reason), guard.wait_ms);
+        }
+        printf("\n");
+    }
+    
+    logic_vm_status_t logic;
+    logic_vm_get_status(&logic);
+    if (logic.loaded) {
+        printf("LOGIC:   %u insns -> %u ops (%luB) outputs:0x%02lx timers:0x%04lx ran:%u scan:%luus avg:%luus max:%luus\n",
+               logic.insn_count, logic.thread_ops, logic.code_bytes, logic.out_mask, logic.timing,
+               logic.evaluated, logic.last_us, logic.avg_us, logic.max_us);
+    }
+    
+    retain_stats_t retain;
+    retain_get_stats(&retain);
+    printf("RETAIN:  boot:%s in %luus outputs:0x%02lx manual:0x%02lx timers:%u snapshots:%lu journal:%lu err:%lu\n",
+           retain_source_name(retain.source), retain.restore_us,
+           retain.restored_outputs, retain.restored_manual, retain.restored_timers,
+           retain.captures, retain.journal_writes, retain.journal_errors);
+    
+    hotpath_audit_print();
+    
     ESP_LOGI(TAG, "===============================");
 }
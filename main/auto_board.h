@@ -21,36 +21,44 @@
 // Status LED
 #define STATUS_LED_GPIO GPIO_NUM_2
 
+// Mains zero-cross detector (spare GPIO, one pulse per crossing)
+#define ZERO_CROSS_GPIO GPIO_NUM_25
+
 // Configuration constants
 #define NUM_INPUTS      5
 #define NUM_OUTPUTS     4
-#define DEBOUNCE_TIME_MS 50
 
-// Input state structure
-typedef struct {
-    bool current_state;
-    bool last_state;
-    uint32_t last_change_time;
-    bool debounced_state;
-} input_state_t;
+// Input modes
+#define INPUT_MODE_LEVEL    0   // Debounced on/off input
+#define INPUT_MODE_COUNTER  1   // Hardware-counted pulses (PCNT), logic sees rate >= threshold
+
+// Per-input mode and rate threshold (Hz, counter inputs only)
+#define INPUT_1_MODE            INPUT_MODE_LEVEL
+#define INPUT_2_MODE            INPUT_MODE_LEVEL
+#define INPUT_3_MODE            INPUT_MODE_LEVEL
+#define INPUT_4_MODE            INPUT_MODE_LEVEL
+#define INPUT_5_MODE            INPUT_MODE_LEVEL
+
+#define INPUT_1_RATE_THRESHOLD_HZ   1
+#define INPUT_2_RATE_THRESHOLD_HZ   1
+#define INPUT_3_RATE_THRESHOLD_HZ   1
+#define INPUT_4_RATE_THRESHOLD_HZ   1
+#define INPUT_5_RATE_THRESHOLD_HZ   1
 
 // Input event structure
 typedef struct {
     uint8_t input_num;
     bool state;
+    int64_t timestamp_us;   // esp_timer time captured in the ISR
 } input_event_t;
 
 // Function prototypes
 void configure_gpio(void);
-void set_output(uint8_t output_num, bool state);
 void print_status(void);
-void debounce_inputs(void);
 void IRAM_ATTR gpio_isr_handler(void *arg);
 
 // Task prototypes
 void input_task(void *arg);
-void output_control_task(void *arg);
 void status_led_task(void *arg);
-void timer_processing_task(void *arg);
 
 #endif // AUTO_BOARD_H
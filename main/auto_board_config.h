@@ -6,9 +6,21 @@
 #define BOARD_NAME "ESP32 Automation Board"
 
 // Input Configuration
+// Polarity, debounce time and filter are per-input profiles stored in NVS
+// (see input_profile.h); these are the defaults for inputs without one
 #define INPUT_ACTIVE_LOW        1    // 1 = Active LOW, 0 = Active HIGH
-#define INPUT_DEBOUNCE_MS       100   // Debounce time in milliseconds
+#define INPUT_DEBOUNCE_MS       50   // Debounce time in milliseconds
+#define INPUT_DEBOUNCE_TICK_MS  2    // Debounce sample tick while any input is settling
 #define INPUT_PULLUP_ENABLE     1    // Enable internal pull-up resistors
+#define INPUT_COUNTER_WINDOW_MS 1000 // Frequency measurement window for counter inputs
+#define INPUT_COUNTER_GLITCH_NS 10000 // PCNT glitch filter for counter inputs
+
+// Interrupt storm protection: an input with more than INPUT_STORM_MAX_EDGES
+// edges in INPUT_STORM_WINDOW_MS has its interrupt masked and is polled
+// until it has been quiet for INPUT_STORM_SETTLE_MS
+#define INPUT_STORM_MAX_EDGES   50
+#define INPUT_STORM_WINDOW_MS   100
+#define INPUT_STORM_SETTLE_MS   1000
 
 // Output Configuration  
 #define OUTPUT_ACTIVE_HIGH      1    // 1 = Active HIGH, 0 = Active LOW
@@ -23,10 +35,17 @@
 #define INPUT_TASK_PRIORITY     10   // Input task priority (higher = more priority)
 #define OUTPUT_TASK_PRIORITY    8    // Output control task priority
 #define STATUS_TASK_PRIORITY    5    // Status LED task priority
+#define SCAN_TASK_PRIORITY      9    // PLC scan cycle task priority
 
 #define INPUT_TASK_STACK_SIZE   4096 // Input task stack size
 #define OUTPUT_TASK_STACK_SIZE  4096 // Output task stack size
 #define STATUS_TASK_STACK_SIZE  2048 // Status task stack size
+#define SCAN_TASK_STACK_SIZE    4096 // Scan cycle task stack size
+
+// Core the input and scan tasks are pinned to (the last one, away from
+// WiFi). The hot path audit times them with the per-core cycle counter,
+// so they must not migrate in the middle of a stage.
+#define HOTPATH_TASK_CORE       (portNUM_PROCESSORS - 1)
 
 // Logging Configuration
 #define LOG_LEVEL_DEFAULT       3    // 0=None, 1=Error, 2=Warn, 3=Info, 4=Debug, 5=Verbose
@@ -38,11 +57,12 @@
 #define ENABLE_REMOTE_CONTROL   0    // Enable WiFi/Bluetooth remote control (future feature)
 
 // Control Logic Configuration
-#define CONTROL_MODE_DIRECT     1    // Direct input-to-output mapping
-#define CONTROL_MODE_CUSTOM     0    // Custom control logic
+#define CONTROL_MODE_DIRECT     1    // Direct input-to-output mapping for outputs the logic program leaves alone
+#define CONTROL_MODE_CUSTOM     1    // Run the logic program uploaded to /api/logic
 
 // Input-Output Mapping (when using direct mode)
-// Map each input to corresponding output (1-based indexing)
+// Default level links (1-based, 0 = none), used until a mapping table is
+// saved through /api/iomap
 #define INPUT_1_CONTROLS_OUTPUT 1
 #define INPUT_2_CONTROLS_OUTPUT 2
 #define INPUT_3_CONTROLS_OUTPUT 3
@@ -53,8 +73,33 @@
 #define ENABLE_INPUT_INTERRUPTS 1    // Use GPIO interrupts for inputs
 #define ENABLE_OUTPUT_FEEDBACK  0    // Monitor output states (future feature)
 #define ENABLE_OVERCURRENT_DET  0    // Enable overcurrent detection (future feature)
+#define HOTPATH_AUDIT_ENABLE    0    // Cycle-count the input-to-output path and trap allocations on it
+
+// Time-Proportional / Burst-Fire Outputs
+#define OUTPUT_DUTY_CYCLE_S     10   // Default time-proportional cycle (1-60 s)
+
+// Zero-Cross Output Scheduling
+#define ZERO_CROSS_ENABLE       0    // Switch SSR outputs at mains zero crossings
+#define ZERO_CROSS_OUTPUT_MASK  0x0F // Outputs switched at crossings (bit n = output n)
+#define ZERO_CROSS_DELAY_US     0    // Detector edge to true crossing
+#define ZERO_CROSS_WINDOW_US    200  // Switching later than this after the crossing is a missed window
+#define ZERO_CROSS_TIMEOUT_MS   100  // No crossing for this long = no signal, switch immediately
+
+// Output Protection (compressors, pumps); one entry per output
+#define OUTPUT_MIN_ON_MS        { 0, 0, 0, 0 }      // Minimum ON time before an OFF is accepted
+#define OUTPUT_MIN_OFF_MS       { 0, 0, 0, 0 }      // Minimum OFF time before an ON is accepted
+#define OUTPUT_INTERLOCK_MASKS  { 0, 0, 0, 0 }      // Outputs that must be OFF first (bit n = output n), made mutual
+
+// Output Retention Across Resets
+#define RETAIN_LAST_MASK            0x00   // Outputs restored to their last state after a reset (bit n = output n)
+#define RETAIN_JOURNAL_INTERVAL_MS  30000  // Minimum time between NVS journal writes
+
+// Weekly Output Schedules
+#define SCHEDULE_SNTP_SERVER    "pool.ntp.org"
+#define SCHEDULE_DEFAULT_TZ     "UTC0"   // POSIX TZ string, changeable from the web UI
 
 // Timing Configuration
+#define SCAN_PERIOD_MS          10   // Scan tick while counters/duty outputs need one; otherwise scans are event-driven
 #define MAIN_LOOP_DELAY_MS      100  // Main task loop delay
 #define LED_BLINK_ON_MS         100  // Status LED on time
 #define LED_BLINK_OFF_MS        900  // Status LED off time
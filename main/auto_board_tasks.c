@@ -1,13 +1,14 @@
 #include <stdio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "auto_board.h"
 #include "auto_board_config.h"
-#include "web_server.h"
+#include "input_ring.h"
+#include "input_debounce.h"
+#include "hotpath_audit.h"
 
 // Define pdMS_TO_TICKS if not defined (for ESP-IDF compatibility)
 #ifndef pdMS_TO_TICKS
@@ -28,66 +29,30 @@ static const char *TAG = "AUTO_BOARD_TASKS";
 // External variables (defined in main.c)
 extern const gpio_num_t input_gpios[];
 extern const gpio_num_t output_gpios[];
-extern input_state_t input_states[];
-extern bool output_states[];
-extern QueueHandle_t input_event_queue;
 
 void input_task(void *arg)
 {
-    input_event_t event;
+    input_event_t events[INPUT_RING_BATCH_SIZE];
     
     ESP_LOGI(TAG, "Input monitoring task started");
     
     while (1) {
-        if (xQueueReceive(input_event_queue, &event, pdMS_TO_TICKS(100)) == pdTRUE) {
-            // Update input state
-            input_states[event.input_num].current_state = event.state;
-            input_states[event.input_num].last_change_time = esp_timer_get_time() / 1000;
-            
-            ESP_LOGD(TAG, "Input %d changed to %s", 
-                    event.input_num + 1, 
-                    event.state ? "HIGH" : "LOW");
-        }
+        // Block until gpio_isr_handler queues an edge or the debounce tick runs;
+        // with all inputs idle this task never wakes
+        uint32_t notify_bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &notify_bits, portMAX_DELAY);
+        HOTPATH_BEGIN(HOTPATH_INPUT_TASK);
         
-        // Perform debouncing
-        debounce_inputs();
+        size_t count;
+        while ((count = input_ring_pop_batch(events, INPUT_RING_BATCH_SIZE)) > 0) {
+            input_debounce_edges(events, count);
+        }
         
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
-}
-
-void output_control_task(void *arg)
-{
-    ESP_LOGI(TAG, "Output control task started");
-    
-    while (1) {
-        // Simple logic: Each input controls corresponding output
-        // BUT: Only apply automatic control if no manual/timer control is active
-        for (int i = 0; i < NUM_INPUTS && i < NUM_OUTPUTS; i++) {
-            // Check if this output has an active timer or manual control
-            bool timer_active = (get_remaining_timer_minutes(i) > 0);
-            bool manual_active = is_manual_control_active(i);
-            
-            // Only apply automatic input-to-output logic if no timer or manual control is active
-            if (!timer_active && !manual_active) {
-                // Optocouplers are typically active LOW, so invert the logic
-                bool desired_output_state = !input_states[i].debounced_state;
-                
-                if (output_states[i] != desired_output_state) {
-                    set_output(i, desired_output_state);
-                    ESP_LOGI(TAG, "Output %d set to %s (Input %d triggered)", 
-                            i + 1, 
-                            desired_output_state ? "ON" : "OFF",
-                            i + 1);
-                }
-            } else if (timer_active) {
-                ESP_LOGD(TAG, "Output %d under timer control, skipping automatic control", i + 1);
-            } else if (manual_active) {
-                ESP_LOGD(TAG, "Output %d under manual control, skipping automatic control", i + 1);
-            }
+        if (notify_bits & INPUT_NOTIFY_TICK) {
+            input_debounce_tick();
         }
         
-        vTaskDelay(pdMS_TO_TICKS(100));
+        HOTPATH_END(HOTPATH_INPUT_TASK);
     }
 }
 
@@ -103,16 +68,3 @@ void status_led_task(void *arg)
         vTaskDelay(pdMS_TO_TICKS(900));
     }
 }
-
-void timer_processing_task(void *arg)
-{
-    ESP_LOGI(TAG, "Timer processing task started");
-    
-    while (1) {
-        // Process all active timers
-        process_timers();
-        
-        // Check every 10 seconds
-        vTaskDelay(pdMS_TO_TICKS(10000));
-    }
-}
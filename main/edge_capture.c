@@ -0,0 +1,76 @@
+#include <stdatomic.h>
+#include "esp_attr.h"
+#include "edge_capture.h"
+
+#define SEQ_WRITING UINT32_MAX
+
+_Static_assert((EDGE_CAPTURE_SIZE & (EDGE_CAPTURE_SIZE - 1)) == 0, "EDGE_CAPTURE_SIZE must be a power of two");
+
+// Overwrite-oldest ring. Each slot is guarded by its own sequence number
+// (seqlock style) so a reader on the other core never returns a torn entry.
+static edge_capture_entry_t capture_ring[EDGE_CAPTURE_SIZE];
+static atomic_uint_fast32_t capture_head = 0;
+
+void IRAM_ATTR edge_capture_record(uint8_t input_num, bool level, int64_t timestamp_us)
+{
+    uint32_t seq = atomic_load_explicit(&capture_head, memory_order_relaxed);
+    volatile edge_capture_entry_t *slot = &capture_ring[seq & (EDGE_CAPTURE_SIZE - 1)];
+
+    slot->seq = SEQ_WRITING;
+    atomic_thread_fence(memory_order_release);
+    slot->input_num = input_num;
+    slot->level = level;
+    slot->timestamp_us = timestamp_us;
+    atomic_thread_fence(memory_order_release);
+    slot->seq = seq;
+
+    atomic_store_explicit(&capture_head, seq + 1, memory_order_release);
+}
+
+size_t edge_capture_read(uint32_t *cursor, uint32_t end, edge_capture_entry_t *entries, size_t max_entries)
+{
+    uint32_t head = atomic_load_explicit(&capture_head, memory_order_acquire);
+    uint32_t seq = *cursor;
+
+    // Never read past the caller's end, even if the ISR has moved on since
+    if ((int32_t)(end - head) < 0) {
+        head = end;
+    }
+
+    // Oldest entry still guaranteed to be in the ring
+    if (head - seq > EDGE_CAPTURE_SIZE) {
+        seq = head - EDGE_CAPTURE_SIZE;
+    }
+    if ((int32_t)(head - seq) <= 0) {
+        return 0;
+    }
+
+    size_t count = 0;
+    for (; seq != head && count < max_entries; seq++) {
+        volatile edge_capture_entry_t *slot = &capture_ring[seq & (EDGE_CAPTURE_SIZE - 1)];
+
+        uint32_t before = slot->seq;
+        atomic_thread_fence(memory_order_acquire);
+        edge_capture_entry_t copy = {
+            .seq = before,
+            .input_num = slot->input_num,
+            .level = slot->level,
+            .timestamp_us = slot->timestamp_us
+        };
+        atomic_thread_fence(memory_order_acquire);
+
+        // Overwritten while we were copying: it is lost, not corrupted
+        if (before != seq || slot->seq != seq) {
+            continue;
+        }
+        entries[count++] = copy;
+    }
+
+    *cursor = seq;
+    return count;
+}
+
+uint32_t edge_capture_get_head(void)
+{
+    return atomic_load_explicit(&capture_head, memory_order_acquire);
+}
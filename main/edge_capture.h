@@ -0,0 +1,29 @@
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_attr.h"
+
+// Capture ring configuration (must be a power of two)
+#define EDGE_CAPTURE_SIZE   512
+
+// One captured edge, 16 bytes; also the record layout of the binary dump
+typedef struct {
+    uint32_t seq;           // Free-running edge number
+    uint8_t input_num;      // 0-based input index
+    uint8_t level;          // Pin level after the edge
+    uint16_t reserved;
+    int64_t timestamp_us;   // esp_timer time taken in the ISR
+} edge_capture_entry_t;
+
+// Function prototypes
+// Producer side: only gpio_isr_handler may record
+void IRAM_ATTR edge_capture_record(uint8_t input_num, bool level, int64_t timestamp_us);
+// Copies entries with *cursor <= seq < end that are still in the ring and
+// advances *cursor; entries overwritten before they could be read are skipped
+size_t edge_capture_read(uint32_t *cursor, uint32_t end, edge_capture_entry_t *entries, size_t max_entries);
+uint32_t edge_capture_get_head(void);
+
+#endif // EDGE_CAPTURE_H
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hotpath_audit.h"
+
+#ifdef HOTPATH_AUDIT_HOST
+#include <time.h>
+#else
+#include "esp_cpu.h"
+#include "sdkconfig.h"
+#endif
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 240
+#endif
+
+#ifndef CONFIG_FREERTOS_NUMBER_OF_CORES
+#define CONFIG_FREERTOS_NUMBER_OF_CORES 2
+#endif
+
+static const char *stage_names[HOTPATH_STAGE_COUNT] = {
+    "isr", "input_task", "debounce", "scan", "output_write"
+};
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_ticks;
+    uint32_t max_ticks;
+    uint64_t total_ticks;
+    uint32_t allocs;
+    uint32_t alloc_bytes;
+} stage_record_t;
+
+static stage_record_t records[HOTPATH_STAGE_COUNT];
+
+// Stages currently running on each core, bit n = hotpath_stage_t n.
+// A stage only ever runs on one core at a time, so the heap hook can
+// blame an allocation on whatever is open on the core it happens on.
+// The audited tasks are pinned to HOTPATH_TASK_CORE, so a stage also
+// begins and ends on the same core and reads the same cycle counter.
+static volatile uint32_t active_stages[CONFIG_FREERTOS_NUMBER_OF_CORES];
+
+// Stage records are shared between the ISR and the tasks
+static portMUX_TYPE audit_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#ifdef HOTPATH_AUDIT_HOST
+// Host timing: one tick = 1 ns
+#define TICKS_PER_US    1000
+
+static inline uint32_t read_ticks(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+static inline int current_core(void)
+{
+    return 0;
+}
+#else
+// Target timing: one tick = one CPU cycle (CCOUNT), wraps every ~17 s at 240 MHz
+#define TICKS_PER_US    CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+
+static inline uint32_t read_ticks(void)
+{
+    return (uint32_t)esp_cpu_get_cycle_count();
+}
+
+static inline int current_core(void)
+{
+    return esp_cpu_get_core_id();
+}
+#endif
+
+static inline uint32_t ticks_to_ns(uint64_t ticks)
+{
+    return (uint32_t)(ticks * 1000 / TICKS_PER_US);
+}
+
+uint32_t IRAM_ATTR hotpath_audit_begin(hotpath_stage_t stage)
+{
+    active_stages[current_core()] |= 1UL << stage;
+    return read_ticks();
+}
+
+void IRAM_ATTR hotpath_audit_end(hotpath_stage_t stage, uint32_t start)
+{
+    // Unsigned subtraction copes with the counter wrapping once
+    uint32_t elapsed = read_ticks() - start;
+    stage_record_t *rec = &records[stage];
+
+    active_stages[current_core()] &= ~(1UL << stage);
+
+    portENTER_CRITICAL_SAFE(&audit_lock);
+    if (rec->count == 0 || elapsed < rec->min_ticks) {
+        rec->min_ticks = elapsed;
+    }
+    if (elapsed > rec->max_ticks) {
+        rec->max_ticks = elapsed;
+    }
+    rec->total_ticks += elapsed;
+    rec->count++;
+    portEXIT_CRITICAL_SAFE(&audit_lock);
+}
+
+void IRAM_ATTR hotpath_audit_note_alloc(size_t size)
+{
+    uint32_t stages = active_stages[current_core()];
+    if (stages == 0) {
+        return;
+    }
+
+    portENTER_CRITICAL_SAFE(&audit_lock);
+    for (; stages; stages &= stages - 1) {
+        stage_record_t *rec = &records[__builtin_ctz(stages)];
+        rec->allocs++;
+        rec->alloc_bytes += size;
+    }
+    portEXIT_CRITICAL_SAFE(&audit_lock);
+}
+
+#if HOTPATH_AUDIT_ENABLE && defined(CONFIG_HEAP_USE_HOOKS)
+// Weak hook in the heap component, called after every successful allocation
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    hotpath_audit_note_alloc(size);
+}
+#elif HOTPATH_AUDIT_ENABLE && !defined(HOTPATH_AUDIT_HOST)
+#warning "HOTPATH_AUDIT_ENABLE without CONFIG_HEAP_USE_HOOKS: allocations are not trapped"
+#endif
+
+bool hotpath_audit_enabled(void)
+{
+    return HOTPATH_AUDIT_ENABLE != 0;
+}
+
+const char *hotpath_audit_stage_name(hotpath_stage_t stage)
+{
+    return stage < HOTPATH_STAGE_COUNT ? stage_names[stage] : "unknown";
+}
+
+void hotpath_audit_get_stats(hotpath_stage_t stage, hotpath_stage_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (stage >= HOTPATH_STAGE_COUNT) {
+        return;
+    }
+
+    portENTER_CRITICAL(&audit_lock);
+    stage_record_t rec = records[stage];
+    portEXIT_CRITICAL(&audit_lock);
+
+    stats->count = rec.count;
+    stats->min_ns = ticks_to_ns(rec.min_ticks);
+    stats->max_ns = ticks_to_ns(rec.max_ticks);
+    stats->avg_ns = rec.count ? ticks_to_ns(rec.total_ticks / rec.count) : 0;
+    stats->allocs = rec.allocs;
+    stats->alloc_bytes = rec.alloc_bytes;
+}
+
+uint32_t hotpath_audit_stack_free(const char *task_name)
+{
+    TaskHandle_t task = xTaskGetHandle(task_name);
+    if (task == NULL) {
+        return 0;
+    }
+    // Stack depth is counted in bytes on ESP-IDF
+    return (uint32_t)uxTaskGetStackHighWaterMark(task);
+}
+
+void hotpath_audit_print(void)
+{
+    if (!hotpath_audit_enabled()) {
+        return;
+    }
+
+    for (int i = 0; i < HOTPATH_STAGE_COUNT; i++) {
+        hotpath_stage_stats_t stats;
+        hotpath_audit_get_stats(i, &stats);
+        printf("AUDIT:   %-10s n:%lu min:%luns avg:%luns max:%luns allocs:%lu (%lu B)\n",
+               stage_names[i],
+               (unsigned long)stats.count,
+               (unsigned long)stats.min_ns,
+               (unsigned long)stats.avg_ns,
+               (unsigned long)stats.max_ns,
+               (unsigned long)stats.allocs,
+               (unsigned long)stats.alloc_bytes);
+    }
+    printf("AUDIT:   stack free input_task:%luB scan_task:%luB\n",
+           (unsigned long)hotpath_audit_stack_free("input_task"),
+           (unsigned long)hotpath_audit_stack_free("scan_task"));
+}
@@ -0,0 +1,55 @@
+#ifndef HOTPATH_AUDIT_H
+#define HOTPATH_AUDIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_attr.h"
+#include "auto_board_config.h"
+
+// Hot path audit: cycle-counter probes around every stage of the
+// input -> logic -> output path, plus a heap hook that flags any
+// allocation made while one of those stages is running.
+//
+// Enabled with HOTPATH_AUDIT_ENABLE; otherwise the probes compile away.
+// Host builds define HOTPATH_AUDIT_HOST and are timed with clock_gettime.
+
+typedef enum {
+    HOTPATH_ISR = 0,        // gpio_isr_handler
+    HOTPATH_INPUT_TASK,     // One input_task wake-up
+    HOTPATH_DEBOUNCE,       // input_debounce_tick
+    HOTPATH_SCAN,           // One read-logic-write scan
+    HOTPATH_OUTPUT_WRITE,   // output_image_apply
+    HOTPATH_STAGE_COUNT
+} hotpath_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_ns;
+    uint32_t avg_ns;
+    uint32_t max_ns;
+    uint32_t allocs;        // Allocations made while the stage was running
+    uint32_t alloc_bytes;
+} hotpath_stage_stats_t;
+
+#if HOTPATH_AUDIT_ENABLE
+#define HOTPATH_BEGIN(stage)    uint32_t hotpath_t0_##stage = hotpath_audit_begin(stage)
+#define HOTPATH_END(stage)      hotpath_audit_end(stage, hotpath_t0_##stage)
+#else
+#define HOTPATH_BEGIN(stage)    do { } while (0)
+#define HOTPATH_END(stage)      do { } while (0)
+#endif
+
+// Function prototypes
+uint32_t IRAM_ATTR hotpath_audit_begin(hotpath_stage_t stage);
+void IRAM_ATTR hotpath_audit_end(hotpath_stage_t stage, uint32_t start);
+// Called by the heap hook (or a host malloc wrapper) for every allocation
+void IRAM_ATTR hotpath_audit_note_alloc(size_t size);
+bool hotpath_audit_enabled(void);
+const char *hotpath_audit_stage_name(hotpath_stage_t stage);
+void hotpath_audit_get_stats(hotpath_stage_t stage, hotpath_stage_stats_t *stats);
+// Lowest free stack (bytes) seen so far for a task on the hot path, 0 if unknown
+uint32_t hotpath_audit_stack_free(const char *task_name);
+void hotpath_audit_print(void);
+
+#endif // HOTPATH_AUDIT_H
@@ -0,0 +1,195 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "driver/pulse_cnt.h"
+#include "esp_log.h"
+#include "auto_board.h"
+#include "auto_board_config.h"
+#include "input_counter.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "INPUT_COUNTER";
+
+// PCNT counts are accumulated across this watch point by the driver
+#define PCNT_HIGH_LIMIT 32767
+
+// External variables (defined in main.c)
+extern const gpio_num_t input_gpios[];
+
+static const uint8_t input_modes[NUM_INPUTS] = {
+    INPUT_1_MODE, INPUT_2_MODE, INPUT_3_MODE, INPUT_4_MODE, INPUT_5_MODE
+};
+
+static const uint32_t rate_thresholds_mhz[NUM_INPUTS] = {
+    INPUT_1_RATE_THRESHOLD_HZ * 1000, INPUT_2_RATE_THRESHOLD_HZ * 1000,
+    INPUT_3_RATE_THRESHOLD_HZ * 1000, INPUT_4_RATE_THRESHOLD_HZ * 1000,
+    INPUT_5_RATE_THRESHOLD_HZ * 1000
+};
+
+typedef struct {
+    input_counter_source_t source;
+    pcnt_unit_handle_t unit;
+    uint32_t window_start_count;
+    uint32_t frequency_mhz;
+} counter_channel_t;
+
+static counter_channel_t channels[NUM_INPUTS];
+static atomic_uint_fast32_t isr_counts[NUM_INPUTS];
+
+static uint32_t counter_mask = 0;
+static DRAM_ATTR uint32_t isr_counter_mask = 0;
+static volatile uint32_t rate_bits = 0;
+static int64_t window_start_us = 0;
+
+static esp_err_t setup_pcnt(int input_num)
+{
+    pcnt_unit_config_t unit_config = {
+        .high_limit = PCNT_HIGH_LIMIT,
+        .low_limit = -1,
+        .flags.accum_count = true,
+    };
+    pcnt_unit_handle_t unit = NULL;
+    esp_err_t ret = pcnt_new_unit(&unit_config, &unit);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    pcnt_glitch_filter_config_t filter_config = {
+        .max_glitch_ns = INPUT_COUNTER_GLITCH_NS,
+    };
+    pcnt_unit_set_glitch_filter(unit, &filter_config);
+
+    pcnt_chan_config_t chan_config = {
+        .edge_gpio_num = input_gpios[input_num],
+        .level_gpio_num = -1,
+    };
+    pcnt_channel_handle_t channel = NULL;
+    ret = pcnt_new_channel(unit, &chan_config, &channel);
+    if (ret != ESP_OK) {
+        pcnt_del_unit(unit);
+        return ret;
+    }
+
+    // Optocouplers pull LOW when driven: one falling edge per pulse
+    pcnt_channel_set_edge_action(channel, PCNT_CHANNEL_EDGE_ACTION_HOLD, PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+    pcnt_unit_add_watch_point(unit, PCNT_HIGH_LIMIT);
+
+    pcnt_unit_enable(unit);
+    pcnt_unit_clear_count(unit);
+    pcnt_unit_start(unit);
+
+    channels[input_num].unit = unit;
+    return ESP_OK;
+}
+
+static uint32_t read_count(int input_num)
+{
+    if (channels[input_num].source == INPUT_COUNTER_PCNT) {
+        int count = 0;
+        pcnt_unit_get_count(channels[input_num].unit, &count);
+        return (uint32_t)count;
+    }
+    return atomic_load_explicit(&isr_counts[input_num], memory_order_relaxed);
+}
+
+esp_err_t input_counter_init(void)
+{
+    memset(channels, 0, sizeof(channels));
+
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        atomic_store(&isr_counts[i], 0);
+        if (input_modes[i] != INPUT_MODE_COUNTER) {
+            continue;
+        }
+
+        counter_mask |= 1UL << i;
+
+        if (setup_pcnt(i) == ESP_OK) {
+            // Pulses never reach the CPU
+            gpio_isr_handler_remove(input_gpios[i]);
+            gpio_intr_disable(input_gpios[i]);
+            channels[i].source = INPUT_COUNTER_PCNT;
+            ESP_LOGI(TAG, "Input %d counted by PCNT", i + 1);
+        } else {
+            // Out of PCNT units: count falling edges in the GPIO ISR instead
+            gpio_set_intr_type(input_gpios[i], GPIO_INTR_NEGEDGE);
+            channels[i].source = INPUT_COUNTER_ISR;
+            isr_counter_mask |= 1UL << i;
+            ESP_LOGW(TAG, "Input %d: no PCNT unit available, using ISR counter", i + 1);
+        }
+    }
+
+    return ESP_OK;
+}
+
+bool IRAM_ATTR input_counter_isr_edge(uint32_t input_num)
+{
+    if (!(isr_counter_mask & (1UL << input_num))) {
+        return false;
+    }
+
+    // Batched: the scan reads the total once per window
+    atomic_fetch_add_explicit(&isr_counts[input_num], 1, memory_order_relaxed);
+    return true;
+}
+
+void input_counter_update(int64_t now_us)
+{
+    if (counter_mask == 0) {
+        return;
+    }
+
+    int64_t elapsed_us = now_us - window_start_us;
+    if (elapsed_us < (int64_t)INPUT_COUNTER_WINDOW_MS * 1000) {
+        return;
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        if (!(counter_mask & (1UL << i))) {
+            continue;
+        }
+
+        uint32_t count = read_count(i);
+        uint32_t pulses = count - channels[i].window_start_count;
+        channels[i].window_start_count = count;
+        channels[i].frequency_mhz = (uint32_t)(((uint64_t)pulses * 1000000000ULL) / (uint64_t)elapsed_us);
+
+        if (channels[i].frequency_mhz >= rate_thresholds_mhz[i]) {
+            bits |= 1UL << i;
+        }
+    }
+
+    rate_bits = bits;
+    window_start_us = now_us;
+}
+
+uint32_t input_counter_get_mask(void)
+{
+    return counter_mask;
+}
+
+uint32_t input_counter_get_rate_bits(void)
+{
+    return rate_bits;
+}
+
+void input_counter_get_info(uint8_t input_num, input_counter_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    if (input_num >= NUM_INPUTS) {
+        return;
+    }
+
+    info->source = channels[input_num].source;
+    if (info->source != INPUT_COUNTER_NONE) {
+        info->count = read_count(input_num);
+        info->frequency_mhz = channels[input_num].frequency_mhz;
+        info->rate_active = (rate_bits & (1UL << input_num)) != 0;
+    }
+}
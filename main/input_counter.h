@@ -0,0 +1,31 @@
+#ifndef INPUT_COUNTER_H
+#define INPUT_COUNTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+
+// How a counter input is being counted
+typedef enum {
+    INPUT_COUNTER_NONE = 0,     // Level input, not counted
+    INPUT_COUNTER_PCNT,         // PCNT unit, no CPU per pulse
+    INPUT_COUNTER_ISR           // Fallback: falling edges counted in gpio_isr_handler
+} input_counter_source_t;
+
+typedef struct {
+    input_counter_source_t source;
+    uint32_t count;             // Total pulses since boot
+    uint32_t frequency_mhz;     // Pulse rate over the last window, in milli-Hertz
+    bool rate_active;           // frequency >= configured threshold
+} input_counter_info_t;
+
+// Function prototypes
+esp_err_t input_counter_init(void);
+bool IRAM_ATTR input_counter_isr_edge(uint32_t input_num);
+void input_counter_update(int64_t now_us);
+uint32_t input_counter_get_mask(void);
+uint32_t input_counter_get_rate_bits(void);
+void input_counter_get_info(uint8_t input_num, input_counter_info_t *info);
+
+#endif // INPUT_COUNTER_H
@@ -0,0 +1,273 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "auto_board.h"
+#include "time_base.h"
+#include "input_debounce.h"
+#include "input_sample.h"
+#include "input_counter.h"
+#include "input_storm.h"
+#include "input_profile.h"
+#include "hotpath_audit.h"
+#include "scan_cycle.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "INPUT_DEBOUNCE";
+
+// External variables (defined in main.c)
+extern TaskHandle_t input_task_handle;
+
+_Static_assert(NUM_INPUTS <= 32, "debounce_vc_t packs at most 32 inputs per word");
+
+// Single sample tick, running only while at least one input is unsettled
+static esp_timer_handle_t debounce_tick_timer;
+static bool tick_running = false;
+
+// Packed state of all inputs; stable holds the active (polarity-applied) level
+static debounce_vc_t vc_state;
+static uint32_t level_mask = UINT32_MAX;
+static volatile uint32_t debounced_bits = 0;
+static int64_t last_edge_us[NUM_INPUTS];
+
+// Filter state, only touched by input_task
+static uint32_t applied_generation = 0;    // Table the filters were last restarted for
+static uint32_t applied_invert = 0;
+static volatile uint32_t applied_lockout = 0;
+static uint32_t locked_bits = 0;            // Edge-lockout inputs inside their lockout
+static uint32_t majority_pending = 0;       // Majority inputs whose history is mixed
+static uint16_t divider_left[NUM_INPUTS];
+static uint16_t lockout_left[NUM_INPUTS];
+static uint8_t majority_history[NUM_INPUTS];
+
+const uint32_t debounce_hist_limits_us[DEBOUNCE_HIST_BUCKETS - 1] = {
+    250, 500, 1000, 2000, 5000, 10000, 20000
+};
+
+static debounce_latency_stats_t latency_stats = {
+    .min_us = UINT32_MAX
+};
+
+static void debounce_tick_callback(void *arg)
+{
+    if (input_task_handle != NULL) {
+        xTaskNotify(input_task_handle, INPUT_NOTIFY_TICK, eSetBits);
+    }
+}
+
+static void record_latency(int64_t latency_us, uint32_t nominal_ms)
+{
+    uint32_t excess_us = 0;
+    if (latency_us > (int64_t)nominal_ms * 1000) {
+        excess_us = (uint32_t)(latency_us - (int64_t)nominal_ms * 1000);
+    }
+
+    int bucket = 0;
+    while (bucket < DEBOUNCE_HIST_BUCKETS - 1 && excess_us >= debounce_hist_limits_us[bucket]) {
+        bucket++;
+    }
+
+    latency_stats.buckets[bucket]++;
+    latency_stats.samples++;
+    if (excess_us < latency_stats.min_us) {
+        latency_stats.min_us = excess_us;
+    }
+    if (excess_us > latency_stats.max_us) {
+        latency_stats.max_us = excess_us;
+    }
+}
+
+// Restart every filter from 'stable' under a (new) profile table
+static void apply_table(const input_profile_table_t *table, uint32_t stable)
+{
+    debounce_vc_reset(&vc_state, stable);
+    locked_bits = 0;
+    majority_pending = 0;
+
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        divider_left[i] = table->divider[i];
+        lockout_left[i] = 0;
+        majority_history[i] = (stable & (1UL << i)) ? UINT8_MAX : 0;
+    }
+
+    applied_generation = table->generation;
+    applied_invert = table->invert_mask;
+    applied_lockout = table->lockout_mask;
+    debounced_bits = stable;
+}
+
+esp_err_t input_debounce_init(void)
+{
+    esp_timer_create_args_t timer_args = {
+        .callback = debounce_tick_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "debounce_tick"
+    };
+
+    esp_err_t ret = esp_timer_create(&timer_args, &debounce_tick_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create debounce tick timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Inputs start out stable at whatever level they are at now;
+    // counter inputs are measured by input_counter and never debounced
+    level_mask = ~input_counter_get_mask();
+    const input_profile_table_t *table = input_profile_acquire();
+    apply_table(table, (input_sample_snapshot() ^ table->invert_mask) & level_mask);
+    input_profile_release();
+    memset(last_edge_us, 0, sizeof(last_edge_us));
+
+    ESP_LOGI(TAG, "Profile-driven debounce ready (%d ms tick)", INPUT_DEBOUNCE_TICK_MS);
+    return ESP_OK;
+}
+
+void input_debounce_edges(const input_event_t *events, size_t count)
+{
+    uint32_t touched = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        last_edge_us[events[i].input_num] = events[i].timestamp_us;
+        touched |= 1UL << events[i].input_num;
+
+        ESP_LOGD(TAG, "Input %d changed to %s",
+                events[i].input_num + 1,
+                events[i].state ? "HIGH" : "LOW");
+    }
+
+    if (count > 0 && !tick_running) {
+        esp_timer_start_periodic(debounce_tick_timer, DEBOUNCE_TICK_US);
+        tick_running = true;
+    }
+
+    // Edge-lockout inputs react to the first edge without waiting for a tick
+    if (touched & applied_lockout) {
+        input_debounce_tick();
+    }
+}
+
+void input_debounce_tick(void)
+{
+    HOTPATH_BEGIN(HOTPATH_DEBOUNCE);
+    const input_profile_table_t *table = input_profile_acquire();
+    uint32_t raw = input_sample_snapshot() & level_mask;
+    int64_t now = time_base_now_us();
+
+    // Storm-masked inputs are polled here until they settle
+    input_storm_poll(raw, now);
+
+    // A profile edit from the web UI takes effect on the next tick. Two
+    // edits can reuse the same buffer, so the generation tells them apart.
+    if (table->generation != applied_generation) {
+        uint32_t before = debounced_bits;
+        apply_table(table, (vc_state.stable ^ applied_invert ^ table->invert_mask) & level_mask);
+        if (debounced_bits != before) {
+            scan_cycle_notify(SCAN_EVENT_INPUT);      // A polarity change flips the input at once
+        }
+    }
+
+    uint32_t sample = (raw ^ table->invert_mask) & level_mask;
+    uint32_t previous = vc_state.stable;
+
+    // Inputs whose sample divider expires on this tick
+    uint32_t due = 0;
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        if (--divider_left[i] == 0) {
+            divider_left[i] = table->divider[i];
+            due |= 1UL << i;
+        }
+    }
+
+    // Integrating: vertical counter over every due input at once
+    debounce_vc_update_masked(&vc_state, sample, due & table->integrating_mask);
+
+    // Edge lockout: the first edge is taken at once, then held
+    for (uint32_t bits = locked_bits; bits; bits &= bits - 1) {
+        int i = __builtin_ctz(bits);
+        if (--lockout_left[i] == 0) {
+            locked_bits &= ~(1UL << i);
+        }
+    }
+    uint32_t flip = (sample ^ vc_state.stable) & table->lockout_mask & ~locked_bits;
+    vc_state.stable ^= flip;
+    locked_bits |= flip;
+    for (uint32_t bits = flip; bits; bits &= bits - 1) {
+        int i = __builtin_ctz(bits);
+        lockout_left[i] = table->lockout_ticks[i];
+    }
+
+    // Majority of the last N samples
+    for (uint32_t bits = due & table->majority_mask; bits; bits &= bits - 1) {
+        int i = __builtin_ctz(bits);
+        uint32_t bit = 1UL << i;
+        uint8_t n = table->majority_samples[i];
+        uint8_t full = (uint8_t)((1U << n) - 1);
+        uint8_t history = (uint8_t)(((majority_history[i] << 1) | ((sample & bit) ? 1 : 0)) & full);
+        majority_history[i] = history;
+
+        if (__builtin_popcount(history) > n / 2) {
+            vc_state.stable |= bit;
+        } else {
+            vc_state.stable &= ~bit;
+        }
+
+        if (history == 0 || history == full) {
+            majority_pending &= ~bit;
+        } else {
+            majority_pending |= bit;
+        }
+    }
+
+    uint32_t toggled = previous ^ vc_state.stable;
+    if (toggled) {
+        debounced_bits = vc_state.stable;
+        scan_cycle_notify(SCAN_EVENT_INPUT);
+
+        for (int i = 0; i < NUM_INPUTS; i++) {
+            if (toggled & (1UL << i)) {
+                record_latency(now - last_edge_us[i], table->nominal_ms[i]);
+                ESP_LOGI(TAG, "Input %d debounced state: %s",
+                        i + 1,
+                        (vc_state.stable & (1UL << i)) ? "ACTIVE" : "INACTIVE");
+            }
+        }
+    }
+
+    // Every filter is idle once the sample matches the stable image, no
+    // lockout is running and no majority history is mixed; keep ticking
+    // while any input is storm-masked so it is still being sampled
+    bool settled = (sample == vc_state.stable) && locked_bits == 0 && majority_pending == 0;
+    if (settled && input_storm_get_mask() == 0 && tick_running) {
+        esp_timer_stop(debounce_tick_timer);
+        tick_running = false;
+
+        // The next edge starts from a full count and a full divider, not
+        // from whatever a bounce that died out left behind
+        debounce_vc_reset(&vc_state, vc_state.stable);
+        for (int i = 0; i < NUM_INPUTS; i++) {
+            divider_left[i] = table->divider[i];
+        }
+    }
+
+    input_profile_release();
+    HOTPATH_END(HOTPATH_DEBOUNCE);
+}
+
+uint32_t input_debounce_get_state(void)
+{
+    return debounced_bits;
+}
+
+void input_debounce_get_latency(debounce_latency_stats_t *stats)
+{
+    memcpy(stats, &latency_stats, sizeof(*stats));
+    if (stats->samples == 0) {
+        stats->min_us = 0;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef INPUT_DEBOUNCE_H
+#define INPUT_DEBOUNCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "auto_board.h"
+#include "auto_board_config.h"
+
+// input_task notification bits
+#define INPUT_NOTIFY_EDGE       (1UL << 31)   // New edges waiting in the ring
+#define INPUT_NOTIFY_TICK       (1UL << 0)    // Debounce sample tick
+
+// Vertical-counter debounce: a 2-bit counter per input, so a level must be
+// sampled DEBOUNCE_VC_SAMPLES times in a row before it becomes stable.
+// Each input samples every few ticks according to its profile.
+#define DEBOUNCE_VC_SAMPLES     4
+#define DEBOUNCE_TICK_US        (INPUT_DEBOUNCE_TICK_MS * 1000)
+
+// Edge-to-debounced latency histogram, measured as the delay beyond the
+// input's configured debounce time from the last edge seen in the ISR
+#define DEBOUNCE_HIST_BUCKETS   8
+
+// Packed debounce state for up to 32 inputs, bit n = input n
+typedef struct {
+    uint32_t stable;    // Debounced state
+    uint32_t cnt0;      // Counter bit 0 of every input
+    uint32_t cnt1;      // Counter bit 1 of every input
+} debounce_vc_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t buckets[DEBOUNCE_HIST_BUCKETS];
+} debounce_latency_stats_t;
+
+// Upper bound (exclusive, in microseconds) of each histogram bucket;
+// the last bucket is open-ended
+extern const uint32_t debounce_hist_limits_us[DEBOUNCE_HIST_BUCKETS - 1];
+
+// Reset all counters and start from a known level
+static inline void debounce_vc_reset(debounce_vc_t *vc, uint32_t level)
+{
+    vc->stable = level;
+    vc->cnt0 = UINT32_MAX;
+    vc->cnt1 = UINT32_MAX;
+}
+
+// Feed one sample of the inputs in 'enable'; returns the bits whose stable
+// state flipped. Counters of inputs that match their stable state are
+// reloaded, the others count down and flip on the DEBOUNCE_VC_SAMPLES-th
+// consecutive mismatch. Inputs outside 'enable' are left untouched.
+static inline uint32_t debounce_vc_update_masked(debounce_vc_t *vc, uint32_t sample, uint32_t enable)
+{
+    uint32_t delta = (sample ^ vc->stable) & enable;
+
+    uint32_t cnt0 = ~(vc->cnt0 & delta);
+    uint32_t cnt1 = cnt0 ^ (vc->cnt1 & delta);
+    vc->cnt0 = (vc->cnt0 & ~enable) | (cnt0 & enable);
+    vc->cnt1 = (vc->cnt1 & ~enable) | (cnt1 & enable);
+
+    uint32_t toggle = delta & cnt0 & cnt1;
+    vc->stable ^= toggle;
+    return toggle;
+}
+
+static inline uint32_t debounce_vc_update(debounce_vc_t *vc, uint32_t sample)
+{
+    return debounce_vc_update_masked(vc, sample, UINT32_MAX);
+}
+
+// Function prototypes
+esp_err_t input_debounce_init(void);
+void input_debounce_edges(const input_event_t *events, size_t count);
+void input_debounce_tick(void);
+// Debounced inputs with polarity applied: bit n set = input n active
+uint32_t input_debounce_get_state(void);
+void input_debounce_get_latency(debounce_latency_stats_t *stats);
+
+#endif // INPUT_DEBOUNCE_H
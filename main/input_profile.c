@@ -0,0 +1,233 @@
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "auto_board.h"
+#include "auto_board_config.h"
+#include "input_profile.h"
+#include "input_debounce.h"
+
+// External variables (defined in main.c)
+extern TaskHandle_t input_task_handle;
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "INPUT_PROFILE";
+
+static const char *filter_names[INPUT_FILTER_COUNT] = {
+    "integrating", "lockout", "majority"
+};
+
+static input_profile_t profiles[NUM_INPUTS];
+
+// Double-buffered compiled table. The input stage reads the active one
+// without locks; writers fill the spare one and swap the pointer.
+static input_profile_table_t tables[2];
+static _Atomic(input_profile_table_t *) active_table = &tables[0];
+static atomic_uint reader_seq = 0;      // Odd while a tick is using the table
+static SemaphoreHandle_t writer_mutex = NULL;
+static uint32_t table_generation = 0;
+
+static void set_defaults(void)
+{
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        profiles[i].debounce_ms = INPUT_DEBOUNCE_MS;
+        profiles[i].filter = INPUT_FILTER_INTEGRATING;
+        profiles[i].active_low = INPUT_ACTIVE_LOW;
+        profiles[i].samples = 5;
+        profiles[i].reserved = 0;
+    }
+}
+
+static bool profile_valid(const input_profile_t *profile)
+{
+    if (profile->filter >= INPUT_FILTER_COUNT) {
+        return false;
+    }
+    if (profile->debounce_ms < INPUT_DEBOUNCE_MIN_MS || profile->debounce_ms > INPUT_DEBOUNCE_MAX_MS) {
+        return false;
+    }
+    if (profile->filter == INPUT_FILTER_MAJORITY &&
+        (profile->samples < INPUT_MAJORITY_MIN_SAMPLES || profile->samples > INPUT_MAJORITY_MAX_SAMPLES ||
+         (profile->samples & 1) == 0)) {
+        return false;
+    }
+    return true;
+}
+
+static uint32_t ticks_for(uint32_t ms, uint32_t per_tick_samples)
+{
+    uint32_t span = INPUT_DEBOUNCE_TICK_MS * per_tick_samples;
+    uint32_t ticks = (ms + span / 2) / span;
+    if (ticks < 1) {
+        ticks = 1;
+    }
+    return ticks > UINT16_MAX ? UINT16_MAX : ticks;
+}
+
+static void compile_table(input_profile_table_t *table)
+{
+    memset(table, 0, sizeof(*table));
+    table->generation = ++table_generation;
+
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        const input_profile_t *p = &profiles[i];
+        uint32_t bit = 1UL << i;
+
+        if (p->active_low) {
+            table->invert_mask |= bit;
+        }
+
+        switch (p->filter) {
+        case INPUT_FILTER_EDGE_LOCKOUT:
+            table->lockout_mask |= bit;
+            table->divider[i] = 1;
+            table->lockout_ticks[i] = (p->debounce_ms + INPUT_DEBOUNCE_TICK_MS - 1) / INPUT_DEBOUNCE_TICK_MS;
+            table->nominal_ms[i] = 0;
+            break;
+        case INPUT_FILTER_MAJORITY:
+            table->majority_mask |= bit;
+            table->majority_samples[i] = p->samples;
+            table->divider[i] = ticks_for(p->debounce_ms, p->samples);
+            table->nominal_ms[i] = p->debounce_ms;
+            break;
+        case INPUT_FILTER_INTEGRATING:
+        default:
+            table->integrating_mask |= bit;
+            table->divider[i] = ticks_for(p->debounce_ms, DEBOUNCE_VC_SAMPLES);
+            table->nominal_ms[i] = p->debounce_ms;
+            break;
+        }
+    }
+}
+
+static void publish_table(void)
+{
+    input_profile_table_t *current = atomic_load(&active_table);
+    input_profile_table_t *spare = (current == &tables[0]) ? &tables[1] : &tables[0];
+
+    // The spare buffer was active before the last swap: wait until no tick
+    // that may still hold it is running
+    uint32_t seq = atomic_load(&reader_seq);
+    while (seq & 1) {
+        vTaskDelay(1);
+        if (atomic_load(&reader_seq) != seq) {
+            break;
+        }
+    }
+
+    compile_table(spare);
+    atomic_store(&active_table, spare);
+}
+
+static esp_err_t save_profiles(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(INPUT_PROFILE_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_set_blob(nvs_handle, "profiles", profiles, sizeof(profiles));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t input_profile_init(void)
+{
+    set_defaults();
+    writer_mutex = xSemaphoreCreateMutex();
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open(INPUT_PROFILE_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        input_profile_t stored[NUM_INPUTS];
+        size_t len = sizeof(stored);
+        esp_err_t err = nvs_get_blob(nvs_handle, "profiles", stored, &len);
+        nvs_close(nvs_handle);
+
+        if (err == ESP_OK && len == sizeof(stored)) {
+            for (int i = 0; i < NUM_INPUTS; i++) {
+                if (profile_valid(&stored[i])) {
+                    profiles[i] = stored[i];
+                } else {
+                    ESP_LOGW(TAG, "Input %d: stored profile invalid, using defaults", i + 1);
+                }
+            }
+            ESP_LOGI(TAG, "Loaded input profiles from NVS");
+        } else {
+            ESP_LOGI(TAG, "No stored input profiles, using defaults");
+        }
+    }
+
+    compile_table(&tables[0]);
+    atomic_store(&active_table, &tables[0]);
+    return writer_mutex != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void input_profile_get(uint8_t input_num, input_profile_t *profile)
+{
+    if (input_num < NUM_INPUTS) {
+        *profile = profiles[input_num];
+    }
+}
+
+esp_err_t input_profile_set(uint8_t input_num, const input_profile_t *profile)
+{
+    if (input_num >= NUM_INPUTS || !profile_valid(profile)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(writer_mutex, portMAX_DELAY);
+    profiles[input_num] = *profile;
+    profiles[input_num].reserved = 0;
+    publish_table();
+    esp_err_t err = save_profiles();
+    xSemaphoreGive(writer_mutex);
+
+    // Apply it now rather than at the next edge, which on an idle input
+    // may never come
+    if (input_task_handle != NULL) {
+        xTaskNotify(input_task_handle, INPUT_NOTIFY_TICK, eSetBits);
+    }
+
+    ESP_LOGI(TAG, "Input %d profile: %s, %u ms, active %s",
+             input_num + 1, filter_names[profile->filter], profile->debounce_ms,
+             profile->active_low ? "LOW" : "HIGH");
+    return err;
+}
+
+const input_profile_table_t *input_profile_acquire(void)
+{
+    atomic_fetch_add(&reader_seq, 1);
+    return atomic_load(&active_table);
+}
+
+void input_profile_release(void)
+{
+    atomic_fetch_add(&reader_seq, 1);
+}
+
+const char *input_profile_filter_name(uint8_t filter)
+{
+    return filter < INPUT_FILTER_COUNT ? filter_names[filter] : "unknown";
+}
+
+int input_profile_filter_from_name(const char *name)
+{
+    for (int i = 0; i < INPUT_FILTER_COUNT; i++) {
+        if (strcmp(name, filter_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,55 @@
+#ifndef INPUT_PROFILE_H
+#define INPUT_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "auto_board.h"
+
+#define INPUT_PROFILE_NAMESPACE "input_cfg"
+
+// Debounce filter types
+typedef enum {
+    INPUT_FILTER_INTEGRATING = 0,   // Level must hold for debounce_ms (vertical counter)
+    INPUT_FILTER_EDGE_LOCKOUT,      // First edge wins, then ignore changes for debounce_ms
+    INPUT_FILTER_MAJORITY,          // Majority of the last N samples over debounce_ms
+    INPUT_FILTER_COUNT
+} input_filter_t;
+
+#define INPUT_MAJORITY_MIN_SAMPLES  3
+#define INPUT_MAJORITY_MAX_SAMPLES  7
+#define INPUT_DEBOUNCE_MIN_MS       INPUT_DEBOUNCE_TICK_MS
+#define INPUT_DEBOUNCE_MAX_MS       5000
+
+// Per-input profile as stored in NVS and edited from the web UI
+typedef struct {
+    uint16_t debounce_ms;
+    uint8_t filter;         // input_filter_t
+    uint8_t active_low;
+    uint8_t samples;        // N for INPUT_FILTER_MAJORITY
+    uint8_t reserved;
+} input_profile_t;
+
+// Compiled table used by the input stage on every debounce tick
+typedef struct {
+    uint32_t invert_mask;       // Active-low inputs
+    uint32_t integrating_mask;
+    uint32_t lockout_mask;
+    uint32_t majority_mask;
+    uint16_t divider[NUM_INPUTS];       // Ticks between samples
+    uint16_t lockout_ticks[NUM_INPUTS];
+    uint8_t majority_samples[NUM_INPUTS];
+    uint16_t nominal_ms[NUM_INPUTS];    // Expected edge-to-state delay
+    uint32_t generation;                // Bumped by every publish; the buffers are reused
+} input_profile_table_t;
+
+// Function prototypes
+esp_err_t input_profile_init(void);
+void input_profile_get(uint8_t input_num, input_profile_t *profile);
+esp_err_t input_profile_set(uint8_t input_num, const input_profile_t *profile);
+const input_profile_table_t *input_profile_acquire(void);
+void input_profile_release(void);
+const char *input_profile_filter_name(uint8_t filter);
+int input_profile_filter_from_name(const char *name);
+
+#endif // INPUT_PROFILE_H
@@ -0,0 +1,58 @@
+#include <stdatomic.h>
+#include "esp_attr.h"
+#include "input_ring.h"
+
+// Lock-free single-producer/single-consumer ring of input edges.
+// head is only written by the ISR, tail only by input_task; both are
+// free-running counters so full/empty never need a spare slot.
+static input_event_t ring[INPUT_RING_SIZE];
+static atomic_uint_fast32_t ring_head = 0;
+static atomic_uint_fast32_t ring_tail = 0;
+
+static atomic_uint_fast32_t ring_pushed = 0;
+static atomic_uint_fast32_t ring_overflows = 0;
+static uint32_t ring_high_water = 0;
+
+_Static_assert((INPUT_RING_SIZE & (INPUT_RING_SIZE - 1)) == 0, "INPUT_RING_SIZE must be a power of two");
+
+bool IRAM_ATTR input_ring_push(const input_event_t *event)
+{
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+
+    if (head - tail >= INPUT_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring_overflows, 1, memory_order_relaxed);
+        return false;
+    }
+
+    ring[head & (INPUT_RING_SIZE - 1)] = *event;
+    atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+    atomic_fetch_add_explicit(&ring_pushed, 1, memory_order_relaxed);
+    return true;
+}
+
+size_t input_ring_pop_batch(input_event_t *events, size_t max_events)
+{
+    uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    uint32_t available = head - tail;
+
+    if (available > ring_high_water) {
+        ring_high_water = available;
+    }
+
+    size_t count = available < max_events ? available : max_events;
+    for (size_t i = 0; i < count; i++) {
+        events[i] = ring[(tail + i) & (INPUT_RING_SIZE - 1)];
+    }
+
+    atomic_store_explicit(&ring_tail, tail + count, memory_order_release);
+    return count;
+}
+
+void input_ring_get_stats(input_ring_stats_t *stats)
+{
+    stats->pushed = atomic_load_explicit(&ring_pushed, memory_order_relaxed);
+    stats->overflows = atomic_load_explicit(&ring_overflows, memory_order_relaxed);
+    stats->high_water = ring_high_water;
+}
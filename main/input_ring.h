@@ -0,0 +1,27 @@
+#ifndef INPUT_RING_H
+#define INPUT_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "auto_board.h"
+
+// Ring configuration (must be a power of two)
+#define INPUT_RING_SIZE         64
+#define INPUT_RING_BATCH_SIZE   16   // Max events drained per input_task pass
+
+// Ring statistics
+typedef struct {
+    uint32_t pushed;        // Edges accepted from the ISR
+    uint32_t overflows;     // Edges dropped because the ring was full
+    uint32_t high_water;    // Deepest fill level seen by the consumer
+} input_ring_stats_t;
+
+// Function prototypes
+// Producer side: only gpio_isr_handler may push
+bool IRAM_ATTR input_ring_push(const input_event_t *event);
+// Consumer side: only input_task may pop
+size_t input_ring_pop_batch(input_event_t *events, size_t max_events);
+void input_ring_get_stats(input_ring_stats_t *stats);
+
+#endif // INPUT_RING_H
@@ -0,0 +1,56 @@
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "auto_board.h"
+#include "input_sample.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "INPUT_SAMPLE";
+
+// External variables (defined in main.c)
+extern const gpio_num_t input_gpios[];
+
+#ifdef INPUT_SAMPLE_FAKE_REG
+volatile uint32_t input_sample_fake_in = 0;
+#endif
+
+// GPIO.in bitmap of the configured inputs and the pin of each logical input
+static DRAM_ATTR uint32_t input_gpio_mask = 0;
+static DRAM_ATTR uint8_t input_gpio_shift[NUM_INPUTS];
+
+void input_sample_init(void)
+{
+    input_gpio_mask = 0;
+
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        // GPIO_IN_REG only covers GPIO0-31
+        if (input_gpios[i] >= 32) {
+            ESP_LOGE(TAG, "Input %d on GPIO %d is outside GPIO_IN_REG", i + 1, input_gpios[i]);
+            continue;
+        }
+        input_gpio_shift[i] = (uint8_t)input_gpios[i];
+        input_gpio_mask |= 1UL << input_gpios[i];
+    }
+
+    ESP_LOGI(TAG, "Input sampling mask: 0x%08lx", input_gpio_mask);
+}
+
+uint32_t IRAM_ATTR input_sample_snapshot(void)
+{
+    // One register read: every input is sampled at the same instant
+    uint32_t reg = INPUT_SAMPLE_READ_REG() & input_gpio_mask;
+    uint32_t bits = 0;
+
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        bits |= ((reg >> input_gpio_shift[i]) & 1UL) << i;
+    }
+    return bits;
+}
+
+uint32_t input_sample_get_gpio_mask(void)
+{
+    return input_gpio_mask;
+}
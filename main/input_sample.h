@@ -0,0 +1,26 @@
+#ifndef INPUT_SAMPLE_H
+#define INPUT_SAMPLE_H
+
+#include <stdint.h>
+#include "esp_attr.h"
+
+// Input sampling layer: one read of the GPIO input register per scan,
+// masked and packed so that bit n = level of input n.
+//
+// Host builds define INPUT_SAMPLE_FAKE_REG and drive input_sample_fake_in
+// instead of the hardware register.
+
+#ifdef INPUT_SAMPLE_FAKE_REG
+extern volatile uint32_t input_sample_fake_in;
+#define INPUT_SAMPLE_READ_REG()  (input_sample_fake_in)
+#else
+#include "soc/gpio_reg.h"
+#define INPUT_SAMPLE_READ_REG()  REG_READ(GPIO_IN_REG)
+#endif
+
+// Function prototypes
+void input_sample_init(void);
+uint32_t IRAM_ATTR input_sample_snapshot(void);
+uint32_t input_sample_get_gpio_mask(void);
+
+#endif // INPUT_SAMPLE_H
@@ -0,0 +1,100 @@
+#include <stdatomic.h>
+#include <string.h>
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "auto_board.h"
+#include "auto_board_config.h"
+#include "input_storm.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "INPUT_STORM";
+
+// External variables (defined in main.c)
+extern const gpio_num_t input_gpios[];
+
+typedef struct {
+    int64_t window_start_us;    // ISR only
+    uint32_t window_edges;      // ISR only
+    uint32_t storm_count;
+    int64_t masked_since_us;
+    int64_t last_change_us;     // Task only, while masked
+} storm_state_t;
+
+static DRAM_ATTR storm_state_t storm_states[NUM_INPUTS];
+static atomic_uint_fast32_t storm_mask = 0;
+static uint32_t last_sample = 0;
+
+bool IRAM_ATTR input_storm_check(uint32_t input_num, int64_t timestamp_us)
+{
+    storm_state_t *state = &storm_states[input_num];
+
+    if (timestamp_us - state->window_start_us >= (int64_t)INPUT_STORM_WINDOW_MS * 1000) {
+        state->window_start_us = timestamp_us;
+        state->window_edges = 0;
+    }
+
+    if (++state->window_edges <= INPUT_STORM_MAX_EDGES) {
+        return false;
+    }
+
+    // Too many edges: stop interrupting and let the debounce tick poll it
+    gpio_intr_disable(input_gpios[input_num]);
+    state->storm_count++;
+    state->masked_since_us = timestamp_us;
+    state->last_change_us = timestamp_us;
+    atomic_fetch_or_explicit(&storm_mask, 1UL << input_num, memory_order_release);
+    return true;
+}
+
+void input_storm_poll(uint32_t sample, int64_t now_us)
+{
+    uint32_t masked = atomic_load_explicit(&storm_mask, memory_order_acquire);
+    uint32_t changed = sample ^ last_sample;
+    last_sample = sample;
+
+    if (masked == 0) {
+        return;
+    }
+
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        if (!(masked & (1UL << i))) {
+            continue;
+        }
+
+        storm_state_t *state = &storm_states[i];
+        if (changed & (1UL << i)) {
+            state->last_change_us = now_us;
+        } else if (now_us - state->last_change_us >= (int64_t)INPUT_STORM_SETTLE_MS * 1000) {
+            // Quiet for long enough: hand the input back to the ISR
+            state->window_start_us = now_us;
+            state->window_edges = 0;
+            atomic_fetch_and_explicit(&storm_mask, ~(1UL << i), memory_order_release);
+            gpio_intr_enable(input_gpios[i]);
+
+            ESP_LOGI(TAG, "Input %d settled after %lld ms, interrupt re-enabled",
+                     i + 1, (now_us - state->masked_since_us) / 1000);
+        }
+    }
+}
+
+uint32_t input_storm_get_mask(void)
+{
+    return atomic_load_explicit(&storm_mask, memory_order_acquire);
+}
+
+void input_storm_get_info(uint8_t input_num, input_storm_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    if (input_num >= NUM_INPUTS) {
+        return;
+    }
+
+    info->masked = (input_storm_get_mask() & (1UL << input_num)) != 0;
+    info->storm_count = storm_states[input_num].storm_count;
+    info->masked_since_us = storm_states[input_num].masked_since_us;
+}
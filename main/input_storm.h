@@ -0,0 +1,23 @@
+#ifndef INPUT_STORM_H
+#define INPUT_STORM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_attr.h"
+
+// Per-input storm state, reported through the status API
+typedef struct {
+    bool masked;            // Interrupt disabled, input is being polled
+    uint32_t storm_count;   // Number of times the input has been masked
+    int64_t masked_since_us;
+} input_storm_info_t;
+
+// Function prototypes
+// ISR side: returns true when this edge pushed the input over the limit
+bool IRAM_ATTR input_storm_check(uint32_t input_num, int64_t timestamp_us);
+// Task side: called with every polled sample while any input is masked
+void input_storm_poll(uint32_t sample, int64_t now_us);
+uint32_t input_storm_get_mask(void);
+void input_storm_get_info(uint8_t input_num, input_storm_info_t *info);
+
+#endif // INPUT_STORM_H
@@ -0,0 +1,273 @@
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "auto_board.h"
+#include "auto_board_config.h"
+#include "io_map.h"
+#include "output_image.h"
+#include "scan_cycle.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "IO_MAP";
+
+#define INPUTS_MASK     ((1UL << NUM_INPUTS) - 1)
+
+static const char *mode_names[IO_MAP_MODE_COUNT] = {
+    "level", "toggle", "set", "reset"
+};
+
+// Factory mapping from auto_board_config.h, 1-based, 0 = none
+static const uint8_t default_outputs[] = {
+    INPUT_1_CONTROLS_OUTPUT, INPUT_2_CONTROLS_OUTPUT, INPUT_3_CONTROLS_OUTPUT,
+    INPUT_4_CONTROLS_OUTPUT, INPUT_5_CONTROLS_OUTPUT
+};
+
+_Static_assert(sizeof(default_outputs) == NUM_INPUTS, "one default mapping per input");
+
+static io_map_link_t links[IO_MAP_MAX_LINKS];
+static int link_count = 0;
+
+// Double-buffered compiled table. The scan reads the active one without
+// locks; writers fill the spare one and swap the pointer.
+static io_map_table_t tables[2];
+static _Atomic(io_map_table_t *) active_table = &tables[0];
+static atomic_uint reader_seq = 0;      // Odd while the scan is using the table
+static SemaphoreHandle_t writer_mutex = NULL;
+
+// Owned by the scan task
+static uint32_t last_widened = 0;
+static bool primed = false;
+static atomic_uint latched = 0;
+
+static void set_defaults(void)
+{
+    link_count = 0;
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        if (default_outputs[i] >= 1 && default_outputs[i] <= NUM_OUTPUTS) {
+            links[link_count++] = (io_map_link_t) {
+                .input = i,
+                .output = default_outputs[i] - 1,
+                .mode = IO_MAP_LEVEL,
+                .invert = 0
+            };
+        }
+    }
+}
+
+static bool link_valid(const io_map_link_t *link)
+{
+    return link->input < NUM_INPUTS && link->output < NUM_OUTPUTS && link->mode < IO_MAP_MODE_COUNT &&
+           link->invert <= 1;
+}
+
+static void compile_table(io_map_table_t *table)
+{
+    memset(table, 0, sizeof(*table));
+
+    for (int i = 0; i < link_count; i++) {
+        const io_map_link_t *link = &links[i];
+        uint32_t source = 1UL << (link->input + (link->invert ? NUM_INPUTS : 0));
+        int o = link->output;
+
+        switch (link->mode) {
+        case IO_MAP_TOGGLE:
+            table->toggle[o] |= source;
+            break;
+        case IO_MAP_SET:
+            table->set[o] |= source;
+            break;
+        case IO_MAP_RESET:
+            table->reset[o] |= source;
+            break;
+        case IO_MAP_LEVEL:
+        default:
+            table->level[o] |= source;
+            break;
+        }
+
+        if (link->mode != IO_MAP_LEVEL) {
+            table->latch_mask |= 1UL << o;
+        }
+    }
+}
+
+static void publish_table(void)
+{
+    io_map_table_t *current = atomic_load(&active_table);
+    io_map_table_t *spare = (current == &tables[0]) ? &tables[1] : &tables[0];
+
+    // The spare buffer was active before the last swap: wait until no scan
+    // that may still hold it is running
+    uint32_t seq = atomic_load(&reader_seq);
+    while (seq & 1) {
+        vTaskDelay(1);
+        if (atomic_load(&reader_seq) != seq) {
+            break;
+        }
+    }
+
+    compile_table(spare);
+    atomic_store(&active_table, spare);
+}
+
+static esp_err_t save_links(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(IO_MAP_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // An empty table is stored too, so it does not fall back to the defaults
+    err = nvs_set_blob(nvs_handle, "links", links, link_count * sizeof(io_map_link_t));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t io_map_init(void)
+{
+    set_defaults();
+    writer_mutex = xSemaphoreCreateMutex();
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open(IO_MAP_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        io_map_link_t stored[IO_MAP_MAX_LINKS];
+        size_t len = sizeof(stored);
+        esp_err_t err = nvs_get_blob(nvs_handle, "links", stored, &len);
+        nvs_close(nvs_handle);
+
+        bool valid = err == ESP_OK && len % sizeof(io_map_link_t) == 0;
+        int count = valid ? len / sizeof(io_map_link_t) : 0;
+        for (int i = 0; i < count; i++) {
+            valid = valid && link_valid(&stored[i]);
+        }
+
+        if (valid) {
+            memcpy(links, stored, len);
+            link_count = count;
+            ESP_LOGI(TAG, "Loaded %d input-output links from NVS", count);
+        } else if (err == ESP_OK) {
+            ESP_LOGW(TAG, "Stored input-output links invalid, using defaults");
+        }
+    }
+
+    compile_table(&tables[0]);
+    atomic_store(&active_table, &tables[0]);
+    return writer_mutex != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t io_map_set_links(const io_map_link_t *new_links, int count)
+{
+    if (count < 0 || count > IO_MAP_MAX_LINKS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!link_valid(&new_links[i])) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    xSemaphoreTake(writer_mutex, portMAX_DELAY);
+    memcpy(links, new_links, count * sizeof(io_map_link_t));
+    link_count = count;
+    publish_table();
+    esp_err_t err = save_links();
+    xSemaphoreGive(writer_mutex);
+
+    for (int i = 0; i < count; i++) {
+        ESP_LOGI(TAG, "Link %d: input %d -> output %d, %s%s",
+                 i + 1, new_links[i].input + 1, new_links[i].output + 1,
+                 mode_names[new_links[i].mode], new_links[i].invert ? ", inverted" : "");
+    }
+
+    // Outputs follow the new table without waiting for an input change
+    scan_cycle_notify(SCAN_EVENT_COMMAND);
+    return err;
+}
+
+int io_map_get_links(io_map_link_t *out, int max_links)
+{
+    xSemaphoreTake(writer_mutex, portMAX_DELAY);
+    int count = link_count < max_links ? link_count : max_links;
+    memcpy(out, links, count * sizeof(io_map_link_t));
+    xSemaphoreGive(writer_mutex);
+    return count;
+}
+
+uint32_t io_map_step(uint32_t inputs)
+{
+    // Inverted links read the inactive half of the widened word, so they
+    // cost the same as plain ones and their edges are releases
+    uint32_t widened = (inputs & INPUTS_MASK) | ((~inputs & INPUTS_MASK) << NUM_INPUTS);
+
+    atomic_fetch_add(&reader_seq, 1);
+    const io_map_table_t *table = atomic_load(&active_table);
+
+    if (!primed) {
+        // Inputs already active at boot are not presses, and latched
+        // outputs keep the state retain_init() restored
+        last_widened = widened;
+        atomic_store(&latched, output_image_get() & table->latch_mask);
+        primed = true;
+    }
+    uint32_t pressed = widened & ~last_widened;
+    last_widened = widened;
+
+    uint32_t latch = atomic_load(&latched);
+    uint32_t bits = 0;
+    for (int o = 0; o < NUM_OUTPUTS; o++) {
+        uint32_t bit = 1UL << o;
+        // Two toggle presses in one scan cancel out
+        if (__builtin_parity(pressed & table->toggle[o])) {
+            latch ^= bit;
+        }
+        if (pressed & table->set[o]) {
+            latch |= bit;
+        }
+        if (pressed & table->reset[o]) {
+            latch &= ~bit;
+        }
+        if (widened & table->level[o]) {
+            bits |= bit;
+        }
+    }
+    // Outputs that lost their edge links drop the latch
+    latch &= table->latch_mask;
+
+    atomic_fetch_add(&reader_seq, 1);
+
+    atomic_store(&latched, latch);
+    return bits | latch;
+}
+
+uint32_t io_map_get_latched(void)
+{
+    return atomic_load(&latched);
+}
+
+const char *io_map_mode_name(uint8_t mode)
+{
+    return mode < IO_MAP_MODE_COUNT ? mode_names[mode] : "unknown";
+}
+
+int io_map_mode_from_name(const char *name)
+{
+    for (int i = 0; i < IO_MAP_MODE_COUNT; i++) {
+        if (strcmp(name, mode_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
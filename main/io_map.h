@@ -0,0 +1,56 @@
+#ifndef IO_MAP_H
+#define IO_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "auto_board.h"
+
+#define IO_MAP_NAMESPACE        "io_map"
+#define IO_MAP_MAX_LINKS        32
+
+// What a link does to its output
+typedef enum {
+    IO_MAP_LEVEL = 0,       // ON while the input is active; level links to one output are ORed
+    IO_MAP_TOGGLE,          // Flip on each press (impulse relay)
+    IO_MAP_SET,             // Latch ON on a press
+    IO_MAP_RESET,           // Latch OFF on a press; wins over SET in the same scan
+    IO_MAP_MODE_COUNT
+} io_map_mode_t;
+
+// One input-to-output link as stored in NVS. An input may drive several
+// outputs and an output may have several inputs. 'invert' uses the
+// inactive state: a level link is ON while the input is off, and the
+// edge modes act on release instead of press.
+typedef struct {
+    uint8_t input;          // 0-based
+    uint8_t output;         // 0-based
+    uint8_t mode;           // io_map_mode_t
+    uint8_t invert;
+} io_map_link_t;
+
+// Compiled table, one mask per output and mode over the widened input
+// word: bit n = input n active, bit NUM_INPUTS + n = input n inactive
+typedef struct {
+    uint32_t level[NUM_OUTPUTS];
+    uint32_t toggle[NUM_OUTPUTS];
+    uint32_t set[NUM_OUTPUTS];
+    uint32_t reset[NUM_OUTPUTS];
+    uint32_t latch_mask;        // Outputs with an edge-triggered link
+} io_map_table_t;
+
+_Static_assert(2 * NUM_INPUTS <= 32, "widened inputs overflow a mask");
+
+// Function prototypes
+esp_err_t io_map_init(void);
+// Replace the whole link table and save it to NVS
+esp_err_t io_map_set_links(const io_map_link_t *links, int count);
+int io_map_get_links(io_map_link_t *links, int max_links);
+// Scan only: outputs the mapping drives for this input image, bit n = output n
+uint32_t io_map_step(uint32_t inputs);
+// Current state of the toggle/set/reset latches
+uint32_t io_map_get_latched(void);
+const char *io_map_mode_name(uint8_t mode);
+int io_map_mode_from_name(const char *name);
+
+#endif // IO_MAP_H
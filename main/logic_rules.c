@@ -0,0 +1,364 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "logic_rules.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "LOGIC_RULES";
+
+// Scratch registers: an accumulator and one per negated block input
+#define REG_ACC         LOGIC_REG_TEMP
+#define REG_NEG_A       (LOGIC_REG_TEMP + 1)
+#define REG_NEG_B       (LOGIC_REG_TEMP + 2)
+
+typedef struct {
+    logic_program_t *program;
+    char *err;
+    size_t err_len;
+    int rung;
+    uint32_t timers_used;
+    uint32_t counters_used;
+    int const_count;
+} compile_ctx_t;
+
+static bool fail(compile_ctx_t *ctx, const char *fmt, ...)
+{
+    int len = snprintf(ctx->err, ctx->err_len, "rung %d: ", ctx->rung + 1);
+    if (len >= 0 && (size_t)len < ctx->err_len) {
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(ctx->err + len, ctx->err_len - len, fmt, args);
+        va_end(args);
+    }
+    return false;
+}
+
+static bool emit(compile_ctx_t *ctx, logic_op_t op, uint8_t d, uint8_t a, uint8_t b)
+{
+    logic_program_t *program = ctx->program;
+    if (program->count >= LOGIC_MAX_INSNS) {
+        return fail(ctx, "program longer than %d instructions", LOGIC_MAX_INSNS);
+    }
+    program->code[program->count++] = (logic_insn_t) { .op = op, .d = d, .a = a, .b = b };
+    return true;
+}
+
+// Bit operand with an optional leading '!'
+static bool parse_operand(compile_ctx_t *ctx, const cJSON *item, int *reg, bool *negated)
+{
+    const char *name = cJSON_GetStringValue(item);
+    if (name == NULL) {
+        return fail(ctx, "operand must be a string");
+    }
+
+    *negated = name[0] == '!';
+    if (*negated) {
+        name++;
+    }
+    *reg = logic_vm_reg_from_name(name, strlen(name));
+    if (*reg < 0) {
+        return fail(ctx, "unknown operand '%s'", name);
+    }
+    return true;
+}
+
+// Block inputs have no negated form, so a negated one goes through 'temp'
+static bool load_operand(compile_ctx_t *ctx, const cJSON *item, uint8_t temp, uint8_t *reg)
+{
+    int r;
+    bool negated;
+    if (!parse_operand(ctx, item, &r, &negated)) {
+        return false;
+    }
+    if (negated) {
+        if (!emit(ctx, LOGIC_OP_NOT, temp, r, 0)) {
+            return false;
+        }
+        r = temp;
+    }
+    *reg = (uint8_t)r;
+    return true;
+}
+
+static bool parse_target(compile_ctx_t *ctx, const cJSON *item, int *reg)
+{
+    const char *name = cJSON_GetStringValue(item);
+    *reg = name != NULL ? logic_vm_reg_from_name(name, strlen(name)) : -1;
+    if (*reg < 0) {
+        return fail(ctx, "missing or unknown \"out\"");
+    }
+    return true;
+}
+
+static bool writable_target(int reg)
+{
+    return (reg >= LOGIC_REG_OUT && reg < LOGIC_REG_TIMER) ||
+           (reg >= LOGIC_REG_MARKER && reg < LOGIC_REG_TEMP);
+}
+
+static int add_const(compile_ctx_t *ctx, int32_t value)
+{
+    for (int i = 0; i < ctx->const_count; i++) {
+        if (ctx->program->consts[i] == value) {
+            return i;
+        }
+    }
+    if (ctx->const_count >= LOGIC_MAX_CONSTS) {
+        return -1;
+    }
+    ctx->program->consts[ctx->const_count] = value;
+    return ctx->const_count++;
+}
+
+static bool get_number(compile_ctx_t *ctx, const cJSON *rung, const char *key, double min, double max, double *value)
+{
+    const cJSON *item = cJSON_GetObjectItem(rung, key);
+    if (!cJSON_IsNumber(item) || cJSON_GetNumberValue(item) < min || cJSON_GetNumberValue(item) > max) {
+        return fail(ctx, "\"%s\" missing or out of range", key);
+    }
+    *value = cJSON_GetNumberValue(item);
+    return true;
+}
+
+// AND / OR / XOR / NOT over up to LOGIC_RULES_MAX_TERMS operands
+static bool compile_gate(compile_ctx_t *ctx, logic_op_t op, int dst, const cJSON *in)
+{
+    int regs[LOGIC_RULES_MAX_TERMS];
+    bool neg[LOGIC_RULES_MAX_TERMS];
+    int n = 0;
+
+    if (cJSON_IsArray(in)) {
+        const cJSON *item;
+        cJSON_ArrayForEach(item, in) {
+            if (n >= LOGIC_RULES_MAX_TERMS) {
+                return fail(ctx, "more than %d operands", LOGIC_RULES_MAX_TERMS);
+            }
+            if (!parse_operand(ctx, item, &regs[n], &neg[n])) {
+                return false;
+            }
+            n++;
+        }
+    } else if (in != NULL) {
+        if (!parse_operand(ctx, in, &regs[0], &neg[0])) {
+            return false;
+        }
+        n = 1;
+    }
+    if (n == 0) {
+        return fail(ctx, "no operands");
+    }
+
+    if (op == LOGIC_OP_NOT) {
+        if (n != 1) {
+            return fail(ctx, "\"not\" takes one operand");
+        }
+        return emit(ctx, neg[0] ? LOGIC_OP_MOV : LOGIC_OP_NOT, dst, regs[0], 0);
+    }
+
+    // Build in the accumulator when the target is also read after the
+    // first write, e.g. a seal-in OUT1 = IN1 | OUT1
+    uint8_t acc = dst;
+    for (int i = 1; i < n; i++) {
+        if (regs[i] == dst) {
+            acc = REG_ACC;
+        }
+    }
+
+    if (op == LOGIC_OP_XOR) {
+        bool invert = false;
+        for (int i = 0; i < n; i++) {
+            invert ^= neg[i];
+        }
+        bool ok = n == 1 ? emit(ctx, LOGIC_OP_MOV, acc, regs[0], 0)
+                         : emit(ctx, LOGIC_OP_XOR, acc, regs[0], regs[1]);
+        for (int i = 2; ok && i < n; i++) {
+            ok = emit(ctx, LOGIC_OP_XOR, acc, acc, regs[i]);
+        }
+        if (ok && (acc != dst || invert)) {
+            ok = emit(ctx, invert ? LOGIC_OP_NOT : LOGIC_OP_MOV, dst, acc, 0);
+        }
+        return ok;
+    }
+
+    logic_op_t pos_op = op;
+    logic_op_t neg_op = op == LOGIC_OP_AND ? LOGIC_OP_ANDN : LOGIC_OP_ORN;
+
+    bool ok;
+    if (n == 1) {
+        ok = emit(ctx, neg[0] ? LOGIC_OP_NOT : LOGIC_OP_MOV, acc, regs[0], 0);
+    } else if (!neg[0]) {
+        ok = emit(ctx, neg[1] ? neg_op : pos_op, acc, regs[0], regs[1]);
+    } else if (!neg[1]) {
+        ok = emit(ctx, neg_op, acc, regs[1], regs[0]);
+    } else {
+        ok = emit(ctx, LOGIC_OP_NOT, acc, regs[0], 0) && emit(ctx, neg_op, acc, acc, regs[1]);
+    }
+    for (int i = 2; ok && i < n; i++) {
+        ok = emit(ctx, neg[i] ? neg_op : pos_op, acc, acc, regs[i]);
+    }
+    if (ok && acc != dst) {
+        ok = emit(ctx, LOGIC_OP_MOV, dst, acc, 0);
+    }
+    return ok;
+}
+
+static bool compile_latch(compile_ctx_t *ctx, logic_op_t op, int dst, const cJSON *in)
+{
+    uint8_t set, reset;
+    if (!cJSON_IsArray(in) || cJSON_GetArraySize(in) != 2) {
+        return fail(ctx, "a latch takes [set, reset]");
+    }
+    return load_operand(ctx, cJSON_GetArrayItem(in, 0), REG_NEG_A, &set) &&
+           load_operand(ctx, cJSON_GetArrayItem(in, 1), REG_NEG_B, &reset) &&
+           emit(ctx, op, dst, set, reset);
+}
+
+static bool compile_timer(compile_ctx_t *ctx, logic_op_t op, int dst, const cJSON *rung)
+{
+    if (dst < LOGIC_REG_TIMER || dst >= LOGIC_REG_TIMER + LOGIC_MAX_TIMERS) {
+        return fail(ctx, "timer \"out\" must be T1..T%d", LOGIC_MAX_TIMERS);
+    }
+    int t = dst - LOGIC_REG_TIMER;
+    if (ctx->timers_used & (1UL << t)) {
+        return fail(ctx, "T%d is already used", t + 1);
+    }
+
+    double ms;
+    uint8_t in;
+    if (!get_number(ctx, rung, "ms", 0, LOGIC_TIMER_MAX_MS, &ms) ||
+        !load_operand(ctx, cJSON_GetObjectItem(rung, "in"), REG_NEG_A, &in)) {
+        return false;
+    }
+    ctx->timers_used |= 1UL << t;
+    ctx->program->timer_ms[t] = (uint32_t)ms;
+    return emit(ctx, op, 0, in, t);
+}
+
+static bool compile_counter(compile_ctx_t *ctx, logic_op_t op, int dst, const cJSON *rung)
+{
+    if (dst < LOGIC_REG_COUNTER || dst >= LOGIC_REG_COUNTER + LOGIC_MAX_COUNTERS) {
+        return fail(ctx, "counter \"out\" must be C1..C%d", LOGIC_MAX_COUNTERS);
+    }
+    int c = dst - LOGIC_REG_COUNTER;
+    if (ctx->counters_used & (1UL << c)) {
+        return fail(ctx, "C%d is already used", c + 1);
+    }
+
+    double pv;
+    uint8_t in;
+    uint8_t reset = LOGIC_REG_FALSE;
+    const cJSON *reset_json = cJSON_GetObjectItem(rung, op == LOGIC_OP_CTU ? "reset" : "load");
+    if (!get_number(ctx, rung, "pv", INT32_MIN, INT32_MAX, &pv) ||
+        !load_operand(ctx, cJSON_GetObjectItem(rung, "in"), REG_NEG_A, &in) ||
+        (reset_json != NULL && !load_operand(ctx, reset_json, REG_NEG_B, &reset))) {
+        return false;
+    }
+    ctx->counters_used |= 1UL << c;
+    ctx->program->counter_pv[c] = (int32_t)pv;
+    return emit(ctx, op, reset, in, c);
+}
+
+static bool compile_compare(compile_ctx_t *ctx, logic_op_t op, int dst, const cJSON *rung)
+{
+    const char *name = cJSON_GetStringValue(cJSON_GetObjectItem(rung, "in"));
+    int word = name != NULL ? logic_vm_word_from_name(name, strlen(name)) : -1;
+    if (word < 0) {
+        return fail(ctx, "compare \"in\" must be Tn.ET or Cn.CV");
+    }
+
+    double value;
+    if (!get_number(ctx, rung, "value", INT32_MIN, INT32_MAX, &value)) {
+        return false;
+    }
+    int index = add_const(ctx, (int32_t)value);
+    if (index < 0) {
+        return fail(ctx, "more than %d distinct constants", LOGIC_MAX_CONSTS);
+    }
+    return emit(ctx, op, dst, word, index);
+}
+
+static bool compile_rung(compile_ctx_t *ctx, const cJSON *rung)
+{
+    const char *op_name = cJSON_GetStringValue(cJSON_GetObjectItem(rung, "op"));
+    int op = op_name != NULL ? logic_vm_op_from_name(op_name) : -1;
+
+    // mov, andn and orn are compiler output, not rung types
+    if (op < 0 || op == LOGIC_OP_MOV || op == LOGIC_OP_ANDN || op == LOGIC_OP_ORN) {
+        return fail(ctx, "unknown \"op\"");
+    }
+
+    int dst;
+    if (!parse_target(ctx, cJSON_GetObjectItem(rung, "out"), &dst)) {
+        return false;
+    }
+    const cJSON *in = cJSON_GetObjectItem(rung, "in");
+
+    switch (op) {
+        case LOGIC_OP_TON:
+        case LOGIC_OP_TOF:
+        case LOGIC_OP_TP:
+            return compile_timer(ctx, op, dst, rung);
+        case LOGIC_OP_CTU:
+        case LOGIC_OP_CTD:
+            return compile_counter(ctx, op, dst, rung);
+        default:
+            break;
+    }
+
+    if (!writable_target(dst)) {
+        return fail(ctx, "\"out\" must be an output or marker");
+    }
+    switch (op) {
+        case LOGIC_OP_SR:
+        case LOGIC_OP_RS:
+            return compile_latch(ctx, op, dst, in);
+        case LOGIC_OP_GT:
+        case LOGIC_OP_GE:
+        case LOGIC_OP_LT:
+        case LOGIC_OP_LE:
+        case LOGIC_OP_EQ:
+        case LOGIC_OP_NE:
+            return compile_compare(ctx, op, dst, rung);
+        default:
+            return compile_gate(ctx, op, dst, in);
+    }
+}
+
+esp_err_t logic_rules_compile(const cJSON *rungs, logic_program_t *program, char *err, size_t err_len)
+{
+    memset(program, 0, sizeof(*program));
+    program->version = LOGIC_PROGRAM_VERSION;
+    err[0] = '\0';
+
+    if (!cJSON_IsArray(rungs)) {
+        snprintf(err, err_len, "\"rungs\" must be an array");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    compile_ctx_t ctx = {
+        .program = program,
+        .err = err,
+        .err_len = err_len
+    };
+
+    const cJSON *rung;
+    cJSON_ArrayForEach(rung, rungs) {
+        if (!compile_rung(&ctx, rung)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        ctx.rung++;
+    }
+
+    if (logic_program_verify(program) != ESP_OK) {
+        snprintf(err, err_len, "program failed verification");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ESP_LOGI(TAG, "Compiled %d rungs into %u instructions", ctx.rung, program->count);
+    return ESP_OK;
+}
@@ -0,0 +1,24 @@
+#ifndef LOGIC_RULES_H
+#define LOGIC_RULES_H
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "cJSON.h"
+#include "logic_vm.h"
+
+// Rung list as uploaded to /api/logic, one object per rung:
+//   {"op": "and|or|xor|not", "out": "OUT1", "in": ["IN1", "!IN2", ...]}
+//   {"op": "sr|rs", "out": "M1", "in": ["IN3", "IN4"]}          set, reset
+//   {"op": "ton|tof|tp", "out": "T1", "in": "IN1", "ms": 5000}
+//   {"op": "ctu", "out": "C1", "in": "IN2", "reset": "IN3", "pv": 10}
+//   {"op": "ctd", "out": "C2", "in": "IN2", "load": "IN3", "pv": 10}
+//   {"op": "gt|ge|lt|le|eq|ne", "out": "M2", "in": "C1.CV", "value": 5}
+// A leading '!' negates a bit operand.
+
+#define LOGIC_RULES_MAX_TERMS   16
+
+// Function prototypes
+// Compile the rungs into 'program'; on error 'err' names the rung and cause
+esp_err_t logic_rules_compile(const cJSON *rungs, logic_program_t *program, char *err, size_t err_len);
+
+#endif // LOGIC_RULES_H
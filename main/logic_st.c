@@ -0,0 +1,704 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "esp_log.h"
+#include "logic_st.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "LOGIC_ST";
+
+#define MAX_NUMBER      1000000000000000LL  // Literals saturate here; range checks reject them
+
+typedef enum {
+    TOK_END = 0,
+    TOK_NEWLINE,
+    TOK_SEMI,
+    TOK_IDENT,
+    TOK_NUMBER,             // value in 'number', time literals in ms
+    TOK_LPAREN,
+    TOK_RPAREN,
+    TOK_COMMA,
+    TOK_MINUS,
+    TOK_ASSIGN,             // '=' or ':='; 'number' is 1 for ':='
+    TOK_COMPARE,            // opcode in 'number'
+    TOK_NOT,
+    TOK_AND,
+    TOK_XOR,
+    TOK_OR,
+    TOK_BAD
+} token_t;
+
+// A value on the operand stack: a register, read inverted when 'negated'.
+// Temporaries are allocated and freed in stack order.
+typedef struct {
+    uint8_t reg;
+    bool negated;
+    bool temp;
+} operand_t;
+
+// An operator waiting for its right operand, or an open parenthesis
+typedef struct {
+    uint8_t tok;
+    uint32_t pos;
+} pending_t;
+
+typedef struct {
+    const char *src;
+    size_t len;
+    size_t pos;
+    token_t tok;
+    size_t tok_pos;
+    size_t tok_len;
+    int64_t number;
+    logic_program_t *program;
+    uint32_t timers_used;
+    uint32_t counters_used;
+    int const_count;
+    int temp_count;
+    int op_count;
+    int val_count;
+    pending_t ops[LOGIC_ST_MAX_DEPTH];
+    operand_t vals[LOGIC_ST_MAX_DEPTH];
+    char *err;
+    size_t err_len;
+} parser_t;
+
+static const struct {
+    const char *name;
+    logic_op_t op;
+} blocks[] = {
+    { "TON", LOGIC_OP_TON }, { "TOF", LOGIC_OP_TOF }, { "TP", LOGIC_OP_TP },
+    { "CTU", LOGIC_OP_CTU }, { "CTD", LOGIC_OP_CTD },
+    { "SR", LOGIC_OP_SR }, { "RS", LOGIC_OP_RS }
+};
+
+static bool fail(parser_t *p, size_t pos, const char *fmt, ...)
+{
+    int line = 1, col = 1;
+    for (size_t i = 0; i < pos && i < p->len; i++) {
+        if (p->src[i] == '\n') {
+            line++;
+            col = 1;
+        } else {
+            col++;
+        }
+    }
+
+    int len = snprintf(p->err, p->err_len, "line %d, col %d: ", line, col);
+    if (len >= 0 && (size_t)len < p->err_len) {
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(p->err + len, p->err_len - len, fmt, args);
+        va_end(args);
+    }
+    return false;
+}
+
+// "expected X, found Y" at the current token
+static bool unexpected(parser_t *p, const char *expected)
+{
+    if (p->tok == TOK_END) {
+        return fail(p, p->tok_pos, "expected %s, found end of input", expected);
+    }
+    if (p->tok == TOK_NEWLINE) {
+        return fail(p, p->tok_pos, "expected %s, found end of line", expected);
+    }
+    int shown = p->tok_len > 16 ? 16 : (int)p->tok_len;
+    return fail(p, p->tok_pos, "expected %s, found '%.*s'", expected, shown, p->src + p->tok_pos);
+}
+
+// Lexer
+
+static bool is_name_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '_' || c == '.';
+}
+
+// Digits with optional unit suffixes: 500, 500ms, 5s, 1m30s, 2h
+static bool lex_number(parser_t *p, size_t *i)
+{
+    const char *s = p->src;
+    int64_t total = 0;
+    bool last_part = false;
+    int parts = 0;
+
+    while (*i < p->len && isdigit((unsigned char)s[*i]) && !last_part) {
+        int64_t value = 0;
+        while (*i < p->len && isdigit((unsigned char)s[*i])) {
+            value = value * 10 + (s[(*i)++] - '0');
+            if (value > MAX_NUMBER) {
+                value = MAX_NUMBER;
+            }
+        }
+
+        size_t rest = p->len - *i;
+        int64_t unit = 1;
+        if (rest >= 2 && strncasecmp(&s[*i], "ms", 2) == 0) {
+            *i += 2;
+        } else if (rest >= 1 && (s[*i] == 's' || s[*i] == 'S')) {
+            unit = 1000;
+            (*i)++;
+        } else if (rest >= 1 && (s[*i] == 'm' || s[*i] == 'M')) {
+            unit = 60000;
+            (*i)++;
+        } else if (rest >= 1 && (s[*i] == 'h' || s[*i] == 'H')) {
+            unit = 3600000;
+            (*i)++;
+        } else if (parts > 0) {
+            return false;           // 1m30 is ambiguous
+        } else {
+            last_part = true;
+        }
+
+        // Saturate before multiplying: 10^15 hours does not fit in 64 bits
+        if (value > (MAX_NUMBER - total) / unit) {
+            total = MAX_NUMBER;
+        } else {
+            total += value * unit;
+        }
+        parts++;
+    }
+
+    p->number = total;
+    return *i >= p->len || !is_name_char(s[*i]);
+}
+
+static void next(parser_t *p)
+{
+    const char *s = p->src;
+    size_t n = p->len;
+    size_t i = p->pos;
+
+    // Blanks and comments; a newline is a token
+    for (;;) {
+        while (i < n && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r')) {
+            i++;
+        }
+        if (i + 1 < n && s[i] == '/' && s[i + 1] == '/') {
+            while (i < n && s[i] != '\n') {
+                i++;
+            }
+            continue;
+        }
+        break;
+    }
+
+    p->tok_pos = i;
+    if (i >= n) {
+        p->tok = TOK_END;
+        p->tok_len = 0;
+        p->pos = i;
+        return;
+    }
+
+    char c = s[i];
+    char c1 = i + 1 < n ? s[i + 1] : '\0';
+    token_t tok = TOK_BAD;
+    size_t len = 1;
+
+    switch (c) {
+        case '\n': tok = TOK_NEWLINE; break;
+        case ';': tok = TOK_SEMI; break;
+        case '(': tok = TOK_LPAREN; break;
+        case ')': tok = TOK_RPAREN; break;
+        case ',': tok = TOK_COMMA; break;
+        case '-': tok = TOK_MINUS; break;
+        case '&': tok = TOK_AND; break;
+        case '^': tok = TOK_XOR; break;
+        case '|': tok = TOK_OR; break;
+        case '!':
+            if (c1 == '=') {
+                tok = TOK_COMPARE;
+                p->number = LOGIC_OP_NE;
+                len = 2;
+            } else {
+                tok = TOK_NOT;
+            }
+            break;
+        case '=':
+            tok = c1 == '=' ? TOK_COMPARE : TOK_ASSIGN;
+            p->number = c1 == '=' ? LOGIC_OP_EQ : 0;
+            len = c1 == '=' ? 2 : 1;
+            break;
+        case ':':
+            if (c1 == '=') {
+                tok = TOK_ASSIGN;
+                p->number = 1;
+                len = 2;
+            }
+            break;
+        case '<':
+            tok = TOK_COMPARE;
+            p->number = c1 == '=' ? LOGIC_OP_LE : c1 == '>' ? LOGIC_OP_NE : LOGIC_OP_LT;
+            len = c1 == '=' || c1 == '>' ? 2 : 1;
+            break;
+        case '>':
+            tok = TOK_COMPARE;
+            p->number = c1 == '=' ? LOGIC_OP_GE : LOGIC_OP_GT;
+            len = c1 == '=' ? 2 : 1;
+            break;
+        default:
+            if (isdigit((unsigned char)c) || ((c == 'T' || c == 't') && c1 == '#')) {
+                // IEC time literal T#5s or a plain number
+                size_t end = i + (isdigit((unsigned char)c) ? 0 : 2);
+                bool ok = end < n && isdigit((unsigned char)s[end]) && lex_number(p, &end);
+                while (end < n && is_name_char(s[end])) {
+                    end++;
+                }
+                tok = ok ? TOK_NUMBER : TOK_BAD;
+                len = end - i;
+            } else if (isalpha((unsigned char)c) || c == '_') {
+                size_t end = i;
+                while (end < n && is_name_char(s[end])) {
+                    end++;
+                }
+                len = end - i;
+                tok = TOK_IDENT;
+                if (len == 3 && strncasecmp(&s[i], "AND", 3) == 0) {
+                    tok = TOK_AND;
+                } else if (len == 3 && strncasecmp(&s[i], "XOR", 3) == 0) {
+                    tok = TOK_XOR;
+                } else if (len == 2 && strncasecmp(&s[i], "OR", 2) == 0) {
+                    tok = TOK_OR;
+                } else if (len == 3 && strncasecmp(&s[i], "NOT", 3) == 0) {
+                    tok = TOK_NOT;
+                }
+            }
+            break;
+    }
+
+    p->tok = tok;
+    p->tok_len = len;
+    p->pos = i + len;
+}
+
+// Code generation
+
+static bool emit(parser_t *p, size_t pos, logic_op_t op, uint8_t d, uint8_t a, uint8_t b)
+{
+    logic_program_t *program = p->program;
+    if (program->count >= LOGIC_MAX_INSNS) {
+        return fail(p, pos, "program longer than %d instructions", LOGIC_MAX_INSNS);
+    }
+    program->code[program->count++] = (logic_insn_t) { .op = op, .d = d, .a = a, .b = b };
+    return true;
+}
+
+static bool alloc_temp(parser_t *p, size_t pos, uint8_t *reg)
+{
+    if (LOGIC_REG_TEMP + p->temp_count >= LOGIC_REG_COUNT) {
+        return fail(p, pos, "expression too complex");
+    }
+    *reg = LOGIC_REG_TEMP + p->temp_count++;
+    return true;
+}
+
+static bool push_value(parser_t *p, size_t pos, operand_t value)
+{
+    if (p->val_count >= LOGIC_ST_MAX_DEPTH) {
+        return fail(p, pos, "expression too complex");
+    }
+    p->vals[p->val_count++] = value;
+    return true;
+}
+
+static bool push_op(parser_t *p, token_t tok)
+{
+    if (p->op_count >= LOGIC_ST_MAX_DEPTH) {
+        return fail(p, p->tok_pos, "expression nested too deeply");
+    }
+    p->ops[p->op_count++] = (pending_t) { .tok = tok, .pos = p->tok_pos };
+    return true;
+}
+
+static int precedence(uint8_t tok)
+{
+    switch (tok) {
+        case TOK_NOT: return 4;
+        case TOK_AND: return 3;
+        case TOK_XOR: return 2;
+        case TOK_OR: return 1;
+        default: return 0;
+    }
+}
+
+static int add_const(parser_t *p, int32_t value)
+{
+    for (int i = 0; i < p->const_count; i++) {
+        if (p->program->consts[i] == value) {
+            return i;
+        }
+    }
+    if (p->const_count >= LOGIC_MAX_CONSTS) {
+        return -1;
+    }
+    p->program->consts[p->const_count] = value;
+    return p->const_count++;
+}
+
+// Apply the operator on top of the stack. Negations are free: they flip
+// the operand, and the binary operators absorb them as ANDN/ORN or, with
+// both inputs negated, De Morgan (!a & !b = !(a | b)).
+static bool reduce(parser_t *p)
+{
+    pending_t op = p->ops[--p->op_count];
+    if (op.tok == TOK_NOT) {
+        p->vals[p->val_count - 1].negated = !p->vals[p->val_count - 1].negated;
+        return true;
+    }
+
+    operand_t y = p->vals[--p->val_count];
+    operand_t x = p->vals[--p->val_count];
+    p->temp_count -= x.temp + y.temp;
+
+    uint8_t d = 0;
+    if (!alloc_temp(p, op.pos, &d)) {
+        return false;
+    }
+
+    logic_op_t code;
+    uint8_t a = x.reg, b = y.reg;
+    bool negated = false;
+    if (op.tok == TOK_XOR) {
+        code = LOGIC_OP_XOR;
+        negated = x.negated != y.negated;
+    } else {
+        bool is_and = op.tok == TOK_AND;
+        if (!x.negated && !y.negated) {
+            code = is_and ? LOGIC_OP_AND : LOGIC_OP_OR;
+        } else if (!x.negated || !y.negated) {
+            code = is_and ? LOGIC_OP_ANDN : LOGIC_OP_ORN;
+            if (x.negated) {
+                a = y.reg;
+                b = x.reg;
+            }
+        } else {
+            code = is_and ? LOGIC_OP_OR : LOGIC_OP_AND;
+            negated = true;
+        }
+    }
+
+    return emit(p, op.pos, code, d, a, b) &&
+           push_value(p, op.pos, (operand_t) { .reg = d, .negated = negated, .temp = true });
+}
+
+// Optional '-' and a number within [min, max]
+static bool parse_number(parser_t *p, int64_t min, int64_t max, int64_t *value)
+{
+    size_t pos = p->tok_pos;
+    bool minus = p->tok == TOK_MINUS;
+    if (minus) {
+        next(p);
+    }
+    if (p->tok != TOK_NUMBER) {
+        return unexpected(p, "a number");
+    }
+    *value = minus ? -p->number : p->number;
+    if (*value < min || *value > max) {
+        return fail(p, pos, "value out of range %lld..%lld", (long long)min, (long long)max);
+    }
+    next(p);
+    return true;
+}
+
+// A bit operand, or a word compared with a constant
+static bool parse_operand(parser_t *p)
+{
+    size_t pos = p->tok_pos;
+    const char *name = p->src + pos;
+    int len = (int)p->tok_len;
+
+    int reg = logic_vm_reg_from_name(name, len);
+    if (reg >= 0) {
+        next(p);
+        return push_value(p, pos, (operand_t) { .reg = reg });
+    }
+
+    int word = logic_vm_word_from_name(name, len);
+    if (word < 0) {
+        return fail(p, pos, "unknown operand '%.*s'", len > 16 ? 16 : len, name);
+    }
+    next(p);
+    if (p->tok != TOK_COMPARE && !(p->tok == TOK_ASSIGN && p->number == 0)) {
+        return unexpected(p, "a comparison");
+    }
+    logic_op_t op = p->tok == TOK_ASSIGN ? LOGIC_OP_EQ : (logic_op_t)p->number;
+    next(p);
+
+    int64_t value;
+    if (!parse_number(p, INT32_MIN, INT32_MAX, &value)) {
+        return false;
+    }
+    int index = add_const(p, (int32_t)value);
+    if (index < 0) {
+        return fail(p, pos, "more than %d distinct constants", LOGIC_MAX_CONSTS);
+    }
+
+    uint8_t d = 0;
+    return alloc_temp(p, pos, &d) && emit(p, pos, op, d, word, index) &&
+           push_value(p, pos, (operand_t) { .reg = d, .temp = true });
+}
+
+// Shunting-yard over the operator and operand stacks. Stops at the first
+// token that cannot continue the expression, leaving it current.
+static bool parse_expr(parser_t *p, operand_t *result)
+{
+    p->op_count = 0;
+    p->val_count = 0;
+    bool want_operand = true;
+    int depth = 0;
+
+    for (;;) {
+        if (want_operand) {
+            while (p->tok == TOK_NEWLINE) {
+                next(p);
+            }
+            if (p->tok == TOK_NOT || p->tok == TOK_LPAREN) {
+                depth += p->tok == TOK_LPAREN;
+                if (!push_op(p, p->tok)) {
+                    return false;
+                }
+                next(p);
+            } else if (p->tok == TOK_IDENT) {
+                if (!parse_operand(p)) {
+                    return false;
+                }
+                want_operand = false;
+            } else {
+                return unexpected(p, "an operand");
+            }
+            continue;
+        }
+
+        while (depth > 0 && p->tok == TOK_NEWLINE) {
+            next(p);
+        }
+        if (p->tok == TOK_AND || p->tok == TOK_XOR || p->tok == TOK_OR) {
+            while (p->op_count > 0 && precedence(p->ops[p->op_count - 1].tok) >= precedence(p->tok)) {
+                if (!reduce(p)) {
+                    return false;
+                }
+            }
+            if (!push_op(p, p->tok)) {
+                return false;
+            }
+            next(p);
+            want_operand = true;
+        } else if (p->tok == TOK_RPAREN && depth > 0) {
+            while (p->ops[p->op_count - 1].tok != TOK_LPAREN) {
+                if (!reduce(p)) {
+                    return false;
+                }
+            }
+            p->op_count--;
+            depth--;
+            next(p);
+        } else {
+            break;
+        }
+    }
+
+    while (p->op_count > 0) {
+        if (p->ops[p->op_count - 1].tok == TOK_LPAREN) {
+            return fail(p, p->ops[p->op_count - 1].pos, "'(' is never closed");
+        }
+        if (!reduce(p)) {
+            return false;
+        }
+    }
+    *result = p->vals[0];
+    p->val_count = 0;
+    return true;
+}
+
+// Block inputs have no negated form
+static bool load_operand(parser_t *p, size_t pos, operand_t *value)
+{
+    if (!value->negated) {
+        return true;
+    }
+    uint8_t d = value->reg;
+    if (!value->temp && !alloc_temp(p, pos, &d)) {
+        return false;
+    }
+    if (!emit(p, pos, LOGIC_OP_NOT, d, value->reg, 0)) {
+        return false;
+    }
+    *value = (operand_t) { .reg = d, .temp = true };
+    return true;
+}
+
+static bool expect(parser_t *p, token_t tok, const char *what)
+{
+    if (p->tok != tok) {
+        return unexpected(p, what);
+    }
+    next(p);
+    return true;
+}
+
+static bool writable_target(int reg)
+{
+    return (reg >= LOGIC_REG_OUT && reg < LOGIC_REG_TIMER) ||
+           (reg >= LOGIC_REG_MARKER && reg < LOGIC_REG_TEMP);
+}
+
+// T1 = TON(in, time), C1 = CTU(in[, reset], pv), M1 = SR(set, reset)
+static bool parse_block(parser_t *p, int dst, size_t dst_pos, logic_op_t op)
+{
+    size_t block_pos = p->tok_pos;
+    bool is_timer = op == LOGIC_OP_TON || op == LOGIC_OP_TOF || op == LOGIC_OP_TP;
+    bool is_counter = op == LOGIC_OP_CTU || op == LOGIC_OP_CTD;
+    int t = dst - LOGIC_REG_TIMER;
+    int c = dst - LOGIC_REG_COUNTER;
+
+    if (is_timer && (t < 0 || t >= LOGIC_MAX_TIMERS)) {
+        return fail(p, dst_pos, "a timer block must be assigned to T1..T%d", LOGIC_MAX_TIMERS);
+    }
+    if (is_timer && (p->timers_used & (1UL << t))) {
+        return fail(p, dst_pos, "T%d is already used", t + 1);
+    }
+    if (is_counter && (c < 0 || c >= LOGIC_MAX_COUNTERS)) {
+        return fail(p, dst_pos, "a counter block must be assigned to C1..C%d", LOGIC_MAX_COUNTERS);
+    }
+    if (is_counter && (p->counters_used & (1UL << c))) {
+        return fail(p, dst_pos, "C%d is already used", c + 1);
+    }
+    if (!is_timer && !is_counter && !writable_target(dst)) {
+        return fail(p, dst_pos, "a latch must be assigned to an output or marker");
+    }
+
+    next(p);
+    operand_t in;
+    size_t in_pos;
+    if (!expect(p, TOK_LPAREN, "'('")) {
+        return false;
+    }
+    in_pos = p->tok_pos;
+    if (!parse_expr(p, &in) || !load_operand(p, in_pos, &in) || !expect(p, TOK_COMMA, "','")) {
+        return false;
+    }
+
+    int64_t value;
+    if (is_timer) {
+        if (!parse_number(p, 0, LOGIC_TIMER_MAX_MS, &value) || !emit(p, block_pos, op, 0, in.reg, t)) {
+            return false;
+        }
+        p->timers_used |= 1UL << t;
+        p->program->timer_ms[t] = (uint32_t)value;
+    } else if (is_counter) {
+        // The reset (CTU) or load (CTD) input is optional
+        operand_t reset = { .reg = LOGIC_REG_FALSE };
+        if (p->tok != TOK_NUMBER && p->tok != TOK_MINUS) {
+            size_t reset_pos = p->tok_pos;
+            if (!parse_expr(p, &reset) || !load_operand(p, reset_pos, &reset) || !expect(p, TOK_COMMA, "','")) {
+                return false;
+            }
+        }
+        if (!parse_number(p, INT32_MIN, INT32_MAX, &value) || !emit(p, block_pos, op, reset.reg, in.reg, c)) {
+            return false;
+        }
+        p->counters_used |= 1UL << c;
+        p->program->counter_pv[c] = (int32_t)value;
+    } else {
+        operand_t reset;
+        size_t reset_pos = p->tok_pos;
+        if (!parse_expr(p, &reset) || !load_operand(p, reset_pos, &reset) ||
+            !emit(p, block_pos, op, dst, in.reg, reset.reg)) {
+            return false;
+        }
+    }
+    return expect(p, TOK_RPAREN, "')'");
+}
+
+static bool parse_statement(parser_t *p)
+{
+    size_t dst_pos = p->tok_pos;
+    int len = (int)p->tok_len;
+    int dst = logic_vm_reg_from_name(p->src + dst_pos, len);
+    if (dst < 0) {
+        return fail(p, dst_pos, "unknown target '%.*s'", len > 16 ? 16 : len, p->src + dst_pos);
+    }
+    next(p);
+    if (!expect(p, TOK_ASSIGN, "'='")) {
+        return false;
+    }
+    p->temp_count = 0;
+
+    if (p->tok == TOK_IDENT) {
+        for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+            if (p->tok_len == strlen(blocks[i].name) &&
+                strncasecmp(p->src + p->tok_pos, blocks[i].name, p->tok_len) == 0) {
+                return parse_block(p, dst, dst_pos, blocks[i].op);
+            }
+        }
+    }
+
+    if (!writable_target(dst)) {
+        return fail(p, dst_pos, "'%.*s' cannot be assigned", len > 16 ? 16 : len, p->src + dst_pos);
+    }
+    size_t expr_pos = p->tok_pos;
+    operand_t value;
+    if (!parse_expr(p, &value)) {
+        return false;
+    }
+
+    // The result of the last instruction goes straight to the target
+    logic_program_t *program = p->program;
+    if (value.temp && !value.negated) {
+        program->code[program->count - 1].d = dst;
+        return true;
+    }
+    return emit(p, expr_pos, value.negated ? LOGIC_OP_NOT : LOGIC_OP_MOV, dst, value.reg, 0);
+}
+
+esp_err_t logic_st_compile(const char *src, size_t len, logic_program_t *program, char *err, size_t err_len)
+{
+    memset(program, 0, sizeof(*program));
+    program->version = LOGIC_PROGRAM_VERSION;
+    err[0] = '\0';
+
+    parser_t p = {
+        .src = src,
+        .len = len,
+        .program = program,
+        .err = err,
+        .err_len = err_len
+    };
+
+    int statements = 0;
+    next(&p);
+    while (p.tok != TOK_END) {
+        if (p.tok == TOK_NEWLINE || p.tok == TOK_SEMI) {
+            next(&p);
+            continue;
+        }
+        if (p.tok != TOK_IDENT) {
+            unexpected(&p, "a statement");
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (!parse_statement(&p)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (p.tok != TOK_NEWLINE && p.tok != TOK_SEMI && p.tok != TOK_END) {
+            unexpected(&p, p.tok == TOK_IDENT || p.tok == TOK_LPAREN || p.tok == TOK_NOT ?
+                       "an operator" : "end of statement");
+            return ESP_ERR_INVALID_ARG;
+        }
+        statements++;
+    }
+
+    if (logic_program_verify(program) != ESP_OK) {
+        snprintf(err, err_len, "program failed verification");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ESP_LOGI(TAG, "Compiled %d statements into %u instructions", statements, program->count);
+    return ESP_OK;
+}
@@ -0,0 +1,31 @@
+#ifndef LOGIC_ST_H
+#define LOGIC_ST_H
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "logic_vm.h"
+
+// Structured-text-lite source for /api/logic, one statement per line or
+// separated by ';':
+//   OUT2 = IN1 & !IN3 | (T1.Q & IN5)        & AND, | OR, ^ XOR, ! NOT
+//   M1 := IN2 AND NOT M2                    ST keywords work too
+//   M3 = C1.CV >= 10 | T2.ET > 1500         compare a word with a constant
+//   T1 = TON(IN1 & !IN2, 5s)                also TOF, TP; T#1m30s, 500ms
+//   C1 = CTU(IN2, IN3, 10)                  input, reset, preset; CTD loads
+//   M4 = SR(IN4, IN5)                       set, reset; RS is reset-dominant
+// Precedence from high to low: NOT, AND, XOR, OR. Comments run from // to
+// the end of the line. A line may continue after an operator or inside
+// parentheses.
+//
+// The parser never allocates: it reads the source in place and emits
+// bytecode with an explicit operator stack, so its state is a fixed
+// ~0.5 KB on the caller's stack whatever the input.
+
+#define LOGIC_ST_MAX_DEPTH      32          // Pending operators and operands per expression
+
+// Function prototypes
+// Compile 'len' bytes of source into 'program'; on error 'err' holds
+// "line L, col C: cause"
+esp_err_t logic_st_compile(const char *src, size_t len, logic_program_t *program, char *err, size_t err_len);
+
+#endif // LOGIC_ST_H
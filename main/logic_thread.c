@@ -0,0 +1,1018 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "logic_thread.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "LOGIC_THREAD";
+
+// Marks an instruction removed by the optimiser
+#define OP_NOP          0xFF
+
+#define REG_BIT(map, r)     (((map)[(r) >> 5] >> ((r) & 31)) & 1)
+#define REG_SET(map, r)     ((map)[(r) >> 5] |= 1UL << ((r) & 31))
+#define REG_CLEAR(map, r)   ((map)[(r) >> 5] &= ~(1UL << ((r) & 31)))
+
+// ---- Handlers: one per threaded entry ----
+
+// Everything a handler touches arrives in registers; the bit ops only
+// use 'r' and 'terms'
+#define HANDLER(name) \
+    static void name(const logic_thread_op_t *op, uint8_t *r, const logic_term_t *terms, \
+                     const logic_program_t *program, logic_vm_t *vm, int64_t now_ms)
+
+HANDLER(op_const0)
+{
+    r[op->d] = 0;
+}
+
+HANDLER(op_const1)
+{
+    r[op->d] = 1;
+}
+
+HANDLER(op_mov)
+{
+    r[op->d] = r[op->a];
+}
+
+HANDLER(op_not)
+{
+    r[op->d] = r[op->a] ^ 1;
+}
+
+HANDLER(op_and)
+{
+    r[op->d] = r[op->a] & r[op->b];
+}
+
+HANDLER(op_andn)
+{
+    r[op->d] = r[op->a] & (r[op->b] ^ 1);
+}
+
+HANDLER(op_or)
+{
+    r[op->d] = r[op->a] | r[op->b];
+}
+
+HANDLER(op_orn)
+{
+    r[op->d] = r[op->a] | (r[op->b] ^ 1);
+}
+
+HANDLER(op_xor)
+{
+    r[op->d] = r[op->a] ^ r[op->b];
+}
+
+HANDLER(op_sr)
+{
+    r[op->d] = r[op->a] | (r[op->d] & (r[op->b] ^ 1));
+}
+
+HANDLER(op_rs)
+{
+    r[op->d] = (r[op->b] ^ 1) & (r[op->a] | r[op->d]);
+}
+
+HANDLER(op_and_chain)
+{
+    const logic_term_t *t = &terms[op->a | (op->b << 8)];
+    uint8_t acc = 1;
+    for (int i = 0; i < op->n; i++, t++) {
+        acc &= r[t->reg] ^ t->invert;
+    }
+    r[op->d] = acc;
+}
+
+HANDLER(op_or_chain)
+{
+    const logic_term_t *t = &terms[op->a | (op->b << 8)];
+    uint8_t acc = 0;
+    for (int i = 0; i < op->n; i++, t++) {
+        acc |= r[t->reg] ^ t->invert;
+    }
+    r[op->d] = acc;
+}
+
+HANDLER(op_table_chain)
+{
+    const logic_term_t *t = &terms[op->a | (op->b << 8)];
+    unsigned acc = 0;
+    for (int i = 0; i < op->n; i++, t++) {
+        acc = (t->table >> (acc << 1 | r[t->reg])) & 1;
+    }
+    r[op->d] = acc;
+}
+
+HANDLER(op_ton)
+{
+    logic_vm_timer(vm, LOGIC_OP_TON, op->b, r[op->a], program->timer_ms[op->b], now_ms);
+}
+
+HANDLER(op_tof)
+{
+    logic_vm_timer(vm, LOGIC_OP_TOF, op->b, r[op->a], program->timer_ms[op->b], now_ms);
+}
+
+HANDLER(op_tp)
+{
+    logic_vm_timer(vm, LOGIC_OP_TP, op->b, r[op->a], program->timer_ms[op->b], now_ms);
+}
+
+HANDLER(op_ctu)
+{
+    logic_vm_counter(vm, LOGIC_OP_CTU, op->b, r[op->a], r[op->n], program->counter_pv[op->b]);
+}
+
+HANDLER(op_ctd)
+{
+    logic_vm_counter(vm, LOGIC_OP_CTD, op->b, r[op->a], r[op->n], program->counter_pv[op->b]);
+}
+
+HANDLER(op_gt)
+{
+    r[op->d] = vm->word[op->a] > program->consts[op->b];
+}
+
+HANDLER(op_ge)
+{
+    r[op->d] = vm->word[op->a] >= program->consts[op->b];
+}
+
+HANDLER(op_lt)
+{
+    r[op->d] = vm->word[op->a] < program->consts[op->b];
+}
+
+HANDLER(op_le)
+{
+    r[op->d] = vm->word[op->a] <= program->consts[op->b];
+}
+
+HANDLER(op_eq)
+{
+    r[op->d] = vm->word[op->a] == program->consts[op->b];
+}
+
+HANDLER(op_ne)
+{
+    r[op->d] = vm->word[op->a] != program->consts[op->b];
+}
+
+static const logic_thread_fn_t handlers[LOGIC_OP_COUNT] = {
+    [LOGIC_OP_MOV] = op_mov,    [LOGIC_OP_NOT] = op_not,
+    [LOGIC_OP_AND] = op_and,    [LOGIC_OP_ANDN] = op_andn,
+    [LOGIC_OP_OR] = op_or,      [LOGIC_OP_ORN] = op_orn,
+    [LOGIC_OP_XOR] = op_xor,
+    [LOGIC_OP_SR] = op_sr,      [LOGIC_OP_RS] = op_rs,
+    [LOGIC_OP_TON] = op_ton,    [LOGIC_OP_TOF] = op_tof,    [LOGIC_OP_TP] = op_tp,
+    [LOGIC_OP_CTU] = op_ctu,    [LOGIC_OP_CTD] = op_ctd,
+    [LOGIC_OP_GT] = op_gt,      [LOGIC_OP_GE] = op_ge,
+    [LOGIC_OP_LT] = op_lt,      [LOGIC_OP_LE] = op_le,
+    [LOGIC_OP_EQ] = op_eq,      [LOGIC_OP_NE] = op_ne,
+};
+
+// ---- Optimiser ----
+
+static inline bool is_block(uint8_t op)
+{
+    return op >= LOGIC_OP_TON && op <= LOGIC_OP_CTD;
+}
+
+// Bit register operands of each opcode
+#define USE_A   0x01
+#define USE_B   0x02
+#define USE_D   0x04    // Latch state, counter reset / load
+#define DEF_D   0x08
+
+static uint8_t operands(uint8_t op)
+{
+    switch (op) {
+        case LOGIC_OP_MOV:
+        case LOGIC_OP_NOT:
+            return USE_A | DEF_D;
+        case LOGIC_OP_AND:
+        case LOGIC_OP_ANDN:
+        case LOGIC_OP_OR:
+        case LOGIC_OP_ORN:
+        case LOGIC_OP_XOR:
+            return USE_A | USE_B | DEF_D;
+        case LOGIC_OP_SR:
+        case LOGIC_OP_RS:
+            return USE_A | USE_B | USE_D | DEF_D;
+        case LOGIC_OP_TON:
+        case LOGIC_OP_TOF:
+        case LOGIC_OP_TP:
+            return USE_A;
+        case LOGIC_OP_CTU:
+        case LOGIC_OP_CTD:
+            return USE_A | USE_D;
+        case OP_NOP:
+            return 0;
+        default:
+            return DEF_D;       // Comparators read word registers only
+    }
+}
+
+// Bit registers an instruction reads; returns how many
+static int insn_reads(const logic_insn_t *x, uint8_t regs[3])
+{
+    uint8_t use = operands(x->op);
+    int n = 0;
+    if (use & USE_A) {
+        regs[n++] = x->a;
+    }
+    if (use & USE_B) {
+        regs[n++] = x->b;
+    }
+    if (use & USE_D) {
+        regs[n++] = x->d;
+    }
+    return n;
+}
+
+static inline bool konst(logic_insn_t *x, int value)
+{
+    uint8_t reg = value ? LOGIC_REG_TRUE : LOGIC_REG_FALSE;
+    if (x->op == LOGIC_OP_MOV && x->a == reg) {
+        return false;
+    }
+    *x = (logic_insn_t) { .op = LOGIC_OP_MOV, .d = x->d, .a = reg };
+    return true;
+}
+
+static inline bool rewrite(logic_insn_t *x, logic_op_t op, uint8_t a, uint8_t b)
+{
+    *x = (logic_insn_t) { .op = op, .d = x->d, .a = a, .b = b };
+    return true;
+}
+
+static inline bool nop(logic_insn_t *x)
+{
+    x->op = OP_NOP;
+    return true;
+}
+
+// One simplification step given the registers known to be constant at
+// this point of the scan (-1 = unknown); true if the instruction changed
+static bool simplify(logic_insn_t *x, const int8_t *known)
+{
+    int ka = known[x->a];
+    int kb = known[x->b];
+    int kd = known[x->d];
+
+    switch (x->op) {
+        case LOGIC_OP_MOV:
+            if (x->a == x->d) {
+                return nop(x);
+            }
+            return ka >= 0 && x->a > LOGIC_REG_TRUE ? konst(x, ka) : false;
+
+        case LOGIC_OP_NOT:
+            return ka >= 0 ? konst(x, !ka) : false;
+
+        case LOGIC_OP_AND:
+            if (ka == 0 || kb == 0) {
+                return konst(x, 0);
+            }
+            if (ka == 1 || x->a == x->b) {
+                return rewrite(x, LOGIC_OP_MOV, x->b, 0);
+            }
+            return kb == 1 ? rewrite(x, LOGIC_OP_MOV, x->a, 0) : false;
+
+        case LOGIC_OP_ANDN:
+            if (ka == 0 || kb == 1 || x->a == x->b) {
+                return konst(x, 0);
+            }
+            if (kb == 0) {
+                return rewrite(x, LOGIC_OP_MOV, x->a, 0);
+            }
+            return ka == 1 ? rewrite(x, LOGIC_OP_NOT, x->b, 0) : false;
+
+        case LOGIC_OP_OR:
+            if (ka == 1 || kb == 1) {
+                return konst(x, 1);
+            }
+            if (ka == 0 || x->a == x->b) {
+                return rewrite(x, LOGIC_OP_MOV, x->b, 0);
+            }
+            return kb == 0 ? rewrite(x, LOGIC_OP_MOV, x->a, 0) : false;
+
+        case LOGIC_OP_ORN:
+            if (ka == 1 || kb == 0 || x->a == x->b) {
+                return konst(x, 1);
+            }
+            if (kb == 1) {
+                return rewrite(x, LOGIC_OP_MOV, x->a, 0);
+            }
+            return ka == 0 ? rewrite(x, LOGIC_OP_NOT, x->b, 0) : false;
+
+        case LOGIC_OP_XOR:
+            if (x->a == x->b) {
+                return konst(x, 0);
+            }
+            if (ka >= 0 && kb >= 0) {
+                return konst(x, ka ^ kb);
+            }
+            if (ka >= 0) {
+                return rewrite(x, ka ? LOGIC_OP_NOT : LOGIC_OP_MOV, x->b, 0);
+            }
+            return kb >= 0 ? rewrite(x, kb ? LOGIC_OP_NOT : LOGIC_OP_MOV, x->a, 0) : false;
+
+        case LOGIC_OP_SR:   // d = a | (d & !b)
+            if (x->a == x->d) {
+                return nop(x);
+            }
+            if (x->b == x->d) {
+                return rewrite(x, LOGIC_OP_MOV, x->a, 0);
+            }
+            if (ka == 1) {
+                return konst(x, 1);
+            }
+            if (kb == 1 || kd == 0) {
+                return rewrite(x, LOGIC_OP_MOV, x->a, 0);
+            }
+            if (ka == 0) {
+                return kb == 0 ? nop(x) : rewrite(x, LOGIC_OP_ANDN, x->d, x->b);
+            }
+            if (kb == 0) {
+                return rewrite(x, LOGIC_OP_OR, x->a, x->d);
+            }
+            return kd == 1 ? rewrite(x, LOGIC_OP_ORN, x->a, x->b) : false;
+
+        case LOGIC_OP_RS:   // d = !b & (a | d)
+            if (x->a == x->d) {
+                return rewrite(x, LOGIC_OP_ANDN, x->d, x->b);
+            }
+            if (x->b == x->d) {
+                return rewrite(x, LOGIC_OP_ANDN, x->a, x->d);
+            }
+            if (kb == 1) {
+                return konst(x, 0);
+            }
+            if (kb == 0) {
+                return rewrite(x, LOGIC_OP_OR, x->a, x->d);
+            }
+            if (ka == 1 || kd == 1) {
+                return rewrite(x, LOGIC_OP_NOT, x->b, 0);
+            }
+            if (ka == 0) {
+                return rewrite(x, LOGIC_OP_ANDN, x->d, x->b);
+            }
+            return kd == 0 ? rewrite(x, LOGIC_OP_ANDN, x->a, x->b) : false;
+
+        default:
+            return false;
+    }
+}
+
+// Forward pass: fold instructions whose operands are constant at that
+// point of the scan. Only values written earlier in the same pass count;
+// a register read before its write still sees the previous scan.
+static int fold_constants(logic_insn_t *code, int count)
+{
+    int8_t known[LOGIC_REG_COUNT];
+    memset(known, -1, sizeof(known));
+    known[LOGIC_REG_FALSE] = 0;
+    known[LOGIC_REG_TRUE] = 1;
+    int folded = 0;
+
+    for (int i = 0; i < count; i++) {
+        logic_insn_t *x = &code[i];
+        bool changed = false;
+        while (x->op != OP_NOP && simplify(x, known)) {
+            changed = true;
+        }
+        folded += changed;
+
+        if (x->op == OP_NOP || is_block(x->op)) {
+            continue;
+        }
+        known[x->d] = (x->op == LOGIC_OP_MOV && x->a <= LOGIC_REG_TRUE) ? (int8_t)x->a : -1;
+    }
+    return folded;
+}
+
+// Registers read before anything writes them in a scan, i.e. that carry
+// a value over from the previous scan
+static void exposed_reads(const logic_insn_t *code, int count, uint32_t exposed[8])
+{
+    uint32_t written[8] = { 0 };
+    memset(exposed, 0, 8 * sizeof(uint32_t));
+
+    for (int i = 0; i < count; i++) {
+        uint8_t regs[3];
+        int n = insn_reads(&code[i], regs);
+        for (int k = 0; k < n; k++) {
+            if (!REG_BIT(written, regs[k])) {
+                REG_SET(exposed, regs[k]);
+            }
+        }
+        if (code[i].op != OP_NOP && !is_block(code[i].op)) {
+            REG_SET(written, code[i].d);
+        }
+    }
+}
+
+// Backward liveness: drop writes nothing reads before the next write.
+// Outputs, markers and block outputs stay live at the end of the scan,
+// as does anything read at the top of the next one.
+static int remove_dead(logic_insn_t *code, int count, const uint32_t exposed[8])
+{
+    uint32_t live[8];
+    memcpy(live, exposed, sizeof(live));
+    for (int r = LOGIC_REG_OUT; r < LOGIC_REG_TEMP; r++) {
+        REG_SET(live, r);
+    }
+
+    int removed = 0;
+    for (int i = count - 1; i >= 0; i--) {
+        logic_insn_t *x = &code[i];
+        if (x->op == OP_NOP) {
+            removed++;
+            continue;
+        }
+        if (!is_block(x->op)) {
+            if (!REG_BIT(live, x->d)) {
+                x->op = OP_NOP;
+                removed++;
+                continue;
+            }
+            REG_CLEAR(live, x->d);
+        }
+
+        uint8_t regs[3];
+        int n = insn_reads(x, regs);
+        for (int k = 0; k < n; k++) {
+            REG_SET(live, regs[k]);
+        }
+    }
+    return removed;
+}
+
+// ---- Emitter ----
+
+// A step of a fused chain as a truth table of (acc << 1 | operand); -1 if
+// the instruction cannot be one
+static int step_table(uint8_t op)
+{
+    switch (op) {
+        case LOGIC_OP_MOV:  return 0xA;
+        case LOGIC_OP_NOT:  return 0x5;
+        case LOGIC_OP_AND:  return 0x8;
+        case LOGIC_OP_ANDN: return 0x4;
+        case LOGIC_OP_OR:   return 0xE;
+        case LOGIC_OP_ORN:  return 0xD;
+        case LOGIC_OP_XOR:  return 0x6;
+        default:            return -1;
+    }
+}
+
+// Is 'reg' dead from instruction 'from' on?
+static bool dead_from(const logic_insn_t *code, int count, int from, uint8_t reg, const uint32_t exposed[8])
+{
+    for (int i = from; i < count; i++) {
+        uint8_t regs[3];
+        int n = insn_reads(&code[i], regs);
+        for (int k = 0; k < n; k++) {
+            if (regs[k] == reg) {
+                return false;
+            }
+        }
+        if (!is_block(code[i].op) && code[i].d == reg) {
+            return true;
+        }
+    }
+    return reg >= LOGIC_REG_TEMP && !REG_BIT(exposed, reg);
+}
+
+// Length of the chain of logic steps building one result at code[i],
+// including a last step or copy that stores it out of the temporary it
+// was built in; 0 if none
+static int chain_length(const logic_insn_t *code, int count, int i, const uint32_t exposed[8])
+{
+    const logic_insn_t *x = &code[i];
+    if (step_table(x->op) < 0) {
+        return 0;
+    }
+
+    // Continuations fold the next operand into the same destination
+    int j = i + 1;
+    while (j < count && code[j].d == x->d && code[j].a == x->d && code[j].b != x->d &&
+           code[j].op != LOGIC_OP_MOV && code[j].op != LOGIC_OP_NOT && step_table(code[j].op) >= 0) {
+        j++;
+    }
+
+    // A chain built in a temporary and then stored elsewhere writes the target directly
+    if (j < count && code[j].a == x->d && code[j].d != x->d && x->d >= LOGIC_REG_TEMP &&
+        (code[j].op == LOGIC_OP_MOV || (code[j].op != LOGIC_OP_NOT && step_table(code[j].op) >= 0 &&
+                                        code[j].b != x->d)) &&
+        dead_from(code, count, j + 1, x->d, exposed)) {
+        j++;
+    }
+    return j - i < 2 ? 0 : j - i;
+}
+
+// Emit code[i..i+len) as one chain entry; a chain of k steps has at most
+// k + 1 terms, which LOGIC_THREAD_MAX_TERMS allows for. Chains of AND or
+// of OR steps get their own handlers, anything else the truth table one.
+static void emit_chain(const logic_insn_t *code, int i, int len, logic_thread_t *thread)
+{
+    const logic_insn_t *x = &code[i];
+    logic_term_t *terms = &thread->terms[thread->term_count];
+    int n = 0;
+
+    terms[n++] = (logic_term_t) { .reg = x->a, .table = x->op == LOGIC_OP_NOT ? 0x5 : 0xA };
+    if (x->op != LOGIC_OP_MOV && x->op != LOGIC_OP_NOT) {
+        terms[n++] = (logic_term_t) { .reg = x->b, .table = step_table(x->op) };
+    }
+    int end = i + len;
+    uint8_t d = code[end - 1].d;
+    if (code[end - 1].op == LOGIC_OP_MOV) {
+        end--;
+    }
+    for (int k = i + 1; k < end; k++) {
+        terms[n++] = (logic_term_t) { .reg = code[k].b, .table = step_table(code[k].op) };
+    }
+
+    bool all_and = true;
+    bool all_or = true;
+    for (int k = 1; k < n; k++) {
+        all_and &= terms[k].table == 0x8 || terms[k].table == 0x4;
+        all_or &= terms[k].table == 0xE || terms[k].table == 0xD;
+    }
+    logic_thread_fn_t fn = op_table_chain;
+    if (all_and || all_or) {
+        // Both only need to know which operands are inverted
+        for (int k = 0; k < n; k++) {
+            terms[k].invert = terms[k].table == 0x5 || terms[k].table == 0x4 || terms[k].table == 0xD;
+        }
+        fn = all_and ? op_and_chain : op_or_chain;
+    }
+
+    thread->ops[thread->count++] = (logic_thread_op_t) {
+        .fn = fn,
+        .d = d,
+        .a = thread->term_count & 0xFF,
+        .b = thread->term_count >> 8,
+        .n = n
+    };
+    thread->term_count += n;
+}
+
+// ---- Wake lists ----
+
+// Marks an entry built from a fused chain
+#define OP_CHAIN        0xFE
+
+// Word a timer or counter entry writes, from the Q bit in its d
+#define BLOCK_WORD(op)  ((op)->d - LOGIC_REG_TIMER)
+
+_Static_assert(LOGIC_WORD_TIMER == 0 && LOGIC_REG_COUNTER - LOGIC_REG_TIMER == LOGIC_WORD_COUNTER,
+               "block words and Q bits are laid out alike");
+
+// Upload-time scratch, kept off the small HTTP task stack
+typedef struct {
+    uint16_t writers[LOGIC_REG_COUNT];      // Entries writing each register
+    int16_t last_writer[LOGIC_REG_COUNT];   // ...the last one in the program
+    int16_t current[LOGIC_REG_COUNT];       // ...the last one before the entry being linked
+    int16_t word_writer[LOGIC_WORD_COUNT];
+    uint8_t reads[LOGIC_THREAD_MAX_TERMS];
+    // Sized by the program: three per instruction, plus the end fixups
+    uint16_t *from;                         // Links in the order they are found
+    uint16_t *to;
+    logic_fixup_t *fixups;
+} scratch_t;
+
+// Bit registers an entry reads; returns how many
+static int entry_reads(const logic_thread_t *thread, int e, uint8_t kind, uint8_t *regs)
+{
+    const logic_thread_op_t *op = &thread->ops[e];
+    if (kind == OP_CHAIN) {
+        const logic_term_t *t = &thread->terms[op->a | (op->b << 8)];
+        for (int i = 0; i < op->n; i++) {
+            regs[i] = t[i].reg;
+        }
+        return op->n;
+    }
+    logic_insn_t x = { .op = kind, .d = is_block(kind) ? op->n : op->d, .a = op->a, .b = op->b };
+    return insn_reads(&x, regs);
+}
+
+// Gives each value built in a temporary a register of its own, from the
+// temporaries the program never touches, so that reading it needs no
+// fixup. A temporary carried into the next scan, or a latch on one, keeps
+// its register, as does the first value of each. Stops renaming when no
+// free temporary is left; the fixups keep that correct.
+static void rename_temps(logic_thread_t *thread, const uint8_t *kind, const uint32_t exposed[8], scratch_t *s)
+{
+    int count = thread->count;
+    uint32_t used[8] = { 0 };
+    memset(s->writers, 0, sizeof(s->writers));
+    for (int e = 0; e < count; e++) {
+        const logic_thread_op_t *op = &thread->ops[e];
+        int n = entry_reads(thread, e, kind[e], s->reads);
+        for (int k = 0; k < n; k++) {
+            REG_SET(used, s->reads[k]);
+        }
+        if (operands(kind[e]) & DEF_D) {
+            REG_SET(used, op->d);
+            s->writers[op->d]++;
+        }
+    }
+
+    uint8_t name[LOGIC_REG_COUNT];
+    for (int r = 0; r < LOGIC_REG_COUNT; r++) {
+        name[r] = r;
+    }
+    uint32_t first_seen[8] = { 0 };
+    int next_free = LOGIC_REG_TEMP;
+    for (int e = 0; e < count; e++) {
+        logic_thread_op_t *op = &thread->ops[e];
+        uint8_t use = operands(kind[e]);
+        if (kind[e] == OP_CHAIN) {
+            logic_term_t *t = &thread->terms[op->a | (op->b << 8)];
+            for (int i = 0; i < op->n; i++) {
+                t[i].reg = name[t[i].reg];
+            }
+        } else {
+            op->a = use & USE_A ? name[op->a] : op->a;
+            op->b = use & USE_B ? name[op->b] : op->b;
+        }
+        if (use & USE_D) {
+            if (is_block(kind[e])) {
+                op->n = name[op->n];
+            } else {
+                op->d = name[op->d];
+            }
+            continue;
+        }
+
+        uint8_t reg = op->d;
+        if (!(use & DEF_D) || reg < LOGIC_REG_TEMP || REG_BIT(exposed, reg) || s->writers[reg] < 2) {
+            continue;
+        }
+        if (REG_BIT(first_seen, reg)) {
+            while (next_free < LOGIC_REG_COUNT && REG_BIT(used, next_free)) {
+                next_free++;
+            }
+            if (next_free == LOGIC_REG_COUNT) {
+                name[reg] = reg;
+                continue;
+            }
+            REG_SET(used, next_free);
+            name[reg] = next_free;
+            op->d = next_free;
+        }
+        REG_SET(first_seen, reg);
+    }
+}
+
+// Links of the entry being linked start at 'first'; one waker is enough
+static void add_link(scratch_t *s, int *count, int from, int to, int first)
+{
+    for (int k = first; k < *count; k++) {
+        if (s->from[k] == from) {
+            return;
+        }
+    }
+    s->from[*count] = from;
+    s->to[*count] = to;
+    (*count)++;
+}
+
+static void add_fixup(scratch_t *s, int *count, int from, uint8_t reg, int first)
+{
+    for (int k = first; k < *count; k++) {
+        if (s->fixups[k].from == from) {
+            return;
+        }
+    }
+    s->fixups[(*count)++] = (logic_fixup_t) { .from = from, .reg = reg };
+}
+
+// Where the links of entry or extra list 'list' start
+static uint16_t *list_start(logic_thread_t *thread, int list)
+{
+    return list < thread->count ? &thread->ops[list].link : &thread->lists[list - thread->count];
+}
+
+// Links every read to the entry whose result it sees: the last writer
+// before it in the scan, or the last one in the program for a read before
+// the first write, which sees the previous scan. Inputs and timers get
+// lists of their own. Moves the lists to one heap block sized to fit.
+static esp_err_t link_entries(logic_thread_t *thread, const uint8_t *kind, scratch_t *s)
+{
+    int count = thread->count;
+    memset(s->writers, 0, sizeof(s->writers));
+    memset(s->current, 0xFF, sizeof(s->current));
+    memset(s->word_writer, 0xFF, sizeof(s->word_writer));
+    memset(thread->blocks, 0, sizeof(thread->blocks));
+    memset(thread->carried, 0, sizeof(thread->carried));
+    for (int e = 0; e < count; e++) {
+        uint8_t out = thread->ops[e].d;
+        s->writers[out]++;
+        s->last_writer[out] = e;
+        if (is_block(kind[e])) {
+            s->word_writer[BLOCK_WORD(&thread->ops[e])] = e;
+            thread->blocks[e >> 5] |= 1UL << (e & 31);
+        }
+    }
+
+    int links = 0;
+    int fixups = 0;
+    thread->observed_timers = 0;
+    for (int e = 0; e < count; e++) {
+        logic_thread_op_t *op = &thread->ops[e];
+        int first = links;
+        op->fixup = fixups;
+
+        if (kind[e] >= LOGIC_OP_TON && kind[e] <= LOGIC_OP_TP) {
+            add_link(s, &links, count + NUM_INPUTS + op->b, e, first);
+        } else if (kind[e] >= LOGIC_OP_GT && kind[e] < LOGIC_OP_COUNT) {
+            if (s->word_writer[op->a] > e) {
+                thread->carried[e >> 5] |= 1UL << (e & 31);
+            }
+            if (s->word_writer[op->a] >= 0) {
+                add_link(s, &links, count + LOGIC_THREAD_SOURCES + op->a, e, first);
+            }
+            if (op->a < LOGIC_WORD_TIMER + LOGIC_MAX_TIMERS) {
+                thread->observed_timers |= 1UL << (op->a - LOGIC_WORD_TIMER);
+            }
+        }
+
+        int n = entry_reads(thread, e, kind[e], s->reads);
+        for (int k = 0; k < n; k++) {
+            uint8_t reg = s->reads[k];
+            if (reg >= LOGIC_REG_IN && reg < LOGIC_REG_IN + NUM_INPUTS) {
+                add_link(s, &links, count + reg - LOGIC_REG_IN, e, first);
+                continue;
+            }
+            // Nothing writes it: a constant, only the first scan reads it
+            if (s->writers[reg] == 0) {
+                continue;
+            }
+            int from = s->current[reg] >= 0 ? s->current[reg] : s->last_writer[reg];
+            if (from >= e) {
+                thread->carried[e >> 5] |= 1UL << (e & 31);
+            }
+            add_link(s, &links, from, e, first);
+            if (s->writers[reg] > 1) {
+                add_fixup(s, &fixups, from, reg, op->fixup);
+            }
+        }
+        s->current[op->d] = e;
+    }
+
+    thread->ops[count].fixup = fixups;
+    for (int reg = 0; reg < LOGIC_REG_COUNT; reg++) {
+        if (s->writers[reg] > 1) {
+            s->fixups[fixups++] = (logic_fixup_t) { .from = s->last_writer[reg], .reg = reg };
+        }
+    }
+    thread->fixup_count = fixups;
+
+    size_t size = fixups * sizeof(logic_fixup_t) + links * sizeof(uint16_t);
+    thread->fixups = size > 0 ? malloc(size) : NULL;
+    if (size > 0 && thread->fixups == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    thread->links = (uint16_t *)&thread->fixups[fixups];
+    if (fixups > 0) {
+        memcpy(thread->fixups, s->fixups, fixups * sizeof(logic_fixup_t));
+    }
+
+    // Group the links by waker, keeping each list in program order: count
+    // each list, turn the counts into where each list ends, then fill
+    // every list from its end, which leaves where it starts
+    int lists = count + LOGIC_THREAD_LISTS;
+    for (int i = 0; i <= lists; i++) {
+        *list_start(thread, i) = 0;
+    }
+    for (int k = 0; k < links; k++) {
+        (*list_start(thread, s->from[k]))++;
+    }
+    int total = 0;
+    for (int i = 0; i <= lists; i++) {
+        total += *list_start(thread, i);
+        *list_start(thread, i) = total;
+    }
+    for (int k = links - 1; k >= 0; k--) {
+        thread->links[--*list_start(thread, s->from[k])] = s->to[k];
+    }
+    thread->ops[count].link = thread->lists[0];
+    return ESP_OK;
+}
+
+esp_err_t logic_thread_compile(const logic_program_t *program, logic_thread_t *thread, logic_thread_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    free(thread->fixups);
+    thread->fixups = NULL;
+    thread->links = NULL;
+    thread->count = 0;
+    thread->term_count = 0;
+    thread->fixup_count = 0;
+    thread->observed_timers = 0;
+    thread->ops[0].link = 0;
+    thread->ops[0].fixup = 0;
+    memset(thread->lists, 0, sizeof(thread->lists));
+    stats->source_insns = program->count;
+    if (program->count == 0) {
+        return ESP_OK;
+    }
+
+    // Upload-time scratch; the scan path itself never allocates
+    int count = program->count;
+    size_t per_insn = 3 * (2 * sizeof(uint16_t) + sizeof(logic_fixup_t)) +
+                      sizeof(uint16_t) + sizeof(logic_insn_t) + sizeof(uint8_t);
+    scratch_t *scratch = malloc(sizeof(scratch_t) + LOGIC_REG_COUNT * sizeof(logic_fixup_t) + count * per_insn);
+    if (scratch == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    scratch->fixups = (logic_fixup_t *)(scratch + 1);
+    scratch->from = (uint16_t *)&scratch->fixups[3 * count + LOGIC_REG_COUNT];
+    scratch->to = &scratch->from[3 * count];
+    uint16_t *chain = &scratch->to[3 * count];                  // Chain length at its first step
+    logic_insn_t *code = (logic_insn_t *)&chain[count];
+    uint8_t *kind = (uint8_t *)&code[count];                    // Opcode of each entry
+    memcpy(code, program->code, count * sizeof(logic_insn_t));
+
+    uint32_t exposed[8];
+    stats->folded = fold_constants(code, count);
+    exposed_reads(code, count, exposed);
+    stats->removed = remove_dead(code, count, exposed);
+
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (code[i].op != OP_NOP) {
+            code[kept++] = code[i];
+        }
+    }
+    count = kept;
+
+    exposed_reads(code, count, exposed);
+    for (int i = 0; i < count; ) {
+        chain[i] = chain_length(code, count, i, exposed);
+        if (chain[i]) {
+            kind[thread->count] = OP_CHAIN;
+            emit_chain(code, i, chain[i], thread);
+            stats->fused += chain[i] - 1;
+            i += chain[i];
+            continue;
+        }
+
+        const logic_insn_t *x = &code[i];
+        kind[thread->count] = x->op;
+        logic_thread_op_t *op = &thread->ops[thread->count++];
+        *op = (logic_thread_op_t) { .fn = handlers[x->op], .d = x->d, .a = x->a, .b = x->b };
+        i++;
+        if (x->op == LOGIC_OP_MOV && x->a <= LOGIC_REG_TRUE) {
+            op->fn = x->a == LOGIC_REG_TRUE ? op_const1 : op_const0;
+        } else if (is_block(x->op)) {
+            // Blocks write their Q bit; a counter's reset moves to n
+            op->d = (x->op <= LOGIC_OP_TP ? LOGIC_REG_TIMER : LOGIC_REG_COUNTER) + x->b;
+            op->n = x->d;
+        }
+    }
+    rename_temps(thread, kind, exposed, scratch);
+    esp_err_t err = link_entries(thread, kind, scratch);
+    free(scratch);
+    if (err != ESP_OK) {
+        thread->count = 0;
+        return err;
+    }
+
+    int links = thread->lists[LOGIC_THREAD_LISTS];
+    stats->ops = thread->count;
+    stats->code_bytes = thread->count * sizeof(logic_thread_op_t) + thread->term_count * sizeof(logic_term_t) +
+                        links * sizeof(uint16_t) + thread->fixup_count * sizeof(logic_fixup_t);
+    ESP_LOGI(TAG, "%u instructions -> %u threaded ops (%u folded, %u removed, %u fused), %lu bytes, %d links, %u fixups",
+             stats->source_insns, stats->ops, stats->folded, stats->removed, stats->fused,
+             (unsigned long)stats->code_bytes, links, thread->fixup_count);
+    return ESP_OK;
+}
+
+static inline void wake(uint32_t *set, uint16_t entry)
+{
+    set[entry >> 5] |= 1UL << (entry & 31);
+}
+
+// Runs the woken entries in program order. An entry whose result changed
+// wakes its readers: later ones in this scan, earlier ones in the next.
+static uint16_t run_woken(logic_vm_t *vm, const logic_program_t *program, const logic_thread_t *thread,
+                          uint32_t *work, int64_t now_ms)
+{
+    uint8_t *r = vm->reg;
+    uint8_t *result = vm->result;
+    const logic_term_t *terms = thread->terms;
+    const logic_thread_op_t *ops = thread->ops;
+    const logic_fixup_t *fixups = thread->fixups;
+    const uint16_t *links = thread->links;
+    int words = (thread->count + 31) / 32;
+    uint16_t evaluated = 0;
+
+    for (int w = 0; w < words; w++) {
+        while (work[w]) {
+            int e = w * 32 + __builtin_ctz(work[w]);
+            work[w] &= work[w] - 1;
+            const logic_thread_op_t *op = &ops[e];
+            bool block = thread->blocks[w] & (1UL << (e & 31));
+            int32_t word = block ? vm->word[BLOCK_WORD(op)] : 0;
+
+            for (int k = op->fixup; k < op[1].fixup; k++) {
+                r[fixups[k].reg] = result[fixups[k].from];
+            }
+            op->fn(op, r, terms, program, vm, now_ms);
+            evaluated++;
+
+            // Comparators on a block's elapsed time or count have a list
+            // of their own, so a running timer does not wake its Q readers
+            if (block && vm->word[BLOCK_WORD(op)] != word) {
+                int list = LOGIC_THREAD_SOURCES + BLOCK_WORD(op);
+                for (int k = thread->lists[list]; k < thread->lists[list + 1]; k++) {
+                    wake(links[k] > e ? work : vm->pending, links[k]);
+                }
+            }
+            if (r[op->d] == result[e]) {
+                continue;
+            }
+            result[e] = r[op->d];
+            for (int k = op->link; k < op[1].link; k++) {
+                wake(links[k] > e ? work : vm->pending, links[k]);
+            }
+        }
+    }
+    return evaluated;
+}
+
+uint32_t logic_thread_exec(logic_vm_t *vm, const logic_program_t *program, const logic_thread_t *thread,
+                           uint32_t inputs, int64_t now_ms, bool full)
+{
+    uint8_t *r = vm->reg;
+    uint32_t changed = 0;
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        uint8_t bit = (inputs >> i) & 1;
+        if (r[LOGIC_REG_IN + i] != bit) {
+            changed |= 1UL << i;
+        }
+        r[LOGIC_REG_IN + i] = bit;
+    }
+
+    // A running timer needs its block run once it is due, or on every
+    // scan while the program compares its elapsed time. A pulse timer
+    // also clears its elapsed time on the scan after it expires.
+    uint32_t timing = vm->timing;
+    uint32_t due = vm->timing_ended;
+    for (uint32_t bits = timing; bits; bits &= bits - 1) {
+        int t = __builtin_ctz(bits);
+        if ((thread->observed_timers & (1UL << t)) ||
+            now_ms - vm->timer_start_ms[t] >= (int64_t)program->timer_ms[t]) {
+            due |= 1UL << t;
+        }
+    }
+
+    if (full) {
+        const logic_term_t *terms = thread->terms;
+        const logic_thread_op_t *end = thread->ops + thread->count;
+        uint8_t *result = vm->result;
+        for (const logic_thread_op_t *op = thread->ops; op < end; op++) {
+            op->fn(op, r, terms, program, vm, now_ms);
+            *result++ = r[op->d];
+        }
+        // Nothing tracked what this scan changed, so whatever reads a
+        // value it left runs again on the next one
+        memcpy(vm->pending, thread->carried, sizeof(vm->pending));
+        vm->evaluated = thread->count;
+    } else {
+        // Start from what the previous scan woke, plus the inputs and timers
+        uint32_t work[LOGIC_MAX_INSNS / 32];
+        int words = (thread->count + 31) / 32;
+        memcpy(work, vm->pending, words * sizeof(uint32_t));
+        memset(vm->pending, 0, words * sizeof(uint32_t));
+        for (uint32_t sources = changed | due << NUM_INPUTS; sources; sources &= sources - 1) {
+            int s = __builtin_ctz(sources);
+            for (int k = thread->lists[s]; k < thread->lists[s + 1]; k++) {
+                wake(work, thread->links[k]);
+            }
+        }
+        vm->evaluated = run_woken(vm, program, thread, work, now_ms);
+
+        for (int k = thread->ops[thread->count].fixup; k < thread->fixup_count; k++) {
+            r[thread->fixups[k].reg] = vm->result[thread->fixups[k].from];
+        }
+    }
+    vm->timing_ended = timing & ~vm->timing;
+
+    uint32_t outputs = 0;
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        outputs |= (uint32_t)r[LOGIC_REG_OUT + i] << i;
+    }
+    return outputs;
+}
@@ -0,0 +1,98 @@
+#ifndef LOGIC_THREAD_H
+#define LOGIC_THREAD_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "logic_vm.h"
+
+// Second compilation stage for logic programs: constant folding and dead
+// code elimination over the verified bytecode, then a direct-threaded
+// table with one handler per rung. Chains of AND/OR/XOR steps that build
+// one result are fused into a single entry, so a typical rung costs one
+// indirect call.
+//
+// Each entry knows which entries read its result, and which entries read
+// each input or drive each timer. A scan runs, in program order, only the
+// entries woken by an input that toggled, a timer that is due, or an
+// entry before them whose result changed; a reader before its writer is
+// woken on the next scan. Skipped entries cost nothing.
+
+// Wake lists beyond the entries: one per input, one per timer block, then
+// the comparators on each timer's elapsed time and each counter's value
+#define LOGIC_THREAD_SOURCES    (NUM_INPUTS + LOGIC_MAX_TIMERS)
+#define LOGIC_THREAD_LISTS      (LOGIC_THREAD_SOURCES + LOGIC_WORD_COUNT)
+
+_Static_assert(LOGIC_MAX_INSNS % 32 == 0, "entry bitmaps hold whole words");
+
+// A chain of k instructions has k + 1 terms and k is at least 2
+#define LOGIC_THREAD_MAX_TERMS  (LOGIC_MAX_INSNS * 3 / 2)
+
+typedef struct logic_thread_op logic_thread_op_t;
+typedef struct logic_term logic_term_t;
+typedef void (*logic_thread_fn_t)(const logic_thread_op_t *op, uint8_t *r, const logic_term_t *terms,
+                                  const logic_program_t *program, logic_vm_t *vm, int64_t now_ms);
+
+struct logic_thread_op {
+    logic_thread_fn_t fn;
+    uint8_t d;              // Timers and counters: their Q bit
+    uint8_t a;              // Fused chains: first term, low byte
+    uint8_t b;              // Fused chains: first term, high byte
+    uint8_t n;              // Fused chains: term count; counters: reset
+    uint16_t link;          // First link, the next entry's first ends them
+    uint16_t fixup;         // First fixup, likewise
+};
+
+// A register with several writers may hold another writer's value when a
+// skipped one would have written it; a fixup puts the right one back
+typedef struct {
+    uint16_t from;          // Entry whose result the register must hold
+    uint8_t reg;
+} logic_fixup_t;
+
+// Operand of a fused chain
+struct logic_term {
+    uint8_t reg;
+    union {
+        uint8_t invert;     // AND and OR chains: 0 or 1
+        uint8_t table;      // Other chains: result by (acc << 1 | reg), 4 bits
+    };
+};
+
+typedef struct {
+    uint16_t count;
+    uint16_t term_count;
+    logic_thread_op_t ops[LOGIC_MAX_INSNS + 1];     // ops[count] ends the lists of the last entry
+    logic_term_t terms[LOGIC_THREAD_MAX_TERMS];
+    // Entry e wakes links[ops[e].link..ops[e + 1].link) when its result
+    // changes, extra list l wakes links[lists[l]..lists[l + 1]). Before
+    // entry e runs, fixups[ops[e].fixup..ops[e + 1].fixup) put back what
+    // it reads; the rest put back the last writers after a scan.
+    uint16_t lists[LOGIC_THREAD_LISTS + 1];
+    uint16_t fixup_count;
+    uint16_t *links;                        // Heap, sized by logic_thread_compile()
+    logic_fixup_t *fixups;                  // ...in the same block
+    uint32_t blocks[LOGIC_MAX_INSNS / 32];  // Timer and counter entries
+    uint32_t carried[LOGIC_MAX_INSNS / 32]; // Entries reading a value the previous scan left
+    uint32_t observed_timers;               // Timers whose elapsed time is compared
+} logic_thread_t;
+
+typedef struct {
+    uint16_t source_insns;  // Verified bytecode
+    uint16_t folded;        // Instructions simplified by constant folding
+    uint16_t removed;       // Dead or no-op instructions dropped
+    uint16_t fused;         // Instructions merged into chains
+    uint16_t ops;           // Threaded entries
+    uint32_t code_bytes;    // Threaded table, chain terms and wake lists
+} logic_thread_stats_t;
+
+// Function prototypes
+// Compile a verified program, replacing what 'thread' held; only fails
+// when out of memory
+esp_err_t logic_thread_compile(const logic_program_t *program, logic_thread_t *thread, logic_thread_stats_t *stats);
+// Same contract as logic_vm_exec(), but only runs the entries affected
+// since the previous call; 'full' runs all of them (first scan) and must
+// be set whenever 'vm' last ran another program
+uint32_t logic_thread_exec(logic_vm_t *vm, const logic_program_t *program, const logic_thread_t *thread,
+                           uint32_t inputs, int64_t now_ms, bool full);
+
+#endif // LOGIC_THREAD_H
@@ -0,0 +1,636 @@
+#include <stdatomic.h>
+#include <string.h>
+#include <strings.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "auto_board.h"
+#include "time_base.h"
+#include "timer_wheel.h"
+#include "scan_cycle.h"
+#include "logic_vm.h"
+#include "logic_thread.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "LOGIC_VM";
+
+static const char *op_names[LOGIC_OP_COUNT] = {
+    "mov", "not", "and", "andn", "or", "orn", "xor", "sr", "rs",
+    "ton", "tof", "tp", "ctu", "ctd", "gt", "ge", "lt", "le", "eq", "ne"
+};
+
+typedef struct {
+    const char *prefix;
+    uint8_t base;
+    uint8_t count;
+} reg_bank_t;
+
+static const reg_bank_t reg_banks[] = {
+    { "IN", LOGIC_REG_IN, NUM_INPUTS },
+    { "OUT", LOGIC_REG_OUT, NUM_OUTPUTS },
+    { "M", LOGIC_REG_MARKER, LOGIC_MAX_MARKERS },
+    { "T", LOGIC_REG_TIMER, LOGIC_MAX_TIMERS },
+    { "C", LOGIC_REG_COUNTER, LOGIC_MAX_COUNTERS },
+};
+
+// Double-buffered program, swapped the same way as the input profile
+// table: the scan reads the active one without a lock. Each slot has its
+// threaded code next to it.
+static logic_program_t programs[2];
+static logic_thread_t threads[2];
+static logic_thread_stats_t thread_stats[2];
+static uint32_t slot_generation[2];     // Install that filled each slot; 0 = none
+static uint32_t install_count = 0;
+static _Atomic(logic_program_t *) active_program = NULL;
+static atomic_uint reader_seq = 0;      // Odd while the scan is running a program
+static SemaphoreHandle_t writer_mutex = NULL;
+
+// Interpreter state, only written by the scan task
+static logic_vm_t vm;
+static const logic_program_t *vm_program = NULL;
+static uint32_t vm_generation = 0;
+static logic_vm_status_t vm_status;
+static uint64_t vm_total_us;
+
+// One-shot wakeup for the next timer to expire, so running timers do not
+// need the periodic tick
+static timer_wheel_handle_t wake_handle = 0;
+static atomic_bool wake_pending = false;
+static int64_t wake_at_ms = 0;
+static bool wake_failed = false;
+
+static inline bool writable(uint8_t reg)
+{
+    return (reg >= LOGIC_REG_OUT && reg < LOGIC_REG_OUT + NUM_OUTPUTS) || reg >= LOGIC_REG_MARKER;
+}
+
+esp_err_t logic_program_verify(logic_program_t *program)
+{
+    if (program->version != LOGIC_PROGRAM_VERSION || program->count > LOGIC_MAX_INSNS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t timers_used = 0;
+    uint32_t counters_used = 0;
+    uint32_t out_mask = 0;
+
+    for (int i = 0; i < program->count; i++) {
+        const logic_insn_t *insn = &program->code[i];
+        bool writes_d = true;
+
+        switch (insn->op) {
+            case LOGIC_OP_TON:
+            case LOGIC_OP_TOF:
+            case LOGIC_OP_TP:
+                // Every block instance has exactly one instruction driving it
+                if (insn->b >= LOGIC_MAX_TIMERS || (timers_used & (1UL << insn->b)) ||
+                    program->timer_ms[insn->b] > LOGIC_TIMER_MAX_MS) {
+                    return ESP_ERR_INVALID_ARG;
+                }
+                timers_used |= 1UL << insn->b;
+                writes_d = false;
+                break;
+
+            case LOGIC_OP_CTU:
+            case LOGIC_OP_CTD:
+                if (insn->b >= LOGIC_MAX_COUNTERS || (counters_used & (1UL << insn->b))) {
+                    return ESP_ERR_INVALID_ARG;
+                }
+                counters_used |= 1UL << insn->b;
+                writes_d = false;
+                break;
+
+            case LOGIC_OP_GT:
+            case LOGIC_OP_GE:
+            case LOGIC_OP_LT:
+            case LOGIC_OP_LE:
+            case LOGIC_OP_EQ:
+            case LOGIC_OP_NE:
+                if (insn->a >= LOGIC_WORD_COUNT || insn->b >= LOGIC_MAX_CONSTS) {
+                    return ESP_ERR_INVALID_ARG;
+                }
+                break;
+
+            default:
+                if (insn->op >= LOGIC_OP_COUNT) {
+                    return ESP_ERR_INVALID_ARG;
+                }
+                break;
+        }
+
+        if (writes_d) {
+            if (!writable(insn->d)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            if (insn->d < LOGIC_REG_OUT + NUM_OUTPUTS) {
+                out_mask |= 1UL << (insn->d - LOGIC_REG_OUT);
+            }
+        }
+    }
+
+    program->out_mask = out_mask;
+    return ESP_OK;
+}
+
+void logic_vm_reset(logic_vm_t *state)
+{
+    memset(state, 0, sizeof(*state));
+    state->reg[LOGIC_REG_TRUE] = 1;
+}
+
+// Elapsed time of a running timer, clamped to its preset; true once it ran out
+static inline bool timer_elapsed(logic_vm_t *state, int t, uint32_t preset_ms, int64_t now_ms)
+{
+    if (!(state->timing & (1UL << t))) {
+        state->timing |= 1UL << t;
+        state->timer_start_ms[t] = now_ms;
+    }
+
+    int64_t elapsed = now_ms - state->timer_start_ms[t];
+    if (elapsed >= preset_ms) {
+        state->word[LOGIC_WORD_TIMER + t] = (int32_t)preset_ms;
+        state->timing &= ~(1UL << t);
+        return true;
+    }
+    state->word[LOGIC_WORD_TIMER + t] = (int32_t)elapsed;
+    return false;
+}
+
+void logic_vm_timer(logic_vm_t *state, uint8_t op, uint8_t t, bool in, uint32_t preset_ms, int64_t now_ms)
+{
+    uint8_t *q = &state->reg[LOGIC_REG_TIMER + t];
+    uint32_t bit = 1UL << t;
+
+    switch (op) {
+        case LOGIC_OP_TON:
+            if (!in) {
+                *q = 0;
+                state->word[LOGIC_WORD_TIMER + t] = 0;
+                state->timing &= ~bit;
+            } else if (!*q) {
+                *q = timer_elapsed(state, t, preset_ms, now_ms);
+            }
+            break;
+
+        case LOGIC_OP_TOF:
+            if (in) {
+                *q = 1;
+                state->word[LOGIC_WORD_TIMER + t] = 0;
+                state->timing &= ~bit;
+            } else if (*q) {
+                *q = !timer_elapsed(state, t, preset_ms, now_ms);
+            }
+            break;
+
+        case LOGIC_OP_TP: {
+            bool rising = in && !(state->timer_in & bit);
+            state->timer_in = in ? (state->timer_in | bit) : (state->timer_in & ~bit);
+
+            if (*q || rising) {
+                *q = !timer_elapsed(state, t, preset_ms, now_ms);
+            } else if (!in) {
+                state->word[LOGIC_WORD_TIMER + t] = 0;
+            }
+            break;
+        }
+    }
+}
+
+void logic_vm_counter(logic_vm_t *state, uint8_t op, uint8_t c, bool in, bool reset, int32_t preset)
+{
+    int32_t *cv = &state->word[LOGIC_WORD_COUNTER + c];
+    uint32_t bit = 1UL << c;
+    bool rising = in && !(state->counter_in & bit);
+    state->counter_in = in ? (state->counter_in | bit) : (state->counter_in & ~bit);
+
+    if (op == LOGIC_OP_CTU) {
+        if (reset) {
+            *cv = 0;
+        } else if (rising && *cv < INT32_MAX) {
+            (*cv)++;
+        }
+        state->reg[LOGIC_REG_COUNTER + c] = *cv >= preset;
+    } else {
+        if (reset) {
+            *cv = preset;
+        } else if (rising && *cv > INT32_MIN) {
+            (*cv)--;
+        }
+        state->reg[LOGIC_REG_COUNTER + c] = *cv <= 0;
+    }
+}
+
+uint32_t logic_vm_exec(logic_vm_t *state, const logic_program_t *program, uint32_t inputs, int64_t now_ms)
+{
+    uint8_t *r = state->reg;
+    const int32_t *w = state->word;
+
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        r[LOGIC_REG_IN + i] = (inputs >> i) & 1;
+    }
+
+    const logic_insn_t *end = program->code + program->count;
+    for (const logic_insn_t *pc = program->code; pc < end; pc++) {
+        uint8_t d = pc->d;
+        uint8_t a = pc->a;
+        uint8_t b = pc->b;
+
+        switch (pc->op) {
+            case LOGIC_OP_MOV:  r[d] = r[a]; break;
+            case LOGIC_OP_NOT:  r[d] = r[a] ^ 1; break;
+            case LOGIC_OP_AND:  r[d] = r[a] & r[b]; break;
+            case LOGIC_OP_ANDN: r[d] = r[a] & (r[b] ^ 1); break;
+            case LOGIC_OP_OR:   r[d] = r[a] | r[b]; break;
+            case LOGIC_OP_ORN:  r[d] = r[a] | (r[b] ^ 1); break;
+            case LOGIC_OP_XOR:  r[d] = r[a] ^ r[b]; break;
+            case LOGIC_OP_SR:   r[d] = r[a] | (r[d] & (r[b] ^ 1)); break;
+            case LOGIC_OP_RS:   r[d] = (r[b] ^ 1) & (r[a] | r[d]); break;
+
+            case LOGIC_OP_TON:
+            case LOGIC_OP_TOF:
+            case LOGIC_OP_TP:
+                logic_vm_timer(state, pc->op, b, r[a], program->timer_ms[b], now_ms);
+                break;
+
+            case LOGIC_OP_CTU:
+            case LOGIC_OP_CTD:
+                logic_vm_counter(state, pc->op, b, r[a], r[d], program->counter_pv[b]);
+                break;
+
+            case LOGIC_OP_GT:   r[d] = w[a] > program->consts[b]; break;
+            case LOGIC_OP_GE:   r[d] = w[a] >= program->consts[b]; break;
+            case LOGIC_OP_LT:   r[d] = w[a] < program->consts[b]; break;
+            case LOGIC_OP_LE:   r[d] = w[a] <= program->consts[b]; break;
+            case LOGIC_OP_EQ:   r[d] = w[a] == program->consts[b]; break;
+            case LOGIC_OP_NE:   r[d] = w[a] != program->consts[b]; break;
+        }
+    }
+
+    uint32_t outputs = 0;
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        outputs |= (uint32_t)r[LOGIC_REG_OUT + i] << i;
+    }
+    return outputs;
+}
+
+static esp_err_t save_program(const logic_program_t *program)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(LOGIC_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (program->count == 0) {
+        err = nvs_erase_key(nvs_handle, "program");
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    } else {
+        size_t len = LOGIC_PROGRAM_HEADER_SIZE + program->count * sizeof(logic_insn_t);
+        err = nvs_set_blob(nvs_handle, "program", program, len);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t logic_vm_init(void)
+{
+    writer_mutex = xSemaphoreCreateMutex();
+    if (writer_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open(LOGIC_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        ESP_LOGI(TAG, "No stored logic program");
+        return ESP_OK;
+    }
+
+    logic_program_t *program = &programs[0];
+    size_t len = sizeof(*program);
+    esp_err_t err = nvs_get_blob(nvs_handle, "program", program, &len);
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGI(TAG, "No stored logic program");
+    } else if (len < LOGIC_PROGRAM_HEADER_SIZE ||
+               len != LOGIC_PROGRAM_HEADER_SIZE + program->count * sizeof(logic_insn_t) ||
+               logic_program_verify(program) != ESP_OK) {
+        ESP_LOGW(TAG, "Stored logic program invalid, ignored");
+    } else if ((err = logic_thread_compile(program, &threads[0], &thread_stats[0])) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to compile logic program: %s", esp_err_to_name(err));
+    } else {
+        slot_generation[0] = ++install_count;
+        atomic_store(&active_program, program);
+        ESP_LOGI(TAG, "Loaded logic program: %u instructions, outputs 0x%02lx",
+                 program->count, (unsigned long)program->out_mask);
+    }
+    return ESP_OK;
+}
+
+esp_err_t logic_vm_install(const logic_program_t *program)
+{
+    if (writer_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (program->count > LOGIC_MAX_INSNS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(writer_mutex, portMAX_DELAY);
+    logic_program_t *current = atomic_load(&active_program);
+    logic_program_t *spare = (current == &programs[0]) ? &programs[1] : &programs[0];
+
+    // The spare buffer may be the one swapped out last time: wait until a
+    // scan that may still be running it is done
+    uint32_t seq = atomic_load(&reader_seq);
+    while (seq & 1) {
+        vTaskDelay(1);
+        if (atomic_load(&reader_seq) != seq) {
+            break;
+        }
+    }
+
+    memcpy(spare, program, LOGIC_PROGRAM_HEADER_SIZE + program->count * sizeof(logic_insn_t));
+    int slot = spare - programs;
+    esp_err_t err = logic_program_verify(spare);
+    if (err == ESP_OK) {
+        err = logic_thread_compile(spare, &threads[slot], &thread_stats[slot]);
+    }
+    if (err != ESP_OK) {
+        xSemaphoreGive(writer_mutex);
+        return err;
+    }
+
+    // The slots alternate, so two installs in a row can hand the scan the
+    // same pointer; the generation tells them apart
+    slot_generation[slot] = ++install_count;
+    atomic_store(&active_program, spare->count > 0 ? spare : NULL);
+    err = save_program(spare);
+    xSemaphoreGive(writer_mutex);
+
+    ESP_LOGI(TAG, "Installed logic program: %u instructions, outputs 0x%02lx",
+             spare->count, (unsigned long)spare->out_mask);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Logic program not saved: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static void wakeup_fired(timer_wheel_handle_t handle, void *arg)
+{
+    atomic_store(&wake_pending, false);
+    scan_cycle_notify(SCAN_EVENT_TIMER);
+}
+
+// Keep one wheel timer armed for the earliest deadline among the running
+// timers the scan does not poll
+static void arm_wakeup(const logic_program_t *program, const logic_thread_t *thread, int64_t now_ms)
+{
+    int64_t next = INT64_MAX;
+    uint32_t unobserved = program != NULL ? vm.timing & ~thread->observed_timers : 0;
+    for (uint32_t bits = unobserved; bits; bits &= bits - 1) {
+        int t = __builtin_ctz(bits);
+        int64_t due = vm.timer_start_ms[t] + program->timer_ms[t];
+        if (due < next) {
+            next = due;
+        }
+    }
+
+    if (next == wake_at_ms && atomic_load(&wake_pending)) {
+        return;
+    }
+    if (atomic_exchange(&wake_pending, false)) {
+        timer_wheel_cancel(wake_handle);
+    }
+    wake_at_ms = next;
+    wake_failed = false;
+    if (next == INT64_MAX) {
+        return;
+    }
+
+    int64_t delay = next - now_ms;
+    atomic_store(&wake_pending, true);
+    wake_handle = timer_wheel_add(delay > 0 ? (uint32_t)delay : 1, wakeup_fired, NULL);
+    if (wake_handle == 0) {
+        // Pool full: fall back to the periodic tick
+        atomic_store(&wake_pending, false);
+        wake_failed = true;
+    }
+}
+
+bool logic_vm_scan(uint32_t inputs, uint32_t *bits, uint32_t *mask)
+{
+    atomic_fetch_add(&reader_seq, 1);
+    const logic_program_t *program = atomic_load(&active_program);
+
+    // A new program starts from cleared registers, timers and counters
+    uint32_t generation = program != NULL ? slot_generation[program - programs] : 0;
+    bool first = generation != vm_generation;
+    if (first) {
+        logic_vm_reset(&vm);
+        vm_program = program;
+        vm_generation = generation;
+        vm_status.scans = 0;
+        vm_status.max_us = 0;
+        vm_total_us = 0;
+    }
+
+    if (program == NULL) {
+        atomic_fetch_add(&reader_seq, 1);
+        arm_wakeup(NULL, NULL, 0);
+        return false;
+    }
+
+    const logic_thread_t *thread = &threads[program - programs];
+    int64_t start = time_base_now_us();
+    *bits = logic_thread_exec(&vm, program, thread, inputs, start / 1000, first);
+    *mask = program->out_mask;
+    uint32_t exec_us = (uint32_t)time_base_since_us(start);
+    arm_wakeup(program, thread, start / 1000);
+    atomic_fetch_add(&reader_seq, 1);
+
+    vm_status.scans++;
+    vm_status.last_us = exec_us;
+    vm_total_us += exec_us;
+    vm_status.avg_us = (uint32_t)(vm_total_us / vm_status.scans);
+    if (exec_us > vm_status.max_us) {
+        vm_status.max_us = exec_us;
+    }
+    return true;
+}
+
+bool logic_vm_needs_tick(void)
+{
+    if (vm_program == NULL) {
+        return false;
+    }
+    uint32_t polled = wake_failed ? UINT32_MAX : threads[vm_program - programs].observed_timers;
+    return (vm.timing & polled) != 0;
+}
+
+void logic_vm_get_status(logic_vm_status_t *status)
+{
+    const logic_program_t *program = atomic_load(&active_program);
+
+    *status = vm_status;
+    status->loaded = program != NULL;
+    status->insn_count = program != NULL ? program->count : 0;
+    status->out_mask = program != NULL ? program->out_mask : 0;
+    status->timing = vm.timing;
+    if (program != NULL) {
+        const logic_thread_stats_t *stats = &thread_stats[program - programs];
+        status->thread_ops = stats->ops;
+        status->folded = stats->folded;
+        status->removed = stats->removed;
+        status->fused = stats->fused;
+        status->code_bytes = stats->code_bytes;
+        status->evaluated = vm.evaluated;
+    }
+}
+
+bool logic_vm_get_timer(uint8_t timer_num, int32_t *elapsed_ms)
+{
+    if (timer_num >= LOGIC_MAX_TIMERS) {
+        return false;
+    }
+    *elapsed_ms = vm.word[LOGIC_WORD_TIMER + timer_num];
+
+    // Scans skip a running timer until it is due, so work out its
+    // elapsed time here
+    const logic_program_t *program = vm_program;
+    if (program != NULL && (vm.timing & (1UL << timer_num))) {
+        int64_t elapsed = time_base_now_us() / 1000 - vm.timer_start_ms[timer_num];
+        uint32_t preset = program->timer_ms[timer_num];
+        *elapsed_ms = (int32_t)(elapsed < preset ? elapsed : preset);
+    }
+    return vm.reg[LOGIC_REG_TIMER + timer_num] != 0;
+}
+
+bool logic_vm_get_counter(uint8_t counter_num, int32_t *value)
+{
+    if (counter_num >= LOGIC_MAX_COUNTERS) {
+        return false;
+    }
+    *value = vm.word[LOGIC_WORD_COUNTER + counter_num];
+    return vm.reg[LOGIC_REG_COUNTER + counter_num] != 0;
+}
+
+bool logic_vm_get_marker(uint8_t marker_num)
+{
+    return marker_num < LOGIC_MAX_MARKERS && vm.reg[LOGIC_REG_MARKER + marker_num] != 0;
+}
+
+// Split "T12.ET" into its bank, 0-based index and suffix; false if malformed
+static bool parse_name(const char *name, size_t len, const reg_bank_t **bank, int *index,
+                       const char **suffix, size_t *suffix_len)
+{
+    size_t prefix_len = 0;
+    while (prefix_len < len && ((name[prefix_len] | 0x20) >= 'a' && (name[prefix_len] | 0x20) <= 'z')) {
+        prefix_len++;
+    }
+
+    *bank = NULL;
+    for (size_t i = 0; i < sizeof(reg_banks) / sizeof(reg_banks[0]); i++) {
+        if (strlen(reg_banks[i].prefix) == prefix_len && strncasecmp(name, reg_banks[i].prefix, prefix_len) == 0) {
+            *bank = &reg_banks[i];
+            break;
+        }
+    }
+
+    size_t pos = prefix_len;
+    int number = 0;
+    while (pos < len && name[pos] >= '0' && name[pos] <= '9' && number <= 255) {
+        number = number * 10 + (name[pos++] - '0');
+    }
+    if (*bank == NULL || pos == prefix_len || number < 1 || number > (*bank)->count) {
+        return false;
+    }
+
+    *index = number - 1;
+    *suffix = NULL;
+    *suffix_len = 0;
+    if (pos < len) {
+        if (name[pos] != '.') {
+            return false;
+        }
+        *suffix = &name[pos + 1];
+        *suffix_len = len - pos - 1;
+    }
+    return true;
+}
+
+static inline bool suffix_is(const char *suffix, size_t suffix_len, const char *expected)
+{
+    return suffix_len == strlen(expected) && strncasecmp(suffix, expected, suffix_len) == 0;
+}
+
+int logic_vm_reg_from_name(const char *name, size_t len)
+{
+    if (len == 4 && strncasecmp(name, "TRUE", 4) == 0) {
+        return LOGIC_REG_TRUE;
+    }
+    if (len == 5 && strncasecmp(name, "FALSE", 5) == 0) {
+        return LOGIC_REG_FALSE;
+    }
+
+    const reg_bank_t *bank;
+    int index;
+    const char *suffix;
+    size_t suffix_len;
+    if (!parse_name(name, len, &bank, &index, &suffix, &suffix_len)) {
+        return -1;
+    }
+
+    // Timer and counter outputs may be spelled T1.Q / C1.Q
+    bool block = bank->base == LOGIC_REG_TIMER || bank->base == LOGIC_REG_COUNTER;
+    if (suffix != NULL && !(block && suffix_is(suffix, suffix_len, "Q"))) {
+        return -1;
+    }
+    return bank->base + index;
+}
+
+int logic_vm_word_from_name(const char *name, size_t len)
+{
+    const reg_bank_t *bank;
+    int index;
+    const char *suffix;
+    size_t suffix_len;
+    if (!parse_name(name, len, &bank, &index, &suffix, &suffix_len) || suffix == NULL) {
+        return -1;
+    }
+
+    if (bank->base == LOGIC_REG_TIMER && suffix_is(suffix, suffix_len, "ET")) {
+        return LOGIC_WORD_TIMER + index;
+    }
+    if (bank->base == LOGIC_REG_COUNTER && suffix_is(suffix, suffix_len, "CV")) {
+        return LOGIC_WORD_COUNTER + index;
+    }
+    return -1;
+}
+
+const char *logic_vm_op_name(uint8_t op)
+{
+    return op < LOGIC_OP_COUNT ? op_names[op] : "unknown";
+}
+
+int logic_vm_op_from_name(const char *name)
+{
+    for (int i = 0; i < LOGIC_OP_COUNT; i++) {
+        if (strcasecmp(name, op_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
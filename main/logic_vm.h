@@ -0,0 +1,151 @@
+#ifndef LOGIC_VM_H
+#define LOGIC_VM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "auto_board.h"
+
+// PLC logic engine for CONTROL_MODE_CUSTOM. Uploaded rules are compiled
+// into register bytecode and stored in NVS. On install the bytecode is
+// optimised into a threaded table (logic_thread.h) that runs once per scan
+// without allocating; logic_vm_exec() remains the reference interpreter.
+
+#define LOGIC_NAMESPACE         "logic"
+#define LOGIC_PROGRAM_VERSION   1
+
+#define LOGIC_MAX_INSNS         1024
+#define LOGIC_MAX_TIMERS        16
+#define LOGIC_MAX_COUNTERS      16
+#define LOGIC_MAX_CONSTS        32
+#define LOGIC_MAX_MARKERS       64
+#define LOGIC_TIMER_MAX_MS      86400000    // One day
+
+// Bit register file: one byte per register, always 0 or 1
+#define LOGIC_REG_FALSE         0
+#define LOGIC_REG_TRUE          1
+#define LOGIC_REG_IN            16          // IN1.., loaded before every run, read-only
+#define LOGIC_REG_OUT           32          // OUT1..
+#define LOGIC_REG_TIMER         48          // T1.Q.., written by timer blocks only
+#define LOGIC_REG_COUNTER       64          // C1.Q.., written by counter blocks only
+#define LOGIC_REG_MARKER        80          // M1.., kept between scans
+#define LOGIC_REG_TEMP          (LOGIC_REG_MARKER + LOGIC_MAX_MARKERS)
+#define LOGIC_REG_COUNT         256
+
+// Word registers, read by the comparators
+#define LOGIC_WORD_TIMER        0           // T1.ET.. in ms
+#define LOGIC_WORD_COUNTER      LOGIC_MAX_TIMERS    // C1.CV..
+#define LOGIC_WORD_COUNT        (LOGIC_MAX_TIMERS + LOGIC_MAX_COUNTERS)
+
+_Static_assert(NUM_INPUTS <= LOGIC_REG_OUT - LOGIC_REG_IN, "inputs overflow their register range");
+_Static_assert(NUM_OUTPUTS <= LOGIC_REG_TIMER - LOGIC_REG_OUT, "outputs overflow their register range");
+
+// Opcodes; d is the destination unless noted
+typedef enum {
+    LOGIC_OP_MOV = 0,       // d = a
+    LOGIC_OP_NOT,           // d = !a
+    LOGIC_OP_AND,           // d = a & b
+    LOGIC_OP_ANDN,          // d = a & !b
+    LOGIC_OP_OR,            // d = a | b
+    LOGIC_OP_ORN,           // d = a | !b
+    LOGIC_OP_XOR,           // d = a ^ b
+    LOGIC_OP_SR,            // Set-dominant latch: d = a | (d & !b)
+    LOGIC_OP_RS,            // Reset-dominant latch: d = !b & (a | d)
+    LOGIC_OP_TON,           // Timer b, input a: Q after a has been on for the preset
+    LOGIC_OP_TOF,           // Timer b, input a: Q until a has been off for the preset
+    LOGIC_OP_TP,            // Timer b, input a: Q for the preset from a rising edge of a
+    LOGIC_OP_CTU,           // Counter b counts rising edges of a, d resets; Q = CV >= PV
+    LOGIC_OP_CTD,           // Counter b counts down on a, d loads PV; Q = CV <= 0
+    LOGIC_OP_GT,            // d = word a > const b
+    LOGIC_OP_GE,
+    LOGIC_OP_LT,
+    LOGIC_OP_LE,
+    LOGIC_OP_EQ,
+    LOGIC_OP_NE,
+    LOGIC_OP_COUNT
+} logic_op_t;
+
+typedef struct {
+    uint8_t op;
+    uint8_t d;
+    uint8_t a;
+    uint8_t b;
+} logic_insn_t;
+
+// A compiled program as stored in NVS; only code[0..count) is saved
+typedef struct {
+    uint16_t version;
+    uint16_t count;
+    uint32_t out_mask;                      // Outputs the program writes, filled in by verify
+    uint32_t timer_ms[LOGIC_MAX_TIMERS];
+    int32_t counter_pv[LOGIC_MAX_COUNTERS];
+    int32_t consts[LOGIC_MAX_CONSTS];
+    logic_insn_t code[LOGIC_MAX_INSNS];
+} logic_program_t;
+
+#define LOGIC_PROGRAM_HEADER_SIZE   offsetof(logic_program_t, code)
+
+// Interpreter state, one per running program
+typedef struct {
+    uint8_t reg[LOGIC_REG_COUNT];
+    int32_t word[LOGIC_WORD_COUNT];
+    int64_t timer_start_ms[LOGIC_MAX_TIMERS];
+    uint32_t timing;                        // Timers whose elapsed time is running
+    uint32_t timer_in;                      // Last input of each timer, for TP edges
+    uint32_t counter_in;                    // Last input of each counter, for edges
+    uint32_t timing_ended;                  // Timers that expired in the last scan
+    uint8_t result[LOGIC_MAX_INSNS];        // Threaded entries: last result of each
+    uint32_t pending[LOGIC_MAX_INSNS / 32]; // ...and the ones woken for the next scan
+    uint16_t evaluated;                     // Threaded entries run by the last scan
+} logic_vm_t;
+
+typedef struct {
+    bool loaded;
+    uint16_t insn_count;
+    uint32_t out_mask;
+    uint32_t timing;                        // Timers currently running
+    uint16_t thread_ops;                    // Threaded entries after optimisation
+    uint16_t folded;
+    uint16_t removed;
+    uint16_t fused;
+    uint32_t code_bytes;                    // Threaded table size
+    uint16_t evaluated;                     // Entries run by the last scan
+    uint32_t scans;
+    uint32_t last_us;                       // Execution time of the last scan
+    uint32_t avg_us;
+    uint32_t max_us;
+} logic_vm_status_t;
+
+// Function prototypes
+esp_err_t logic_vm_init(void);
+// Check every operand and fill in out_mask; programs from NVS or a compiler
+// must pass before they run
+esp_err_t logic_program_verify(logic_program_t *program);
+void logic_vm_reset(logic_vm_t *vm);
+// Run the program once; returns the output registers, bit n = output n
+uint32_t logic_vm_exec(logic_vm_t *vm, const logic_program_t *program, uint32_t inputs, int64_t now_ms);
+// One step of a timer (TON/TOF/TP) or counter (CTU/CTD) block
+void logic_vm_timer(logic_vm_t *vm, uint8_t op, uint8_t t, bool in, uint32_t preset_ms, int64_t now_ms);
+void logic_vm_counter(logic_vm_t *vm, uint8_t op, uint8_t c, bool in, bool reset, int32_t preset);
+// Verify, swap in and save a program; a program with no instructions
+// removes the stored one
+esp_err_t logic_vm_install(const logic_program_t *program);
+// Scan only: run the installed program; false when there is none
+bool logic_vm_scan(uint32_t inputs, uint32_t *bits, uint32_t *mask);
+// A timer the program compares is running and needs the periodic scan
+// tick; other timers wake the scan through the timer wheel when due
+bool logic_vm_needs_tick(void);
+void logic_vm_get_status(logic_vm_status_t *status);
+// Live values: Q and ET of a timer, Q and CV of a counter, a marker
+bool logic_vm_get_timer(uint8_t timer_num, int32_t *elapsed_ms);
+bool logic_vm_get_counter(uint8_t counter_num, int32_t *value);
+bool logic_vm_get_marker(uint8_t marker_num);
+// Operand names: IN1, OUT2, M3, T1 / T1.Q, C1 / C1.Q, TRUE, FALSE;
+// words T1.ET and C1.CV. Case-insensitive, -1 if unknown.
+int logic_vm_reg_from_name(const char *name, size_t len);
+int logic_vm_word_from_name(const char *name, size_t len);
+const char *logic_vm_op_name(uint8_t op);
+int logic_vm_op_from_name(const char *name);
+
+#endif // LOGIC_VM_H
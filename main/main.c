@@ -4,7 +4,6 @@
 #include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_system.h"
@@ -25,6 +24,19 @@
 #include "web_server.h"
 #include "wifi_config.h"
 #include "mdns.h"
+#include "input_debounce.h"
+#include "scan_cycle.h"
+#include "input_counter.h"
+#include "input_profile.h"
+#include "io_map.h"
+#include "output_image.h"
+#include "output_sched.h"
+#include "output_guard.h"
+#include "output_duty.h"
+#include "output_timer.h"
+#include "schedule.h"
+#include "retain.h"
+#include "logic_vm.h"
 
 static const char *TAG = "AUTO_BOARD";
 
@@ -37,9 +49,7 @@ const gpio_num_t output_gpios[] = {
     OUTPUT_1_GPIO, OUTPUT_2_GPIO, OUTPUT_3_GPIO, /* OUTPUT_4_GPIO, */ OUTPUT_5_GPIO
 };
 
-input_state_t input_states[NUM_INPUTS];
-bool output_states[NUM_OUTPUTS];
-QueueHandle_t input_event_queue;
+TaskHandle_t input_task_handle = NULL;
 
 static void wifi_reconnect_task(void *pvParameters)
 {
@@ -65,6 +75,11 @@ void app_main(void)
     ESP_LOGI(TAG, "5 Optocoupler Inputs (12V-24V) + 5 SSR Outputs (230V AC)");
     ESP_LOGI(TAG, "Web Interface with WiFi Configuration and Timer Control");
     
+    // Outputs come up first, before the slow WiFi bring-up: OFF, or their
+    // retained state after a software, watchdog or brownout reset
+    configure_gpio();
+    retain_init();
+    
     // Initialize WiFi configuration system
     ESP_LOGI(TAG, "Initializing WiFi configuration system...");
     wifi_config_init();
@@ -108,36 +123,53 @@ void app_main(void)
         }
     }
     
-    // Initialize GPIO
-    configure_gpio();
+    // Pulse inputs are handed to PCNT before the level inputs are debounced
+    input_counter_init();
     
-    // Create input event queue
-    input_event_queue = xQueueCreate(10, sizeof(input_event_t));
-    if (input_event_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create input event queue");
+    // Per-input polarity, debounce time and filter from NVS
+    input_profile_init();
+    
+    // Initialize input states; the debounce tick is armed on demand by input_task
+    if (input_debounce_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize input debounce");
         return;
     }
     
-    // Initialize input states
-    for (int i = 0; i < NUM_INPUTS; i++) {
-        input_states[i].current_state = gpio_get_level(input_gpios[i]);
-        input_states[i].last_state = input_states[i].current_state;
-        input_states[i].debounced_state = input_states[i].current_state;
-        input_states[i].last_change_time = esp_timer_get_time() / 1000;
+    output_sched_init();
+    // Minimum on/off times and interlocks sit between every command and output_sched
+    output_guard_init();
+    output_duty_init();
+    output_timer_init();
+    
+    // Manual control and timers that were running before the reset
+    retain_restore_overrides();
+    
+    // Weekly schedules; SNTP sets the clock once the station is connected
+    if (schedule_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Weekly schedules unavailable");
     }
     
-    // Initialize all outputs to OFF
-    for (int i = 0; i < NUM_OUTPUTS; i++) {
-        set_output(i, false);
+    // Input-output links for CONTROL_MODE_DIRECT, loaded from NVS
+    if (io_map_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Input-output mapping unavailable");
+    }
+    
+    // Compiled logic program for CONTROL_MODE_CUSTOM, loaded from NVS
+    if (logic_vm_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Logic engine unavailable");
     }
     
     // Create tasks
-    xTaskCreate(input_task, "input_task", 4096, NULL, 10, NULL);
-    xTaskCreate(output_control_task, "output_control_task", 4096, NULL, 8, NULL);
+    xTaskCreatePinnedToCore(input_task, "input_task", 4096, NULL, 10, &input_task_handle, HOTPATH_TASK_CORE);
     xTaskCreate(status_led_task, "status_led_task", 2048, NULL, 5, NULL);
-    xTaskCreate(timer_processing_task, "timer_processing_task", 4096, NULL, 7, NULL);
     xTaskCreate(web_server_monitor_task, "web_monitor_task", 4096, NULL, 6, NULL);
     
+    // Input-to-output logic and output timers run as phases of the fixed-rate scan
+    if (scan_cycle_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start scan cycle");
+        return;
+    }
+    
     ESP_LOGI(TAG, "All tasks created successfully");
     
     // Start web server (with delay to allow WiFi setup)
@@ -171,6 +203,7 @@ void app_main(void)
     // Main monitoring loop
     while (1) {
         print_status();
+        retain_journal_poll();
         vTaskDelay(pdMS_TO_TICKS(5000)); // Print status every 5 seconds
     }
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include <stdatomic.h>
+#include "output_arbiter.h"
+
+#define CLAIM_MASK      0xFFFFu
+#define BITS_SHIFT      16
+
+static const char *level_names[OUTPUT_ARBITER_LEVEL_COUNT + 1] = {
+    "safety", "manual", "schedule", "timer", "logic", "none"
+};
+
+// One word per level: claims in the low half, requested state in the high half
+static _Atomic uint32_t slots[OUTPUT_ARBITER_LEVEL_COUNT];
+
+// Written by the scan only, read for status
+static volatile uint8_t owner[NUM_OUTPUTS] = { [0 ... NUM_OUTPUTS - 1] = OUTPUT_ARBITER_NONE };
+
+static inline uint32_t pack(uint32_t claims, uint32_t bits)
+{
+    return (claims & CLAIM_MASK) | ((bits & claims & CLAIM_MASK) << BITS_SHIFT);
+}
+
+void output_arbiter_request(output_arbiter_level_t level, uint32_t mask, uint32_t bits)
+{
+    uint32_t old = atomic_load_explicit(&slots[level], memory_order_relaxed);
+    uint32_t new;
+
+    do {
+        uint32_t claims = (old & CLAIM_MASK) | mask;
+        uint32_t state = ((old >> BITS_SHIFT) & ~mask) | (bits & mask);
+        new = pack(claims, state);
+    } while (!atomic_compare_exchange_weak_explicit(&slots[level], &old, new,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+void output_arbiter_release(output_arbiter_level_t level, uint32_t mask)
+{
+    uint32_t clear = pack(mask, mask);
+    atomic_fetch_and_explicit(&slots[level], ~clear, memory_order_release);
+}
+
+void output_arbiter_set(output_arbiter_level_t level, uint32_t claims, uint32_t bits)
+{
+    atomic_store_explicit(&slots[level], pack(claims, bits), memory_order_release);
+}
+
+uint32_t output_arbiter_get_claims(output_arbiter_level_t level)
+{
+    return atomic_load_explicit(&slots[level], memory_order_acquire) & CLAIM_MASK;
+}
+
+uint32_t output_arbiter_resolve(void)
+{
+    uint32_t open = (1UL << NUM_OUTPUTS) - 1;
+    uint32_t result = 0;
+    uint32_t won[OUTPUT_ARBITER_LEVEL_COUNT];
+
+    // One pass from the top: each level takes the outputs still open
+    for (int level = 0; level < OUTPUT_ARBITER_LEVEL_COUNT; level++) {
+        uint32_t slot = atomic_load_explicit(&slots[level], memory_order_acquire);
+        won[level] = slot & CLAIM_MASK & open;
+        result |= (slot >> BITS_SHIFT) & won[level];
+        open &= ~won[level];
+    }
+
+    for (uint32_t bits = open; bits; bits &= bits - 1) {
+        owner[__builtin_ctz(bits)] = OUTPUT_ARBITER_NONE;
+    }
+    for (int level = 0; level < OUTPUT_ARBITER_LEVEL_COUNT; level++) {
+        for (uint32_t bits = won[level]; bits; bits &= bits - 1) {
+            owner[__builtin_ctz(bits)] = level;
+        }
+    }
+
+    // Unclaimed outputs are OFF
+    return result;
+}
+
+output_arbiter_level_t output_arbiter_get_owner(uint8_t output_num)
+{
+    return output_num < NUM_OUTPUTS ? owner[output_num] : OUTPUT_ARBITER_NONE;
+}
+
+const char *output_arbiter_level_name(uint8_t level)
+{
+    return level <= OUTPUT_ARBITER_NONE ? level_names[level] : "unknown";
+}
@@ -0,0 +1,40 @@
+#ifndef OUTPUT_ARBITER_H
+#define OUTPUT_ARBITER_H
+
+#include <stdint.h>
+#include "auto_board.h"
+
+// Output arbitration: every command source owns one slot and writes its
+// claim on outputs there; the scan resolves all slots once per pass and
+// the highest-priority claim on each output wins. Slots are single
+// 32-bit words updated with atomic operations, so neither the sources nor
+// the scan ever take a lock.
+
+// Priority levels, highest first
+typedef enum {
+    OUTPUT_ARBITER_SAFETY = 0,  // Protective overrides
+    OUTPUT_ARBITER_MANUAL,      // Web UI, expires after MANUAL_CONTROL_TIMEOUT_MS
+    OUTPUT_ARBITER_SCHEDULE,    // Weekly schedules
+    OUTPUT_ARBITER_TIMER,       // Pulse and cycle timers
+    OUTPUT_ARBITER_LOGIC,       // Input logic and duty modes
+    OUTPUT_ARBITER_LEVEL_COUNT,
+    OUTPUT_ARBITER_NONE = OUTPUT_ARBITER_LEVEL_COUNT
+} output_arbiter_level_t;
+
+_Static_assert(NUM_OUTPUTS <= 16, "an arbiter slot packs 16 claim and 16 state bits");
+
+// Function prototypes
+// Claim the outputs in 'mask' at 'level' with the matching state in 'bits'
+void output_arbiter_request(output_arbiter_level_t level, uint32_t mask, uint32_t bits);
+// Drop the claims in 'mask' at 'level'
+void output_arbiter_release(output_arbiter_level_t level, uint32_t mask);
+// Replace the whole slot, for sources that recompute every claim at once
+void output_arbiter_set(output_arbiter_level_t level, uint32_t claims, uint32_t bits);
+uint32_t output_arbiter_get_claims(output_arbiter_level_t level);
+// Scan only: winning state of every output; owner[] is refreshed for reporting
+uint32_t output_arbiter_resolve(void);
+// Level that won the output in the last resolve
+output_arbiter_level_t output_arbiter_get_owner(uint8_t output_num);
+const char *output_arbiter_level_name(uint8_t level);
+
+#endif // OUTPUT_ARBITER_H
@@ -0,0 +1,149 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "auto_board.h"
+#include "auto_board_config.h"
+#include "output_duty.h"
+#include "output_sched.h"
+#include "time_base.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "OUTPUT_DUTY";
+
+static const char *mode_names[OUTPUT_MODE_COUNT] = {
+    "onoff", "time_prop", "burst"
+};
+
+// One packed word per output (mode | cycle_s << 8 | duty << 16), so the web
+// handler can change a channel while the scan task reads it without a lock
+static atomic_uint_fast32_t channel_config[NUM_OUTPUTS];
+
+// Engine state, only touched by the scan task
+static int32_t burst_error[NUM_OUTPUTS];    // Delta-sigma accumulator, per mille of a half-cycle
+static bool burst_on[NUM_OUTPUTS];
+static uint32_t last_crossings = 0;
+static int64_t last_crossing_us = 0;
+
+static inline uint32_t pack_config(const output_duty_config_t *config)
+{
+    return (uint32_t)config->mode | ((uint32_t)config->cycle_s << 8) | ((uint32_t)config->duty_permille << 16);
+}
+
+static inline void unpack_config(uint32_t packed, output_duty_config_t *config)
+{
+    config->mode = packed & 0xFF;
+    config->cycle_s = (packed >> 8) & 0xFF;
+    config->duty_permille = (uint16_t)(packed >> 16);
+}
+
+void output_duty_init(void)
+{
+    output_duty_config_t config = {
+        .mode = OUTPUT_MODE_ONOFF,
+        .cycle_s = OUTPUT_DUTY_CYCLE_S,
+        .duty_permille = 0
+    };
+
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        atomic_store(&channel_config[i], pack_config(&config));
+        burst_error[i] = 0;
+        burst_on[i] = false;
+    }
+}
+
+esp_err_t output_duty_set(uint8_t output_num, const output_duty_config_t *config)
+{
+    if (output_num >= NUM_OUTPUTS || config->mode >= OUTPUT_MODE_COUNT ||
+        config->duty_permille > OUTPUT_DUTY_MAX ||
+        config->cycle_s < OUTPUT_CYCLE_MIN_S || config->cycle_s > OUTPUT_CYCLE_MAX_S) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (config->mode == OUTPUT_MODE_BURST && !ZERO_CROSS_ENABLE) {
+        ESP_LOGW(TAG, "Output %d: burst fire needs the zero-cross detector", output_num + 1);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    atomic_store(&channel_config[output_num], pack_config(config));
+
+    ESP_LOGI(TAG, "Output %d: %s, duty %u.%u%%, cycle %us",
+             output_num + 1, mode_names[config->mode],
+             config->duty_permille / 10, config->duty_permille % 10, config->cycle_s);
+    return ESP_OK;
+}
+
+void output_duty_get(uint8_t output_num, output_duty_config_t *config)
+{
+    if (output_num < NUM_OUTPUTS) {
+        unpack_config(atomic_load(&channel_config[output_num]), config);
+    }
+}
+
+uint32_t output_duty_step(uint32_t *duty_mask)
+{
+    uint32_t on_bits = 0;
+    uint32_t mask = 0;
+    int64_t now_us = time_base_now_us();
+
+    // Half-cycles since the last call; without crossings for
+    // ZERO_CROSS_TIMEOUT_MS burst outputs switch off
+    uint32_t crossings = output_sched_get_crossings();
+    int32_t half_cycles = (int32_t)(crossings - last_crossings);
+    last_crossings = crossings;
+    if (half_cycles > 0) {
+        last_crossing_us = now_us;
+    }
+    if (half_cycles > 2) {
+        half_cycles = 2;                // Idle without a tick; the error is clamped anyway
+    }
+    bool mains_ok = last_crossing_us != 0 && now_us - last_crossing_us <= ZERO_CROSS_TIMEOUT_MS * 1000LL;
+
+    // Every channel does the same work each scan whatever its mode, so the
+    // scan time does not depend on how many channels are modulating
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        output_duty_config_t config;
+        unpack_config(atomic_load_explicit(&channel_config[i], memory_order_relaxed), &config);
+
+        // Time-proportional: ON for the first duty share of each cycle
+        int64_t cycle_us = (int64_t)config.cycle_s * 1000000;
+        bool time_prop_on = now_us % cycle_us < cycle_us * config.duty_permille / OUTPUT_DUTY_MAX;
+
+        // Burst fire: each half-cycle that passed adds the duty and takes
+        // away what the output delivered, so ON half-cycles are spread
+        // evenly and the average matches the duty whatever the scan rate.
+        // The error stays within one half-cycle either side.
+        burst_error[i] += half_cycles * ((int32_t)config.duty_permille - (burst_on[i] ? OUTPUT_DUTY_MAX : 0));
+        if (burst_error[i] > OUTPUT_DUTY_MAX) {
+            burst_error[i] = OUTPUT_DUTY_MAX;       // Several half-cycles in one step
+        } else if (burst_error[i] < -OUTPUT_DUTY_MAX) {
+            burst_error[i] = -OUTPUT_DUTY_MAX;
+        }
+        burst_on[i] = mains_ok && burst_error[i] + (int32_t)config.duty_permille > OUTPUT_DUTY_MAX / 2;
+
+        bool on = (config.mode == OUTPUT_MODE_TIME_PROP) ? time_prop_on : burst_on[i];
+        uint32_t active = (config.mode != OUTPUT_MODE_ONOFF) ? 1UL : 0UL;
+        mask |= active << i;
+        on_bits |= (active & (on ? 1UL : 0UL)) << i;
+    }
+
+    *duty_mask = mask;
+    return on_bits;
+}
+
+const char *output_duty_mode_name(uint8_t mode)
+{
+    return mode < OUTPUT_MODE_COUNT ? mode_names[mode] : "unknown";
+}
+
+int output_duty_mode_from_name(const char *name)
+{
+    for (int i = 0; i < OUTPUT_MODE_COUNT; i++) {
+        if (strcmp(name, mode_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
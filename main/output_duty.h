@@ -0,0 +1,36 @@
+#ifndef OUTPUT_DUTY_H
+#define OUTPUT_DUTY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "auto_board.h"
+
+// Output drive modes
+typedef enum {
+    OUTPUT_MODE_ONOFF = 0,      // Follows the input logic
+    OUTPUT_MODE_TIME_PROP,      // ON for duty% of every cycle_s seconds
+    OUTPUT_MODE_BURST,          // Whole mains half-cycles spread evenly; needs ZERO_CROSS_ENABLE
+    OUTPUT_MODE_COUNT
+} output_mode_t;
+
+#define OUTPUT_DUTY_MAX         1000    // Duty is in per mille
+#define OUTPUT_CYCLE_MIN_S      1
+#define OUTPUT_CYCLE_MAX_S      60
+
+typedef struct {
+    uint8_t mode;               // output_mode_t
+    uint8_t cycle_s;            // Time-proportional cycle
+    uint16_t duty_permille;
+} output_duty_config_t;
+
+// Function prototypes
+void output_duty_init(void);
+esp_err_t output_duty_set(uint8_t output_num, const output_duty_config_t *config);
+void output_duty_get(uint8_t output_num, output_duty_config_t *config);
+// Called every scan: outputs in a duty mode and their state now. Time and
+// counted half-cycles drive the modulation, so extra scans change nothing.
+uint32_t output_duty_step(uint32_t *duty_mask);
+const char *output_duty_mode_name(uint8_t mode);
+int output_duty_mode_from_name(const char *name);
+
+#endif // OUTPUT_DUTY_H
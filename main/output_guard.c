@@ -0,0 +1,241 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "auto_board.h"
+#include "auto_board_config.h"
+#include "time_base.h"
+#include "output_image.h"
+#include "output_sched.h"
+#include "scan_cycle.h"
+#include "output_guard.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "OUTPUT_GUARD";
+
+static const char *reason_names[OUTPUT_GUARD_REASON_COUNT] = {
+    "none", "min_on", "min_off", "interlock"
+};
+
+static const uint32_t min_on_ms[NUM_OUTPUTS] = OUTPUT_MIN_ON_MS;
+static const uint32_t min_off_ms[NUM_OUTPUTS] = OUTPUT_MIN_OFF_MS;
+static uint32_t interlock_mask[NUM_OUTPUTS] = OUTPUT_INTERLOCK_MASKS;
+
+// Per-output state machine, packed as bit n = output n:
+//   applied   - state handed to output_sched
+//   requested - state the command sources want
+//   held      - requested != applied and a constraint is in the way
+// Owned by the scan task, so no lock; status readers on other tasks take
+// word-sized snapshots that may be one scan apart.
+static uint32_t applied = 0;
+static uint32_t requested = 0;
+static uint32_t held = 0;
+static int64_t last_change_us[NUM_OUTPUTS];
+static uint8_t held_reason[NUM_OUTPUTS];
+static uint32_t delayed_count[NUM_OUTPUTS][OUTPUT_GUARD_REASON_COUNT];
+
+static esp_timer_handle_t release_timer = NULL;
+
+static inline time_deadline_t hold_deadline(int i, output_guard_reason_t reason)
+{
+    switch (reason) {
+        case OUTPUT_GUARD_MIN_ON:
+            return last_change_us[i] + (int64_t)min_on_ms[i] * 1000;
+        case OUTPUT_GUARD_MIN_OFF:
+            return last_change_us[i] + (int64_t)min_off_ms[i] * 1000;
+        default:
+            return 0;
+    }
+}
+
+// Constant-time check of one transition against its constraints
+static output_guard_reason_t check(int i, bool on, int64_t now_us)
+{
+    if (on) {
+        if (now_us < hold_deadline(i, OUTPUT_GUARD_MIN_OFF)) {
+            return OUTPUT_GUARD_MIN_OFF;
+        }
+        if (applied & interlock_mask[i]) {
+            return OUTPUT_GUARD_INTERLOCK;
+        }
+    } else if (now_us < hold_deadline(i, OUTPUT_GUARD_MIN_ON)) {
+        return OUTPUT_GUARD_MIN_ON;
+    }
+    return OUTPUT_GUARD_NONE;
+}
+
+// Try to apply the requested state of 'candidates'; returns the outputs
+// that switched
+static uint32_t resolve(uint32_t candidates, int64_t now_us)
+{
+    uint32_t change = (requested ^ applied) & candidates;
+    uint32_t switched = 0;
+
+    // A request back to the applied state cancels its hold
+    held &= ~(candidates & ~change);
+
+    // OFF before ON, so an interlock released by this write is seen at once
+    uint32_t order[2] = { change & ~requested, change & requested };
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t bits = order[pass]; bits; bits &= bits - 1) {
+            int i = __builtin_ctz(bits);
+            uint32_t bit = 1UL << i;
+            output_guard_reason_t reason = check(i, pass == 1, now_us);
+
+            if (reason == OUTPUT_GUARD_NONE) {
+                applied ^= bit;
+                held &= ~bit;
+                last_change_us[i] = now_us;
+                switched |= bit;
+            } else {
+                // Count each held command once, not every rewrite of it
+                if (!(held & bit) || held_reason[i] != reason) {
+                    delayed_count[i][reason]++;
+                    ESP_LOGI(TAG, "Output %d %s held: %s", i + 1, pass ? "ON" : "OFF", reason_names[reason]);
+                }
+                held |= bit;
+                held_reason[i] = reason;
+            }
+        }
+    }
+    return switched;
+}
+
+// Arm release_timer for the earliest timed hold
+static void arm_release_timer(void)
+{
+    time_deadline_t next = INT64_MAX;
+
+    for (uint32_t bits = held; bits; bits &= bits - 1) {
+        int i = __builtin_ctz(bits);
+        time_deadline_t deadline = hold_deadline(i, held_reason[i]);
+        if (deadline != 0 && deadline < next) {
+            next = deadline;
+        }
+    }
+
+    esp_timer_stop(release_timer);
+    if (next != INT64_MAX) {
+        int64_t delay_us = time_deadline_remaining_us(next);
+        esp_timer_start_once(release_timer, delay_us > 0 ? delay_us : 1);
+    }
+}
+
+// Resolve and hand the switched outputs to output_sched
+static void apply(uint32_t candidates)
+{
+    int64_t now_us = time_base_now_us();
+    uint32_t switched = resolve(candidates, now_us);
+
+    // Outputs that just turned OFF may free interlocked ones
+    if ((switched & ~applied) && held) {
+        switched |= resolve(held, now_us);
+    }
+
+    if (switched) {
+        output_sched_write(switched, applied);
+    }
+    arm_release_timer();
+}
+
+// A timed hold ended: the scan applies it in output_guard_poll()
+static void release_timer_callback(void *arg)
+{
+    scan_cycle_notify(SCAN_EVENT_TIMER);
+}
+
+esp_err_t output_guard_init(void)
+{
+    esp_timer_create_args_t timer_args = {
+        .callback = release_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "output_guard"
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &release_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create guard timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Interlocks are mutual; an output never locks itself out
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        interlock_mask[i] &= ~(1UL << i) & ((1UL << NUM_OUTPUTS) - 1);
+        for (uint32_t bits = interlock_mask[i]; bits; bits &= bits - 1) {
+            interlock_mask[__builtin_ctz(bits)] |= 1UL << i;
+        }
+    }
+
+    // Outputs start from whatever retain_init() drove, and every timer
+    // starts at boot so a compressor also gets its minimum OFF time after
+    // a reset
+    applied = output_image_get();
+    requested = applied;
+    int64_t now_us = time_base_now_us();
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        last_change_us[i] = now_us;
+        if (min_on_ms[i] || min_off_ms[i] || interlock_mask[i]) {
+            ESP_LOGI(TAG, "Output %d: min on %lu ms, min off %lu ms, interlock 0x%02lx",
+                     i + 1, (unsigned long)min_on_ms[i], (unsigned long)min_off_ms[i],
+                     (unsigned long)interlock_mask[i]);
+        }
+    }
+    return ESP_OK;
+}
+
+void output_guard_write(uint32_t mask, uint32_t bits)
+{
+    if (release_timer == NULL) {
+        output_sched_write(mask, bits);
+        return;
+    }
+
+    requested = (requested & ~mask) | (bits & mask);
+    apply(mask);
+}
+
+void output_guard_poll(void)
+{
+    if (release_timer != NULL && held) {
+        apply(held);
+    }
+}
+
+uint32_t output_guard_get_requested(void)
+{
+    return requested;
+}
+
+uint32_t output_guard_get_held(void)
+{
+    return held;
+}
+
+void output_guard_get_info(uint8_t output_num, output_guard_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    if (output_num >= NUM_OUTPUTS) {
+        return;
+    }
+
+    info->min_on_ms = min_on_ms[output_num];
+    info->min_off_ms = min_off_ms[output_num];
+    info->interlock_mask = interlock_mask[output_num];
+
+    if (held & (1UL << output_num)) {
+        info->reason = held_reason[output_num];
+        info->wanted = (requested & (1UL << output_num)) != 0;
+        time_deadline_t deadline = hold_deadline(output_num, held_reason[output_num]);
+        info->wait_ms = deadline != 0 ? time_deadline_remaining_ms(deadline) : 0;
+    }
+    memcpy(info->delayed, delayed_count[output_num], sizeof(info->delayed));
+}
+
+const char *output_guard_reason_name(uint8_t reason)
+{
+    return reason < OUTPUT_GUARD_REASON_COUNT ? reason_names[reason] : "unknown";
+}
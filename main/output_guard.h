@@ -0,0 +1,45 @@
+#ifndef OUTPUT_GUARD_H
+#define OUTPUT_GUARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Output guard: every command source (scan logic, web, timers, schedules)
+// reaches output_sched through here, once per scan after arbitration. Each output enforces a minimum
+// ON time, a minimum OFF time and an interlock with other outputs; a
+// command that would break one is held and applied as soon as it can be.
+
+// Why a command is being held
+typedef enum {
+    OUTPUT_GUARD_NONE = 0,
+    OUTPUT_GUARD_MIN_ON,        // Still inside its minimum ON time
+    OUTPUT_GUARD_MIN_OFF,       // Still inside its minimum OFF time
+    OUTPUT_GUARD_INTERLOCK,     // An interlocked output is ON
+    OUTPUT_GUARD_REASON_COUNT
+} output_guard_reason_t;
+
+typedef struct {
+    uint8_t reason;             // output_guard_reason_t holding the command now
+    bool wanted;                // Held state, valid while reason != NONE
+    uint32_t wait_ms;           // Until a timed hold ends, 0 for interlock
+    uint32_t min_on_ms;
+    uint32_t min_off_ms;
+    uint32_t interlock_mask;    // Outputs that must be OFF before this one turns ON
+    uint32_t delayed[OUTPUT_GUARD_REASON_COUNT];   // Commands held, per reason
+} output_guard_info_t;
+
+// Function prototypes
+esp_err_t output_guard_init(void);
+// Scan only: request the outputs in 'mask' to follow 'bits'
+void output_guard_write(uint32_t mask, uint32_t bits);
+// Scan only: apply held commands whose hold has ended
+void output_guard_poll(void);
+// Latest requested state of every output, held or not
+uint32_t output_guard_get_requested(void);
+// Outputs with a held command
+uint32_t output_guard_get_held(void);
+void output_guard_get_info(uint8_t output_num, output_guard_info_t *info);
+const char *output_guard_reason_name(uint8_t reason);
+
+#endif // OUTPUT_GUARD_H
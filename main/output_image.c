@@ -0,0 +1,119 @@
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "auto_board.h"
+#include "output_image.h"
+#include "hotpath_audit.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "OUTPUT_IMAGE";
+
+// External variables (defined in main.c)
+extern const gpio_num_t output_gpios[];
+
+_Static_assert(NUM_OUTPUTS <= 32, "The output image packs at most 32 outputs per word");
+
+#ifdef OUTPUT_IMAGE_FAKE_REG
+volatile uint32_t output_image_fake_out = 0;
+output_image_fake_write_t output_image_fake_writes[OUTPUT_IMAGE_FAKE_WRITES];
+uint32_t output_image_fake_write_count = 0;
+
+void output_image_fake_write(bool set, uint32_t bits)
+{
+    if (output_image_fake_write_count < OUTPUT_IMAGE_FAKE_WRITES) {
+        output_image_fake_writes[output_image_fake_write_count] = (output_image_fake_write_t){ set, bits };
+    }
+    output_image_fake_write_count++;
+
+    if (set) {
+        output_image_fake_out |= bits;
+    } else {
+        output_image_fake_out &= ~bits;
+    }
+}
+#endif
+
+// GPIO.out bit of each logical output
+static DRAM_ATTR uint32_t output_gpio_bit[NUM_OUTPUTS];
+static uint32_t output_gpio_mask = 0;
+
+// Published image; readers never take the lock
+static atomic_uint_fast32_t output_bits = 0;
+
+// Serialises writers (scan task, web handlers, zero-cross ISR) so a read-modify-write of
+// the image is never interleaved with another one
+static portMUX_TYPE output_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Map a packed output image onto GPIO.out bits
+static uint32_t IRAM_ATTR image_to_gpio(uint32_t image)
+{
+    uint32_t gpio_bits = 0;
+
+    for (uint32_t bits = image; bits; bits &= bits - 1) {
+        gpio_bits |= output_gpio_bit[__builtin_ctz(bits)];
+    }
+    return gpio_bits;
+}
+
+void output_image_init(void)
+{
+    output_gpio_mask = 0;
+
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        // GPIO_OUT_W1TS/W1TC only cover GPIO0-31
+        if (output_gpios[i] >= 32) {
+            ESP_LOGE(TAG, "Output %d on GPIO %d is outside GPIO_OUT_REG", i + 1, output_gpios[i]);
+            output_gpio_bit[i] = 0;
+            continue;
+        }
+        output_gpio_bit[i] = 1UL << output_gpios[i];
+        output_gpio_mask |= output_gpio_bit[i];
+    }
+
+    // Every output starts off
+    OUTPUT_IMAGE_CLEAR_REG(output_gpio_mask);
+    atomic_store_explicit(&output_bits, 0, memory_order_release);
+
+    ESP_LOGI(TAG, "Output image mask: 0x%08lx", output_gpio_mask);
+}
+
+void IRAM_ATTR output_image_apply(uint32_t mask, uint32_t bits)
+{
+    HOTPATH_BEGIN(HOTPATH_OUTPUT_WRITE);
+
+    mask &= (NUM_OUTPUTS < 32) ? ((1UL << NUM_OUTPUTS) - 1) : UINT32_MAX;
+
+    portENTER_CRITICAL_SAFE(&output_lock);
+    uint32_t current = atomic_load_explicit(&output_bits, memory_order_relaxed);
+    uint32_t next = (current & ~mask) | (bits & mask);
+    uint32_t turn_on = next & ~current;
+    uint32_t turn_off = current & ~next;
+
+    // Break before make: outputs going off are released first, so
+    // interlocked pairs are never both driven, even for a few cycles
+    if (turn_off) {
+        OUTPUT_IMAGE_CLEAR_REG(image_to_gpio(turn_off));
+    }
+    if (turn_on) {
+        OUTPUT_IMAGE_SET_REG(image_to_gpio(turn_on));
+    }
+    atomic_store_explicit(&output_bits, next, memory_order_release);
+    portEXIT_CRITICAL_SAFE(&output_lock);
+
+    HOTPATH_END(HOTPATH_OUTPUT_WRITE);
+}
+
+uint32_t output_image_get(void)
+{
+    return atomic_load_explicit(&output_bits, memory_order_acquire);
+}
+
+bool output_image_get_state(uint8_t output_num)
+{
+    return output_num < NUM_OUTPUTS && (output_image_get() & (1UL << output_num)) != 0;
+}
@@ -0,0 +1,46 @@
+#ifndef OUTPUT_IMAGE_H
+#define OUTPUT_IMAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_attr.h"
+
+// Output image layer: the state of every output packed into one word
+// (bit n = output n) and applied with a single W1TC/W1TS register pair,
+// so outputs that change together switch in the same instant.
+//
+// Host builds define OUTPUT_IMAGE_FAKE_REG and inspect output_image_fake_out
+// instead of the hardware register, and output_image_fake_writes for the
+// order of the W1TC/W1TS writes that got it there.
+
+#ifdef OUTPUT_IMAGE_FAKE_REG
+#define OUTPUT_IMAGE_FAKE_WRITES        4
+
+typedef struct {
+    bool set;               // W1TS, otherwise W1TC
+    uint32_t bits;
+} output_image_fake_write_t;
+
+extern volatile uint32_t output_image_fake_out;
+// First writes since the test last zeroed the count; the count keeps going
+extern output_image_fake_write_t output_image_fake_writes[OUTPUT_IMAGE_FAKE_WRITES];
+extern uint32_t output_image_fake_write_count;
+void output_image_fake_write(bool set, uint32_t bits);
+#define OUTPUT_IMAGE_SET_REG(bits)      output_image_fake_write(true, (bits))
+#define OUTPUT_IMAGE_CLEAR_REG(bits)    output_image_fake_write(false, (bits))
+#else
+#include "soc/gpio_reg.h"
+#define OUTPUT_IMAGE_SET_REG(bits)      REG_WRITE(GPIO_OUT_W1TS_REG, (bits))
+#define OUTPUT_IMAGE_CLEAR_REG(bits)    REG_WRITE(GPIO_OUT_W1TC_REG, (bits))
+#endif
+
+// Function prototypes
+void output_image_init(void);
+// Set the outputs in 'mask' to the matching bits of 'bits'; others are kept.
+// Safe to call from an ISR.
+void IRAM_ATTR output_image_apply(uint32_t mask, uint32_t bits);
+// Current output image, bit n set = output n on
+uint32_t output_image_get(void);
+bool output_image_get_state(uint8_t output_num);
+
+#endif // OUTPUT_IMAGE_H
@@ -0,0 +1,285 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "driver/gptimer.h"
+#include "esp_log.h"
+#include "auto_board.h"
+#include "auto_board_config.h"
+#include "output_image.h"
+#include "output_sched.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "OUTPUT_SCHED";
+
+#if ZERO_CROSS_ENABLE
+
+#define ALL_OUTPUTS_MASK    ((1UL << NUM_OUTPUTS) - 1)
+
+// Free-running 1 MHz timer: every timestamp below is in its microseconds
+static gptimer_handle_t zc_timer = NULL;
+
+// Changes waiting for the next crossing, shared with both ISRs
+static portMUX_TYPE sched_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t pending_mask = 0;
+static uint32_t pending_bits = 0;
+static uint64_t pending_since_us = 0;
+static bool alarm_armed = false;
+
+static uint64_t last_crossing_us = 0;
+static uint64_t crossing_period_us = 0;
+
+static output_sched_stats_t sched_stats = {
+    .enabled = true,
+    .latency_min_us = UINT32_MAX
+};
+static uint64_t latency_total_us = 0;
+
+static inline uint64_t IRAM_ATTR timer_now_us(void)
+{
+    uint64_t count = 0;
+    gptimer_get_raw_count(zc_timer, &count);
+    return count;
+}
+
+static inline bool signal_present(uint64_t now_us)
+{
+    return last_crossing_us != 0 && now_us - last_crossing_us <= ZERO_CROSS_TIMEOUT_MS * 1000ULL;
+}
+
+// Apply everything queued at the crossing due at 'crossing_us', 0 when
+// there is none; called with sched_lock held
+static void IRAM_ATTR apply_pending(uint64_t now_us, uint64_t crossing_us)
+{
+    if (pending_mask == 0) {
+        return;
+    }
+
+    output_image_apply(pending_mask, pending_bits);
+
+    if (crossing_us != 0) {
+        // Late on any path, not just the alarm; fallbacks are counted apart
+        if (now_us - crossing_us > ZERO_CROSS_WINDOW_US) {
+            sched_stats.missed_windows++;
+        }
+
+        uint32_t latency_us = (uint32_t)(now_us - pending_since_us);
+        sched_stats.scheduled++;
+        latency_total_us += latency_us;
+        if (latency_us < sched_stats.latency_min_us) {
+            sched_stats.latency_min_us = latency_us;
+        }
+        if (latency_us > sched_stats.latency_max_us) {
+            sched_stats.latency_max_us = latency_us;
+        }
+    } else {
+        sched_stats.fallbacks++;
+    }
+
+    pending_mask = 0;
+    pending_since_us = 0;
+}
+
+static bool IRAM_ATTR zero_cross_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx)
+{
+    portENTER_CRITICAL_ISR(&sched_lock);
+    alarm_armed = false;
+    apply_pending(edata->count_value, edata->alarm_value);
+    portEXIT_CRITICAL_ISR(&sched_lock);
+
+    return false;
+}
+
+static void IRAM_ATTR zero_cross_isr(void *arg)
+{
+    uint64_t now_us = timer_now_us();
+
+    portENTER_CRITICAL_ISR(&sched_lock);
+    if (last_crossing_us != 0) {
+        crossing_period_us = now_us - last_crossing_us;
+    }
+    last_crossing_us = now_us;
+    sched_stats.zero_crossings++;
+
+    if (pending_mask != 0 && !alarm_armed) {
+#if ZERO_CROSS_DELAY_US > 0
+        // The detector edge leads the true crossing by a fixed delay
+        gptimer_alarm_config_t alarm_config = {
+            .alarm_count = now_us + ZERO_CROSS_DELAY_US,
+        };
+        gptimer_set_alarm_action(zc_timer, &alarm_config);
+        alarm_armed = true;
+#else
+        apply_pending(now_us, now_us);
+#endif
+    }
+    portEXIT_CRITICAL_ISR(&sched_lock);
+}
+
+esp_err_t output_sched_init(void)
+{
+    gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = 1000000,
+    };
+
+    esp_err_t ret = gptimer_new_timer(&timer_config, &zc_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create zero-cross timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    gptimer_event_callbacks_t callbacks = {
+        .on_alarm = zero_cross_alarm,
+    };
+    gptimer_register_event_callbacks(zc_timer, &callbacks, NULL);
+    gptimer_enable(zc_timer);
+    gptimer_start(zc_timer);
+
+    gpio_config_t zc_conf = {
+        .pin_bit_mask = (1ULL << ZERO_CROSS_GPIO),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_POSEDGE
+    };
+    gpio_config(&zc_conf);
+
+    // The ISR service is installed by configure_gpio
+    ret = gpio_isr_handler_add(ZERO_CROSS_GPIO, zero_cross_isr, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add zero-cross ISR: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Zero-cross scheduling on GPIO %d for outputs 0x%02x (%d us delay)",
+             ZERO_CROSS_GPIO, (unsigned)(ZERO_CROSS_OUTPUT_MASK & ALL_OUTPUTS_MASK), ZERO_CROSS_DELAY_US);
+    return ESP_OK;
+}
+
+void output_sched_write(uint32_t mask, uint32_t bits)
+{
+    uint32_t deferred = mask & ZERO_CROSS_OUTPUT_MASK & ALL_OUTPUTS_MASK;
+    uint32_t immediate = mask & ~deferred;
+
+    if (immediate) {
+        output_image_apply(immediate, bits);
+    }
+    if (deferred == 0) {
+        return;
+    }
+
+    uint64_t now_us = timer_now_us();
+
+    portENTER_CRITICAL(&sched_lock);
+    pending_bits = (pending_bits & ~deferred) | (bits & deferred);
+    pending_mask |= deferred;
+
+    // Drop outputs that are already in the requested state
+    pending_mask &= pending_bits ^ output_image_get();
+
+    if (pending_mask == 0) {
+        pending_since_us = 0;
+    } else if (!signal_present(now_us)) {
+        // No mains reference: switching late would gain nothing
+        apply_pending(now_us, 0);
+    } else if (pending_since_us == 0) {
+        pending_since_us = now_us;
+    }
+    portEXIT_CRITICAL(&sched_lock);
+}
+
+uint32_t output_sched_get_target(void)
+{
+    portENTER_CRITICAL(&sched_lock);
+    uint32_t target = (output_image_get() & ~pending_mask) | (pending_bits & pending_mask);
+    portEXIT_CRITICAL(&sched_lock);
+    return target;
+}
+
+void output_sched_poll(void)
+{
+    uint64_t now_us = timer_now_us();
+
+    uint32_t flushed = 0;
+
+    portENTER_CRITICAL(&sched_lock);
+    if (pending_mask != 0 && !alarm_armed && !signal_present(now_us)) {
+        flushed = pending_mask;
+        apply_pending(now_us, 0);
+    }
+    portEXIT_CRITICAL(&sched_lock);
+
+    if (flushed) {
+        ESP_LOGW(TAG, "Zero-cross signal lost, switched outputs 0x%02lx without it", (unsigned long)flushed);
+    }
+}
+
+bool output_sched_pending(void)
+{
+    return pending_mask != 0;
+}
+
+uint32_t output_sched_get_crossings(void)
+{
+    return sched_stats.zero_crossings;
+}
+
+void output_sched_get_stats(output_sched_stats_t *stats)
+{
+    uint64_t now_us = timer_now_us();
+
+    portENTER_CRITICAL(&sched_lock);
+    memcpy(stats, &sched_stats, sizeof(*stats));
+    stats->signal_ok = signal_present(now_us);
+    stats->crossing_rate_mhz = crossing_period_us ? (uint32_t)(1000000000ULL / crossing_period_us) : 0;
+    stats->latency_avg_us = stats->scheduled ? (uint32_t)(latency_total_us / stats->scheduled) : 0;
+    portEXIT_CRITICAL(&sched_lock);
+
+    if (stats->scheduled == 0) {
+        stats->latency_min_us = 0;
+    }
+}
+
+#else // !ZERO_CROSS_ENABLE
+
+esp_err_t output_sched_init(void)
+{
+    ESP_LOGI(TAG, "Zero-cross scheduling disabled, outputs switch immediately");
+    return ESP_OK;
+}
+
+void output_sched_write(uint32_t mask, uint32_t bits)
+{
+    output_image_apply(mask, bits);
+}
+
+uint32_t output_sched_get_target(void)
+{
+    return output_image_get();
+}
+
+void output_sched_poll(void)
+{
+}
+
+bool output_sched_pending(void)
+{
+    return false;
+}
+
+uint32_t output_sched_get_crossings(void)
+{
+    return 0;
+}
+
+void output_sched_get_stats(output_sched_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif // ZERO_CROSS_ENABLE
@@ -0,0 +1,40 @@
+#ifndef OUTPUT_SCHED_H
+#define OUTPUT_SCHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Output scheduler: changes to SSR outputs are queued and applied at the
+// next mains zero crossing, timed by a 1 MHz gptimer from the detector
+// edge. Outputs outside ZERO_CROSS_OUTPUT_MASK, and every output while no
+// zero-cross signal is present, are written straight away.
+
+typedef struct {
+    bool enabled;               // Built with ZERO_CROSS_ENABLE
+    bool signal_ok;             // Crossings seen within ZERO_CROSS_TIMEOUT_MS
+    uint32_t zero_crossings;    // Detector edges since boot
+    uint32_t crossing_rate_mhz; // Detector edge rate, in milli-Hertz
+    uint32_t scheduled;         // Queued changes applied at a crossing
+    uint32_t latency_min_us;    // Queue-to-switch delay of those changes
+    uint32_t latency_avg_us;
+    uint32_t latency_max_us;
+    uint32_t missed_windows;    // Applied later than ZERO_CROSS_WINDOW_US after the crossing
+    uint32_t fallbacks;         // Changes applied without a crossing (signal lost)
+} output_sched_stats_t;
+
+// Function prototypes
+esp_err_t output_sched_init(void);
+// Set the outputs in 'mask' to the matching bits of 'bits'
+void output_sched_write(uint32_t mask, uint32_t bits);
+// Output image once every queued change has been applied
+uint32_t output_sched_get_target(void);
+// Called every scan: flushes queued changes if the signal has gone away
+void output_sched_poll(void);
+// True while changes are waiting for a crossing
+bool output_sched_pending(void);
+// Detector edges since boot, one per mains half-cycle; 0 without ZERO_CROSS_ENABLE
+uint32_t output_sched_get_crossings(void);
+void output_sched_get_stats(output_sched_stats_t *stats);
+
+#endif // OUTPUT_SCHED_H
@@ -0,0 +1,351 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "auto_board.h"
+#include "time_base.h"
+#include "web_server.h"
+#include "scan_cycle.h"
+#include "timer_wheel.h"
+#include "output_arbiter.h"
+#include "output_timer.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "OUTPUT_TIMER";
+
+static const char *type_names[OUTPUT_TIMER_TYPE_COUNT] = {
+    "pulse", "on_delay", "off_delay", "cycle"
+};
+
+typedef struct {
+    bool in_use;
+    uint8_t type;
+    uint8_t output;
+    bool phase_on;              // Cycle: currently in the ON phase
+    uint16_t generation;
+    uint32_t on_ms;
+    uint32_t off_ms;
+    uint32_t phase_ms;          // Length of the running phase
+    int64_t phase_start_us;
+    timer_wheel_handle_t handle;
+} timer_slot_t;
+
+static timer_slot_t timers[OUTPUT_TIMER_MAX];
+static SemaphoreHandle_t timer_mutex = NULL;
+
+static void timer_fired(timer_wheel_handle_t handle, void *arg);
+
+static inline int make_id(int index)
+{
+    return (timers[index].generation << 8) | (index + 1);
+}
+
+static int id_to_index(int timer_id)
+{
+    int index = (timer_id & 0xFF) - 1;
+    if (timer_id <= 0 || index < 0 || index >= OUTPUT_TIMER_MAX ||
+        !timers[index].in_use || timers[index].generation != (uint16_t)(timer_id >> 8)) {
+        return -1;
+    }
+    return index;
+}
+
+// Pulses and cycles drive their output through the arbiter's TIMER slot
+static inline void claim_output(uint8_t output, bool state)
+{
+    uint32_t bit = 1UL << output;
+    output_arbiter_request(OUTPUT_ARBITER_TIMER, bit, state ? bit : 0);
+}
+
+// Hand back the TIMER claim of outputs no pulse or cycle owns any more;
+// called with timer_mutex held
+static void update_claims(void)
+{
+    uint32_t mask = 0;
+
+    for (int i = 0; i < OUTPUT_TIMER_MAX; i++) {
+        if (timers[i].in_use &&
+            (timers[i].type == OUTPUT_TIMER_PULSE || timers[i].type == OUTPUT_TIMER_CYCLE)) {
+            mask |= 1UL << timers[i].output;
+        }
+    }
+    output_arbiter_release(OUTPUT_ARBITER_TIMER, output_arbiter_get_claims(OUTPUT_ARBITER_TIMER) & ~mask);
+}
+
+// Start the next phase of a timer; called with timer_mutex held
+static bool arm_phase(int index, uint32_t phase_ms)
+{
+    timer_slot_t *t = &timers[index];
+
+    t->phase_ms = phase_ms;
+    t->phase_start_us = time_base_now_us();
+    t->handle = timer_wheel_add(phase_ms, timer_fired, (void *)(intptr_t)index);
+    return t->handle != 0;
+}
+
+static void release_timer(int index)
+{
+    timers[index].in_use = false;
+    timers[index].generation++;
+    timers[index].handle = 0;
+}
+
+static void timer_fired(timer_wheel_handle_t handle, void *arg)
+{
+    int index = (int)(intptr_t)arg;
+
+    xSemaphoreTake(timer_mutex, portMAX_DELAY);
+    timer_slot_t *t = &timers[index];
+
+    // A cancel that lost the race with the wheel leaves a stale callback
+    if (!t->in_use || t->handle != handle) {
+        xSemaphoreGive(timer_mutex);
+        return;
+    }
+
+    uint8_t output = t->output;
+    switch (t->type) {
+        case OUTPUT_TIMER_PULSE:
+            // Back to automatic control once the pulse ends
+            release_timer(index);
+            break;
+
+        case OUTPUT_TIMER_ON_DELAY:
+        case OUTPUT_TIMER_OFF_DELAY:
+            // A delayed command behaves like the same command from the web UI
+            web_set_output(output, t->type == OUTPUT_TIMER_ON_DELAY);
+            release_timer(index);
+            break;
+
+        case OUTPUT_TIMER_CYCLE:
+            t->phase_on = !t->phase_on;
+            claim_output(output, t->phase_on);
+            if (!arm_phase(index, t->phase_on ? t->on_ms : t->off_ms)) {
+                ESP_LOGE(TAG, "Output %d cycle stopped: timer pool full", output + 1);
+                release_timer(index);
+            }
+            break;
+    }
+
+    update_claims();
+    xSemaphoreGive(timer_mutex);
+
+    ESP_LOGD(TAG, "Output %d %s timer fired", output + 1, type_names[t->type]);
+    scan_cycle_notify(SCAN_EVENT_TIMER);
+}
+
+esp_err_t output_timer_init(void)
+{
+    timer_mutex = xSemaphoreCreateMutex();
+    if (timer_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create timer mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(timers, 0, sizeof(timers));
+    return timer_wheel_init();
+}
+
+int output_timer_start(uint8_t output_num, output_timer_type_t type, uint32_t on_ms, uint32_t off_ms)
+{
+    if (output_num >= NUM_OUTPUTS || type >= OUTPUT_TIMER_TYPE_COUNT ||
+        on_ms == 0 || on_ms > TIMER_WHEEL_MAX_MS ||
+        (type == OUTPUT_TIMER_CYCLE && (off_ms == 0 || off_ms > TIMER_WHEEL_MAX_MS))) {
+        return -1;
+    }
+
+    xSemaphoreTake(timer_mutex, portMAX_DELAY);
+
+    int index = -1;
+    for (int i = 0; i < OUTPUT_TIMER_MAX; i++) {
+        if (!timers[i].in_use) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0) {
+        xSemaphoreGive(timer_mutex);
+        ESP_LOGW(TAG, "No free output timer");
+        return -1;
+    }
+
+    timer_slot_t *t = &timers[index];
+    t->in_use = true;
+    t->type = type;
+    t->output = output_num;
+    t->on_ms = on_ms;
+    t->off_ms = off_ms;
+    t->phase_on = true;
+
+    if (!arm_phase(index, on_ms)) {
+        release_timer(index);
+        xSemaphoreGive(timer_mutex);
+        ESP_LOGW(TAG, "Timing wheel full");
+        return -1;
+    }
+
+    // Pulse and cycle switch on straight away
+    if (type == OUTPUT_TIMER_PULSE || type == OUTPUT_TIMER_CYCLE) {
+        claim_output(output_num, true);
+    }
+
+    int timer_id = make_id(index);
+    update_claims();
+    xSemaphoreGive(timer_mutex);
+
+    ESP_LOGI(TAG, "Output %d: %s timer %d started (%lu ms on, %lu ms off)",
+             output_num + 1, type_names[type], timer_id, (unsigned long)on_ms, (unsigned long)off_ms);
+    scan_cycle_notify(SCAN_EVENT_TIMER);
+    return timer_id;
+}
+
+esp_err_t output_timer_cancel(int timer_id)
+{
+    xSemaphoreTake(timer_mutex, portMAX_DELAY);
+    int index = id_to_index(timer_id);
+    if (index < 0) {
+        xSemaphoreGive(timer_mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    timer_wheel_cancel(timers[index].handle);
+    release_timer(index);
+    update_claims();
+    xSemaphoreGive(timer_mutex);
+
+    scan_cycle_notify(SCAN_EVENT_TIMER);
+    return ESP_OK;
+}
+
+void output_timer_cancel_output(uint8_t output_num)
+{
+    xSemaphoreTake(timer_mutex, portMAX_DELAY);
+    for (int i = 0; i < OUTPUT_TIMER_MAX; i++) {
+        if (timers[i].in_use && timers[i].output == output_num) {
+            timer_wheel_cancel(timers[i].handle);
+            release_timer(i);
+        }
+    }
+    update_claims();
+    xSemaphoreGive(timer_mutex);
+
+    scan_cycle_notify(SCAN_EVENT_TIMER);
+}
+
+void output_timer_get_info(uint8_t output_num, output_timer_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    int64_t now_us = time_base_now_us();
+
+    xSemaphoreTake(timer_mutex, portMAX_DELAY);
+    for (int i = 0; i < OUTPUT_TIMER_MAX; i++) {
+        timer_slot_t *t = &timers[i];
+        if (!t->in_use || t->output != output_num) {
+            continue;
+        }
+
+        int64_t elapsed_ms = (now_us - t->phase_start_us) / 1000;
+        uint32_t remaining_ms = elapsed_ms < t->phase_ms ? t->phase_ms - (uint32_t)elapsed_ms : 0;
+        if (info->count == 0 || remaining_ms < info->next_remaining_ms) {
+            info->next_remaining_ms = remaining_ms;
+            info->next_duration_ms = t->phase_ms;
+        }
+        info->count++;
+    }
+    xSemaphoreGive(timer_mutex);
+
+    info->holding = (output_arbiter_get_claims(OUTPUT_ARBITER_TIMER) & (1UL << output_num)) != 0;
+}
+
+int output_timer_snapshot(output_timer_snapshot_t *entries, int max_entries)
+{
+    int count = 0;
+    int64_t now_us = time_base_now_us();
+
+    xSemaphoreTake(timer_mutex, portMAX_DELAY);
+    for (int i = 0; i < OUTPUT_TIMER_MAX && count < max_entries; i++) {
+        timer_slot_t *t = &timers[i];
+        if (!t->in_use) {
+            continue;
+        }
+
+        int64_t elapsed_ms = (now_us - t->phase_start_us) / 1000;
+        entries[count++] = (output_timer_snapshot_t) {
+            .output = t->output,
+            .type = t->type,
+            .phase_on = t->phase_on,
+            .on_ms = t->on_ms,
+            .off_ms = t->off_ms,
+            .remaining_ms = elapsed_ms < t->phase_ms ? t->phase_ms - (uint32_t)elapsed_ms : 1
+        };
+    }
+    xSemaphoreGive(timer_mutex);
+
+    return count;
+}
+
+int output_timer_restore(const output_timer_snapshot_t *entry)
+{
+    if (entry->output >= NUM_OUTPUTS || entry->type >= OUTPUT_TIMER_TYPE_COUNT ||
+        entry->remaining_ms == 0 || entry->remaining_ms > TIMER_WHEEL_MAX_MS) {
+        return -1;
+    }
+
+    xSemaphoreTake(timer_mutex, portMAX_DELAY);
+
+    int index = -1;
+    for (int i = 0; i < OUTPUT_TIMER_MAX; i++) {
+        if (!timers[i].in_use) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index >= 0) {
+        timer_slot_t *t = &timers[index];
+        t->in_use = true;
+        t->type = entry->type;
+        t->output = entry->output;
+        t->on_ms = entry->on_ms;
+        t->off_ms = entry->off_ms;
+        t->phase_on = entry->phase_on;
+
+        if (!arm_phase(index, entry->remaining_ms)) {
+            release_timer(index);
+            index = -1;
+        } else if (t->type == OUTPUT_TIMER_PULSE || t->type == OUTPUT_TIMER_CYCLE) {
+            claim_output(t->output, t->type == OUTPUT_TIMER_PULSE || t->phase_on);
+        }
+    }
+
+    int timer_id = index >= 0 ? make_id(index) : -1;
+    update_claims();
+    xSemaphoreGive(timer_mutex);
+
+    if (timer_id > 0) {
+        ESP_LOGI(TAG, "Output %d: %s timer %d restored (%lu ms left)",
+                 entry->output + 1, type_names[entry->type], timer_id, (unsigned long)entry->remaining_ms);
+        scan_cycle_notify(SCAN_EVENT_TIMER);
+    }
+    return timer_id;
+}
+
+const char *output_timer_type_name(uint8_t type)
+{
+    return type < OUTPUT_TIMER_TYPE_COUNT ? type_names[type] : "unknown";
+}
+
+int output_timer_type_from_name(const char *name)
+{
+    for (int i = 0; i < OUTPUT_TIMER_TYPE_COUNT; i++) {
+        if (strcmp(name, type_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
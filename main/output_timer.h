@@ -0,0 +1,51 @@
+#ifndef OUTPUT_TIMER_H
+#define OUTPUT_TIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Output timers on top of the timing wheel; several may run per output
+typedef enum {
+    OUTPUT_TIMER_PULSE = 0,     // ON now, OFF after on_ms
+    OUTPUT_TIMER_ON_DELAY,      // ON after on_ms
+    OUTPUT_TIMER_OFF_DELAY,     // OFF after on_ms
+    OUTPUT_TIMER_CYCLE,         // ON for on_ms, OFF for off_ms, repeated until cancelled
+    OUTPUT_TIMER_TYPE_COUNT
+} output_timer_type_t;
+
+#define OUTPUT_TIMER_MAX        16
+
+typedef struct {
+    uint8_t count;              // Timers running on this output
+    bool holding;               // A pulse or cycle owns the output
+    uint32_t next_remaining_ms; // Until the next timer action on this output
+    uint32_t next_duration_ms;  // Full length of that timer phase
+} output_timer_info_t;
+
+// One running timer as captured for retention across a reset
+typedef struct {
+    uint8_t output;
+    uint8_t type;
+    uint8_t phase_on;           // Cycle: in the ON phase
+    uint8_t reserved;
+    uint32_t on_ms;
+    uint32_t off_ms;
+    uint32_t remaining_ms;      // Left in the running phase
+} output_timer_snapshot_t;
+
+// Function prototypes
+esp_err_t output_timer_init(void);
+// Returns a timer id (> 0), or a negative value on error
+int output_timer_start(uint8_t output_num, output_timer_type_t type, uint32_t on_ms, uint32_t off_ms);
+esp_err_t output_timer_cancel(int timer_id);
+void output_timer_cancel_output(uint8_t output_num);
+void output_timer_get_info(uint8_t output_num, output_timer_info_t *info);
+// Copy every running timer; returns the number of entries written
+int output_timer_snapshot(output_timer_snapshot_t *entries, int max_entries);
+// Re-arm a captured timer with entry->remaining_ms left in its phase
+int output_timer_restore(const output_timer_snapshot_t *entry);
+const char *output_timer_type_name(uint8_t type);
+int output_timer_type_from_name(const char *name);
+
+#endif // OUTPUT_TIMER_H
@@ -0,0 +1,429 @@
+#include <string.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "auto_board.h"
+#include "auto_board_config.h"
+#include "time_base.h"
+#include "output_image.h"
+#include "output_timer.h"
+#include "web_server.h"
+#include "scan_cycle.h"
+#include "retain.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "RETAIN";
+
+#define RETAIN_MAGIC        0x52544E31      // "RTN1"
+#define CLOCK_VALID_US      (1704067200LL * 1000000)   // 2024-01-01
+#define ALL_OUTPUTS_MASK    ((1UL << NUM_OUTPUTS) - 1)
+
+static const char *policy_names[RETAIN_POLICY_COUNT] = { "off", "last" };
+static const char *source_names[] = { "none", "rtc", "nvs" };
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    int64_t saved_at_us;        // Wall clock, keeps running across soft resets
+    uint32_t last_mask;         // RETAIN_POLICY_LAST outputs, so RTC restore needs no NVS
+    uint32_t outputs;
+    uint32_t manual_mask;
+    uint32_t manual_remaining_ms[NUM_OUTPUTS];
+    uint32_t timer_count;
+    output_timer_snapshot_t timers[OUTPUT_TIMER_MAX];
+    uint32_t crc;               // Over everything above
+} retain_record_t;
+
+// Two copies written alternately, so a reset in the middle of a write
+// still leaves the previous snapshot intact
+static RTC_NOINIT_ATTR retain_record_t rtc_records[2];
+
+static retain_record_t working;             // Latest snapshot, built by the scan task
+static retain_record_t restored;            // What retain_init found, for the overrides
+static portMUX_TYPE record_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t last_mask = RETAIN_LAST_MASK & ALL_OUTPUTS_MASK;
+static bool policy_loaded = false;
+static bool journal_dirty = false;
+static int64_t last_journal_us = 0;
+static retain_stats_t retain_stats;
+
+static int64_t wall_clock_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static uint32_t record_crc(const retain_record_t *record)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)record, offsetof(retain_record_t, crc));
+}
+
+static bool record_valid(const retain_record_t *record)
+{
+    return record->magic == RETAIN_MAGIC &&
+           record->timer_count <= OUTPUT_TIMER_MAX &&
+           record->crc == record_crc(record);
+}
+
+// Newer of two records by sequence number, either may be NULL
+static const retain_record_t *newer(const retain_record_t *a, const retain_record_t *b)
+{
+    if (a == NULL) {
+        return b;
+    }
+    if (b == NULL) {
+        return a;
+    }
+    return (int32_t)(b->seq - a->seq) > 0 ? b : a;
+}
+
+static const retain_record_t *load_rtc(void)
+{
+    // RTC memory holds garbage after power-on
+    if (esp_reset_reason() == ESP_RST_POWERON) {
+        return NULL;
+    }
+
+    const retain_record_t *best = NULL;
+    for (int i = 0; i < 2; i++) {
+        if (record_valid(&rtc_records[i])) {
+            best = newer(best, &rtc_records[i]);
+        }
+    }
+    return best;
+}
+
+static void load_policy(nvs_handle_t nvs_handle)
+{
+    uint32_t stored_mask;
+    if (nvs_get_u32(nvs_handle, "policy", &stored_mask) == ESP_OK) {
+        last_mask = stored_mask & ALL_OUTPUTS_MASK;
+    }
+}
+
+static const retain_record_t *load_journal(nvs_handle_t nvs_handle, retain_record_t *slots)
+{
+    const retain_record_t *best = NULL;
+
+    for (int i = 0; i < RETAIN_JOURNAL_SLOTS; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "j%d", i);
+        size_t len = sizeof(retain_record_t);
+        if (nvs_get_blob(nvs_handle, key, &slots[i], &len) == ESP_OK &&
+            len == sizeof(retain_record_t) && record_valid(&slots[i])) {
+            best = newer(best, &slots[i]);
+        }
+    }
+    return best;
+}
+
+// Wind the record forward by the time spent in reset: timers that ran out
+// take the action they would have taken, cycles continue in phase
+static void advance_record(retain_record_t *record, uint32_t elapsed_ms)
+{
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        if (record->manual_mask & (1UL << i)) {
+            if (record->manual_remaining_ms[i] > elapsed_ms) {
+                record->manual_remaining_ms[i] -= elapsed_ms;
+            } else {
+                record->manual_mask &= ~(1UL << i);
+                record->manual_remaining_ms[i] = 0;
+            }
+        }
+    }
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < record->timer_count; i++) {
+        output_timer_snapshot_t t = record->timers[i];
+        uint32_t bit = 1UL << t.output;
+
+        if (t.remaining_ms > elapsed_ms) {
+            t.remaining_ms -= elapsed_ms;
+            record->timers[kept++] = t;
+            continue;
+        }
+
+        uint32_t over_ms = elapsed_ms - t.remaining_ms;
+        switch (t.type) {
+            case OUTPUT_TIMER_PULSE:
+                record->outputs &= ~bit;
+                break;
+
+            case OUTPUT_TIMER_ON_DELAY:
+            case OUTPUT_TIMER_OFF_DELAY:
+                // The delayed command put the output under manual control
+                if (t.type == OUTPUT_TIMER_ON_DELAY) {
+                    record->outputs |= bit;
+                } else {
+                    record->outputs &= ~bit;
+                }
+                if (over_ms < MANUAL_CONTROL_TIMEOUT_MS) {
+                    record->manual_mask |= bit;
+                    record->manual_remaining_ms[t.output] = MANUAL_CONTROL_TIMEOUT_MS - over_ms;
+                }
+                break;
+
+            case OUTPUT_TIMER_CYCLE: {
+                // Step whole periods at once, then at most two phases
+                uint32_t period_ms = t.on_ms + t.off_ms;
+                over_ms %= period_ms;
+                t.phase_on = !t.phase_on;
+                uint32_t phase_ms = t.phase_on ? t.on_ms : t.off_ms;
+                if (over_ms >= phase_ms) {
+                    over_ms -= phase_ms;
+                    t.phase_on = !t.phase_on;
+                    phase_ms = t.phase_on ? t.on_ms : t.off_ms;
+                }
+                t.remaining_ms = phase_ms - over_ms;
+                record->timers[kept++] = t;
+                if (t.phase_on) {
+                    record->outputs |= bit;
+                } else {
+                    record->outputs &= ~bit;
+                }
+                break;
+            }
+        }
+    }
+    record->timer_count = kept;
+}
+
+// Keep only what belongs to RETAIN_POLICY_LAST outputs
+static void filter_record(retain_record_t *record, uint32_t mask)
+{
+    record->outputs &= mask;
+    record->manual_mask &= mask;
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < record->timer_count; i++) {
+        if (mask & (1UL << record->timers[i].output)) {
+            record->timers[kept++] = record->timers[i];
+        }
+    }
+    record->timer_count = kept;
+}
+
+esp_err_t retain_init(void)
+{
+    int64_t start = time_base_now_us();
+    const retain_record_t *found = load_rtc();
+    retain_source_t source = RETAIN_SOURCE_NONE;
+
+    if (found != NULL) {
+        // Fast path: the record carries its own policy, NVS is not touched
+        source = RETAIN_SOURCE_RTC;
+        last_mask = found->last_mask & ALL_OUTPUTS_MASK;
+    } else {
+        // After power loss: policy and journal from NVS
+        static retain_record_t slots[RETAIN_JOURNAL_SLOTS];
+        nvs_handle_t nvs_handle;
+        if (nvs_flash_init() == ESP_OK && nvs_open(RETAIN_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+            load_policy(nvs_handle);
+            found = load_journal(nvs_handle, slots);
+            source = found ? RETAIN_SOURCE_NVS : RETAIN_SOURCE_NONE;
+            nvs_close(nvs_handle);
+        }
+        policy_loaded = true;
+    }
+
+    memset(&restored, 0, sizeof(restored));
+    if (found != NULL) {
+        restored = *found;
+        working.seq = found->seq;
+
+        // The RTC clock runs on through a soft reset; after power loss it
+        // only helps once both ends are real wall-clock times
+        int64_t now_us = wall_clock_us();
+        int64_t elapsed_us = now_us - restored.saved_at_us;
+        bool clock_ok = source == RETAIN_SOURCE_RTC ||
+                        (now_us >= CLOCK_VALID_US && restored.saved_at_us >= CLOCK_VALID_US);
+        if (clock_ok && elapsed_us > 0) {
+            retain_stats.downtime_ms = elapsed_us / 1000 > UINT32_MAX ? UINT32_MAX : (uint32_t)(elapsed_us / 1000);
+        }
+
+        advance_record(&restored, retain_stats.downtime_ms);
+        filter_record(&restored, last_mask);
+    }
+
+    output_image_apply(UINT32_MAX, restored.outputs);
+
+    retain_stats.source = source;
+    retain_stats.restored_outputs = restored.outputs;
+    retain_stats.restored_manual = restored.manual_mask;
+    retain_stats.restored_timers = restored.timer_count;
+    retain_stats.restore_us = (uint32_t)(time_base_now_us() - start);
+
+    if (source != RETAIN_SOURCE_NONE) {
+        ESP_LOGI(TAG, "Restored from %s in %lu us: outputs 0x%02lx, manual 0x%02lx, %lu timers (%lu ms in reset)",
+                 source_names[source], retain_stats.restore_us, restored.outputs,
+                 restored.manual_mask, restored.timer_count, retain_stats.downtime_ms);
+    } else {
+        ESP_LOGI(TAG, "No retained state, outputs start OFF");
+    }
+    return ESP_OK;
+}
+
+void retain_restore_overrides(void)
+{
+    // NVS is up by now; a policy edited since the RTC snapshot wins from here on
+    nvs_handle_t nvs_handle;
+    if (!policy_loaded && nvs_open(RETAIN_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        load_policy(nvs_handle);
+        nvs_close(nvs_handle);
+    }
+    policy_loaded = true;
+
+    for (uint32_t bits = restored.manual_mask; bits; bits &= bits - 1) {
+        int i = __builtin_ctz(bits);
+        web_restore_manual_control(i, (restored.outputs & (1UL << i)) != 0, restored.manual_remaining_ms[i]);
+    }
+
+    for (uint32_t i = 0; i < restored.timer_count; i++) {
+        if (output_timer_restore(&restored.timers[i]) < 0) {
+            ESP_LOGW(TAG, "Output %d timer could not be restored", restored.timers[i].output + 1);
+        }
+    }
+}
+
+void retain_capture(bool force)
+{
+    uint32_t outputs = output_image_get();
+    if (!force && outputs == working.outputs) {
+        return;
+    }
+
+    retain_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.magic = RETAIN_MAGIC;
+    record.seq = working.seq + 1;
+    record.saved_at_us = wall_clock_us();
+    record.last_mask = last_mask;
+    record.outputs = outputs;
+
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        record.manual_remaining_ms[i] = web_get_manual_remaining_ms(i);
+        if (record.manual_remaining_ms[i] > 0) {
+            record.manual_mask |= 1UL << i;
+        }
+    }
+    record.timer_count = output_timer_snapshot(record.timers, OUTPUT_TIMER_MAX);
+    record.crc = record_crc(&record);
+
+    // Plain memory writes, cheap enough for every change
+    rtc_records[record.seq & 1] = record;
+
+    portENTER_CRITICAL(&record_lock);
+    working = record;
+    journal_dirty = last_mask != 0;
+    portEXIT_CRITICAL(&record_lock);
+
+    retain_stats.captures++;
+}
+
+void retain_journal_poll(void)
+{
+    int64_t now = time_base_now_us();
+    if (!journal_dirty || (last_journal_us != 0 && now - last_journal_us < RETAIN_JOURNAL_INTERVAL_MS * 1000LL)) {
+        return;
+    }
+
+    static retain_record_t record;
+    portENTER_CRITICAL(&record_lock);
+    record = working;
+    journal_dirty = false;
+    portEXIT_CRITICAL(&record_lock);
+
+    // Rotating keys keep the previous record if this write is cut short
+    char key[8];
+    snprintf(key, sizeof(key), "j%lu", (unsigned long)(record.seq % RETAIN_JOURNAL_SLOTS));
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(RETAIN_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs_handle, key, &record, sizeof(record));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+
+    last_journal_us = now;
+    if (err == ESP_OK) {
+        retain_stats.journal_writes++;
+    } else {
+        retain_stats.journal_errors++;
+        ESP_LOGW(TAG, "Journal write failed: %s", esp_err_to_name(err));
+    }
+}
+
+esp_err_t retain_set_policy(uint8_t output_num, retain_policy_t policy)
+{
+    if (output_num >= NUM_OUTPUTS || policy >= RETAIN_POLICY_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (policy == RETAIN_POLICY_LAST) {
+        last_mask |= 1UL << output_num;
+    } else {
+        last_mask &= ~(1UL << output_num);
+    }
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(RETAIN_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err == ESP_OK) {
+        err = nvs_set_u32(nvs_handle, "policy", last_mask);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+
+    ESP_LOGI(TAG, "Output %d retention: %s", output_num + 1, policy_names[policy]);
+    // The next scan snapshots the new policy into RTC memory
+    scan_cycle_notify(SCAN_EVENT_COMMAND);
+    return err;
+}
+
+retain_policy_t retain_get_policy(uint8_t output_num)
+{
+    return (last_mask & (1UL << output_num)) ? RETAIN_POLICY_LAST : RETAIN_POLICY_OFF;
+}
+
+void retain_get_stats(retain_stats_t *stats)
+{
+    memcpy(stats, &retain_stats, sizeof(*stats));
+}
+
+const char *retain_policy_name(uint8_t policy)
+{
+    return policy < RETAIN_POLICY_COUNT ? policy_names[policy] : "unknown";
+}
+
+int retain_policy_from_name(const char *name)
+{
+    for (int i = 0; i < RETAIN_POLICY_COUNT; i++) {
+        if (strcmp(name, policy_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *retain_source_name(retain_source_t source)
+{
+    return source <= RETAIN_SOURCE_NVS ? source_names[source] : "unknown";
+}
@@ -0,0 +1,56 @@
+#ifndef RETAIN_H
+#define RETAIN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Output retention across resets. The output image, manual overrides and
+// running timers are mirrored into RTC slow memory on every change, which
+// survives software, watchdog and most brownout resets, and journalled to
+// NVS at most every RETAIN_JOURNAL_INTERVAL_MS for power loss.
+
+#define RETAIN_NAMESPACE        "retain"
+#define RETAIN_JOURNAL_SLOTS    4       // NVS keys written in rotation
+
+typedef enum {
+    RETAIN_POLICY_OFF = 0,      // Start OFF (default)
+    RETAIN_POLICY_LAST,         // Restore state, manual control and timers
+    RETAIN_POLICY_COUNT
+} retain_policy_t;
+
+typedef enum {
+    RETAIN_SOURCE_NONE = 0,     // Nothing restored, cold start
+    RETAIN_SOURCE_RTC,
+    RETAIN_SOURCE_NVS
+} retain_source_t;
+
+typedef struct {
+    retain_source_t source;
+    uint32_t restored_outputs;  // Outputs brought back ON
+    uint32_t restored_manual;   // Outputs put back under manual control
+    uint8_t restored_timers;
+    uint32_t downtime_ms;       // Time spent in reset, when the clock knew it
+    uint32_t restore_us;        // retain_init() duration
+    uint32_t captures;          // RTC snapshots taken
+    uint32_t journal_writes;
+    uint32_t journal_errors;
+} retain_stats_t;
+
+// Function prototypes
+// Early boot, right after configure_gpio: drive the restored output image
+esp_err_t retain_init(void);
+// After output_timer_init: re-arm restored manual control and timers
+void retain_restore_overrides(void);
+// Scan task: snapshot into RTC memory when the image changed or 'force'
+void retain_capture(bool force);
+// Low-priority loop: write the NVS journal when due
+void retain_journal_poll(void);
+esp_err_t retain_set_policy(uint8_t output_num, retain_policy_t policy);
+retain_policy_t retain_get_policy(uint8_t output_num);
+void retain_get_stats(retain_stats_t *stats);
+const char *retain_policy_name(uint8_t policy);
+int retain_policy_from_name(const char *name);
+const char *retain_source_name(retain_source_t source);
+
+#endif // RETAIN_H
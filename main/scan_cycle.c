@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "auto_board.h"
+#include "auto_board_config.h"
+#include "time_base.h"
+#include "input_debounce.h"
+#include "input_counter.h"
+#include "scan_cycle.h"
+#include "hotpath_audit.h"
+#include "output_image.h"
+#include "output_sched.h"
+#include "output_duty.h"
+#include "output_guard.h"
+#include "output_arbiter.h"
+#include "logic_vm.h"
+#include "io_map.h"
+#include "retain.h"
+#include "web_server.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "SCAN_CYCLE";
+
+#define ALL_OUTPUTS_MASK    ((1UL << NUM_OUTPUTS) - 1)
+
+// Process image latched at the start of every scan
+typedef struct {
+    uint32_t inputs;        // Active inputs (polarity applied), bit n = input n
+    uint32_t outputs;       // Resolved outputs, bit n = output n
+    uint32_t duty_mask;     // Outputs driven by the duty engine
+} scan_image_t;
+
+static TaskHandle_t scan_task_handle = NULL;
+static esp_timer_handle_t scan_timer = NULL;
+static bool tick_running = false;
+static int64_t last_tick_us = 0;
+
+static scan_stats_t scan_stats = {
+    .min_us = UINT32_MAX,
+    .period_us = SCAN_PERIOD_MS * 1000
+};
+static uint64_t scan_total_us = 0;
+
+static void scan_timer_callback(void *arg)
+{
+    scan_cycle_notify(SCAN_EVENT_TICK);
+}
+
+static void scan_read_inputs(scan_image_t *image)
+{
+    input_counter_update(time_base_now_us());
+
+    // Counter inputs are active while their rate is at or above threshold,
+    // so the logic treats both kinds of input the same way
+    uint32_t counter_mask = input_counter_get_mask();
+
+    image->inputs = (input_debounce_get_state() & ~counter_mask) | (input_counter_get_rate_bits() & counter_mask);
+}
+
+static void scan_evaluate_logic(scan_image_t *image)
+{
+    // Direct mode: the input-output mapping table; polarity is already
+    // applied per input profile
+    uint32_t logic = CONTROL_MODE_DIRECT ? io_map_step(image->inputs) : 0;
+
+#if CONTROL_MODE_CUSTOM
+    // The uploaded logic program drives the outputs it writes
+    uint32_t program_bits, program_mask;
+    if (logic_vm_scan(image->inputs, &program_bits, &program_mask)) {
+        logic = (logic & ~program_mask) | (program_bits & program_mask);
+    }
+#endif
+
+    // Time-proportional and burst-fire outputs follow the duty engine instead.
+    // It runs on time and counted half-cycles, so input, command and timer
+    // scans in between read the same state and do not advance it.
+    uint32_t duty_bits = output_duty_step(&image->duty_mask);
+    logic = (logic & ~image->duty_mask) | (duty_bits & image->duty_mask);
+
+    // The logic is the lowest priority source and claims every output;
+    // safety, manual control, schedules and timers win where they claim.
+    // Resolving once here gives every source one consistent view per scan.
+    output_arbiter_set(OUTPUT_ARBITER_LOGIC, ALL_OUTPUTS_MASK, logic);
+    image->outputs = output_arbiter_resolve();
+}
+
+static void scan_write_outputs(const scan_image_t *image)
+{
+    // Changes held by the output guard or waiting for a zero crossing
+    // count as done; holds that ended are applied here
+    output_sched_poll();
+    output_guard_poll();
+    uint32_t changed = output_guard_get_requested() ^ image->outputs;
+    if (changed == 0) {
+        return;
+    }
+
+    // Every output that changed switches in the same register write
+    output_guard_write(ALL_OUTPUTS_MASK, image->outputs);
+
+    for (uint32_t bits = changed; bits; bits &= bits - 1) {
+        int i = __builtin_ctz(bits);
+        ESP_LOGI(TAG, "Output %d set to %s by %s",
+                i + 1,
+                (image->outputs & (1UL << i)) ? "ON" : "OFF",
+                output_arbiter_level_name(output_arbiter_get_owner(i)));
+    }
+}
+
+// Run the periodic tick only while something needs sampling in time:
+// counter inputs, duty-cycled outputs, changes waiting for a crossing or
+// running logic timers
+static void scan_update_tick(const scan_image_t *image)
+{
+    bool need_tick = input_counter_get_mask() != 0 || image->duty_mask != 0 || output_sched_pending() ||
+                     logic_vm_needs_tick();
+
+    if (need_tick && !tick_running) {
+        last_tick_us = 0;
+        tick_running = esp_timer_start_periodic(scan_timer, SCAN_PERIOD_MS * 1000) == ESP_OK;
+    } else if (!need_tick && tick_running) {
+        esp_timer_stop(scan_timer);
+        tick_running = false;
+    }
+}
+
+static void scan_record(uint32_t events, uint32_t exec_us, uint32_t missed_periods)
+{
+    scan_stats.scan_count++;
+    scan_stats.tick_scans += (events & SCAN_EVENT_TICK) ? 1 : 0;
+    scan_stats.input_scans += (events & SCAN_EVENT_INPUT) ? 1 : 0;
+    scan_stats.command_scans += (events & SCAN_EVENT_COMMAND) ? 1 : 0;
+    scan_stats.timer_scans += (events & SCAN_EVENT_TIMER) ? 1 : 0;
+    scan_stats.overruns += missed_periods;
+    if (exec_us > scan_stats.period_us) {
+        scan_stats.overruns++;
+    }
+
+    if (exec_us < scan_stats.min_us) {
+        scan_stats.min_us = exec_us;
+    }
+    if (exec_us > scan_stats.max_us) {
+        scan_stats.max_us = exec_us;
+    }
+
+    scan_total_us += exec_us;
+    scan_stats.avg_us = (uint32_t)(scan_total_us / scan_stats.scan_count);
+}
+
+esp_err_t scan_cycle_start(void)
+{
+    // A hardware-backed esp_timer keeps the period independent of the tick
+    // rate. Created first: the scan task may start the tick on its first scan.
+    esp_timer_create_args_t timer_args = {
+        .callback = scan_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "scan_cycle"
+    };
+
+    esp_err_t ret = esp_timer_create(&timer_args, &scan_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create scan timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (xTaskCreatePinnedToCore(scan_task, "scan_task", SCAN_TASK_STACK_SIZE, NULL,
+                                SCAN_TASK_PRIORITY, &scan_task_handle, HOTPATH_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create scan task");
+        esp_timer_delete(scan_timer);
+        scan_timer = NULL;
+        return ESP_FAIL;
+    }
+
+    // First scan computes the initial outputs and decides whether to tick
+    scan_cycle_notify(SCAN_EVENT_COMMAND);
+
+    ESP_LOGI(TAG, "Event-driven scan started (%d ms tick when needed)", SCAN_PERIOD_MS);
+    return ESP_OK;
+}
+
+void scan_cycle_notify(uint32_t events)
+{
+    if (scan_task_handle != NULL) {
+        xTaskNotify(scan_task_handle, events, eSetBits);
+    }
+}
+
+void scan_cycle_get_stats(scan_stats_t *stats)
+{
+    memcpy(stats, &scan_stats, sizeof(*stats));
+    stats->tick_running = tick_running;
+    if (stats->scan_count == 0) {
+        stats->min_us = 0;
+    }
+}
+
+void scan_task(void *arg)
+{
+    scan_image_t image;
+
+    ESP_LOGI(TAG, "Scan task started");
+
+    while (1) {
+        // Sleep until an input, command, deadline or tick needs a scan
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+        int64_t start = time_base_now_us();
+        HOTPATH_BEGIN(HOTPATH_SCAN);
+
+        // Ticks further apart than one period mean whole periods were missed
+        uint32_t missed = 0;
+        if (events & SCAN_EVENT_TICK) {
+            if (last_tick_us != 0 && start - last_tick_us >= 2LL * SCAN_PERIOD_MS * 1000) {
+                missed = (uint32_t)((start - last_tick_us) / (SCAN_PERIOD_MS * 1000)) - 1;
+            }
+            last_tick_us = start;
+        }
+
+        scan_read_inputs(&image);
+        if (events & SCAN_EVENT_TIMER) {
+            process_timers();
+        }
+        scan_evaluate_logic(&image);
+        scan_write_outputs(&image);
+        HOTPATH_END(HOTPATH_SCAN);
+
+        // Mirror the outputs into RTC memory; overrides and timers only
+        // change on command and timer scans
+        retain_capture((events & (SCAN_EVENT_COMMAND | SCAN_EVENT_TIMER)) != 0);
+
+        scan_update_tick(&image);
+        scan_record(events, (uint32_t)(time_base_now_us() - start), missed);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef SCAN_CYCLE_H
+#define SCAN_CYCLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Events that wake the scan task; a scan only runs when one is posted
+#define SCAN_EVENT_TICK         (1UL << 0)    // Periodic tick (counters, duty outputs)
+#define SCAN_EVENT_INPUT        (1UL << 1)    // A debounced input changed
+#define SCAN_EVENT_COMMAND      (1UL << 2)    // Web command or configuration change
+#define SCAN_EVENT_TIMER        (1UL << 3)    // Output timer or manual control deadline
+
+// Scan cycle statistics (execution time of one read-logic-write pass)
+typedef struct {
+    uint32_t scan_count;
+    uint32_t overruns;      // Scans that missed their period
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t max_us;
+    uint32_t period_us;
+    uint32_t tick_scans;    // Scans woken by each kind of event
+    uint32_t input_scans;
+    uint32_t command_scans;
+    uint32_t timer_scans;
+    bool tick_running;      // Periodic tick needed by counters or duty outputs
+} scan_stats_t;
+
+// Function prototypes
+esp_err_t scan_cycle_start(void);
+// Post one or more SCAN_EVENT_* bits; safe from any task, not from an ISR
+void scan_cycle_notify(uint32_t events);
+void scan_cycle_get_stats(scan_stats_t *stats);
+void scan_task(void *arg);
+
+#endif // SCAN_CYCLE_H
@@ -0,0 +1,401 @@
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_netif_sntp.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "auto_board.h"
+#include "auto_board_config.h"
+#include "web_server.h"
+#include "scan_cycle.h"
+#include "output_duty.h"
+#include "output_arbiter.h"
+#include "schedule.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "SCHEDULE";
+
+#define MINUTES_PER_DAY     1440
+#define MINUTES_PER_WEEK    (7 * MINUTES_PER_DAY)
+
+// Any clock before this has never been set
+#define TIME_VALID_AFTER    1704067200      // 2024-01-01
+
+// Re-check at least this often, so SNTP steps and DST changes are
+// picked up even when the next transition is days away
+#define MAX_SLEEP_S         3600
+
+static const char *source_names[] = { "none", "manual", "sntp" };
+
+static schedule_rule_t rules[SCHEDULE_MAX_RULES];
+static int rule_count = 0;
+static char tz_string[SCHEDULE_TZ_MAX_LEN] = SCHEDULE_DEFAULT_TZ;
+static SemaphoreHandle_t rules_mutex = NULL;
+
+static esp_timer_handle_t transition_timer = NULL;
+static volatile schedule_time_source_t time_source = SCHEDULE_TIME_NONE;
+static volatile uint32_t schedule_mask = 0;
+static volatile uint32_t schedule_bits = 0;
+static int64_t next_transition = 0;
+
+static bool rule_valid(const schedule_rule_t *rule)
+{
+    return rule->output < NUM_OUTPUTS &&
+           (rule->days & SCHEDULE_ALL_DAYS) != 0 && (rule->days & ~SCHEDULE_ALL_DAYS) == 0 &&
+           rule->on_min < MINUTES_PER_DAY && rule->off_min < MINUTES_PER_DAY &&
+           rule->on_min != rule->off_min;
+}
+
+// Is the rule ON at 'minute' of 'day' (0 = Monday)?
+static bool rule_on_at(const schedule_rule_t *rule, int day, int minute)
+{
+    int prev_day = (day + 6) % 7;
+
+    if (rule->on_min < rule->off_min) {
+        return (rule->days & (1 << day)) && minute >= rule->on_min && minute < rule->off_min;
+    }
+    // Overnight: the evening part belongs to 'day', the morning part to the day before
+    return ((rule->days & (1 << day)) && minute >= rule->on_min) ||
+           ((rule->days & (1 << prev_day)) && minute < rule->off_min);
+}
+
+// Minutes from 'now' (day, minute) to the rule's next ON or OFF edge
+static int rule_next_edge(const schedule_rule_t *rule, int day, int minute)
+{
+    int best = MINUTES_PER_WEEK + 1;
+
+    // The OFF edge of yesterday's overnight window can still be ahead
+    if (rule->off_min < rule->on_min && (rule->days & (1 << ((day + 6) % 7))) && minute < rule->off_min) {
+        best = rule->off_min - minute;
+    }
+
+    for (int d = 0; d <= 7; d++) {
+        int start_day = (day + d) % 7;
+        if (!(rule->days & (1 << start_day))) {
+            continue;
+        }
+
+        int on_at = d * MINUTES_PER_DAY + rule->on_min - minute;
+        int off_at = d * MINUTES_PER_DAY + rule->off_min - minute;
+        if (rule->off_min < rule->on_min) {
+            off_at += MINUTES_PER_DAY;
+        }
+
+        if (on_at > 0 && on_at < best) {
+            best = on_at;
+        }
+        if (off_at > 0 && off_at < best) {
+            best = off_at;
+        }
+    }
+    return best;
+}
+
+static bool clock_valid(time_t now)
+{
+    return now >= TIME_VALID_AFTER;
+}
+
+static void arm_transition_timer(int64_t delay_s)
+{
+    if (delay_s > MAX_SLEEP_S) {
+        delay_s = MAX_SLEEP_S;
+    }
+    if (delay_s < 1) {
+        delay_s = 1;
+    }
+
+    esp_timer_stop(transition_timer);
+    esp_timer_start_once(transition_timer, (uint64_t)delay_s * 1000000);
+}
+
+// Work out the scheduled outputs for the current wall-clock time and
+// sleep until the next edge; no periodic scanning of the rule table.
+// Called from the timer, SNTP and web contexts, so it runs under the mutex
+static void schedule_evaluate(void)
+{
+    time_t now = time(NULL);
+    uint32_t mask = 0;
+    uint32_t bits = 0;
+    int next_min = MINUTES_PER_WEEK + 1;
+    int second = 0;
+
+    xSemaphoreTake(rules_mutex, portMAX_DELAY);
+    if (clock_valid(now)) {
+        struct tm local;
+        localtime_r(&now, &local);
+        int day = (local.tm_wday + 6) % 7;
+        int minute = local.tm_hour * 60 + local.tm_min;
+        second = local.tm_sec;
+
+        for (int i = 0; i < rule_count; i++) {
+            if (!rules[i].enabled) {
+                continue;
+            }
+            mask |= 1UL << rules[i].output;
+            if (rule_on_at(&rules[i], day, minute)) {
+                bits |= 1UL << rules[i].output;
+            }
+            int edge = rule_next_edge(&rules[i], day, minute);
+            if (edge < next_min) {
+                next_min = edge;
+            }
+        }
+    }
+
+    // A schedule edge ends any manual override on that output; the first
+    // evaluation is not an edge, so overrides restored at boot survive it
+    static bool evaluated = false;
+    uint32_t changed = evaluated ? (bits ^ schedule_bits) & mask : 0;
+    evaluated = true;
+    for (uint32_t m = changed; m; m &= m - 1) {
+        int output = __builtin_ctz(m);
+        web_clear_manual_control(output);
+        ESP_LOGI(TAG, "Output %d scheduled %s", output + 1, (bits & (1UL << output)) ? "ON" : "OFF");
+    }
+
+    schedule_bits = bits;
+    schedule_mask = mask;
+
+    // The schedule owns its outputs through the SCHEDULE slot; inside the
+    // ON window a duty-cycled output is left to the duty engine
+    uint32_t claims = mask;
+    for (uint32_t m = mask & bits; m; m &= m - 1) {
+        int output = __builtin_ctz(m);
+        output_duty_config_t duty;
+        output_duty_get(output, &duty);
+        if (duty.mode != OUTPUT_MODE_ONOFF) {
+            claims &= ~(1UL << output);
+        }
+    }
+    output_arbiter_set(OUTPUT_ARBITER_SCHEDULE, claims, bits);
+
+    if (next_min <= MINUTES_PER_WEEK) {
+        int64_t delay_s = (int64_t)next_min * 60 - second;
+        next_transition = (int64_t)now + delay_s;
+        arm_transition_timer(delay_s);
+    } else {
+        // No rules, or no valid clock yet: look again later
+        next_transition = 0;
+        arm_transition_timer(MAX_SLEEP_S);
+    }
+    xSemaphoreGive(rules_mutex);
+
+    scan_cycle_notify(SCAN_EVENT_TIMER);
+}
+
+static void transition_timer_callback(void *arg)
+{
+    schedule_evaluate();
+}
+
+static void sntp_sync_callback(struct timeval *tv)
+{
+    time_source = SCHEDULE_TIME_SNTP;
+    ESP_LOGI(TAG, "Clock synchronised by SNTP");
+    schedule_evaluate();
+}
+
+static esp_err_t save_rules(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(SCHEDULE_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_set_blob(nvs_handle, "rules", rules, rule_count * sizeof(schedule_rule_t));
+    if (err == ESP_OK) {
+        err = nvs_set_str(nvs_handle, "tz", tz_string);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+static void load_rules(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(SCHEDULE_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        ESP_LOGI(TAG, "No stored schedule");
+        return;
+    }
+
+    schedule_rule_t stored[SCHEDULE_MAX_RULES];
+    size_t len = sizeof(stored);
+    if (nvs_get_blob(nvs_handle, "rules", stored, &len) == ESP_OK && len % sizeof(schedule_rule_t) == 0) {
+        rule_count = 0;
+        for (size_t i = 0; i < len / sizeof(schedule_rule_t); i++) {
+            if (rule_valid(&stored[i])) {
+                rules[rule_count++] = stored[i];
+            } else {
+                ESP_LOGW(TAG, "Stored rule %d invalid, dropped", (int)i + 1);
+            }
+        }
+    }
+
+    size_t tz_len = sizeof(tz_string);
+    if (nvs_get_str(nvs_handle, "tz", tz_string, &tz_len) != ESP_OK) {
+        strcpy(tz_string, SCHEDULE_DEFAULT_TZ);
+    }
+    nvs_close(nvs_handle);
+
+    ESP_LOGI(TAG, "Loaded %d schedule rules (TZ %s)", rule_count, tz_string);
+}
+
+esp_err_t schedule_init(void)
+{
+    rules_mutex = xSemaphoreCreateMutex();
+    if (rules_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    load_rules();
+    setenv("TZ", tz_string, 1);
+    tzset();
+
+    esp_timer_create_args_t timer_args = {
+        .callback = transition_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "schedule"
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &transition_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create schedule timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // SNTP keeps running in the background and resyncs on its own
+    esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG(SCHEDULE_SNTP_SERVER);
+    sntp_config.sync_cb = sntp_sync_callback;
+    ret = esp_netif_sntp_init(&sntp_config);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "SNTP not started (%s), use /api/time to set the clock", esp_err_to_name(ret));
+    }
+
+    // The RTC keeps time across a soft reset, so the clock may already be good
+    if (clock_valid(time(NULL))) {
+        time_source = SCHEDULE_TIME_MANUAL;
+    }
+
+    schedule_evaluate();
+    return ESP_OK;
+}
+
+esp_err_t schedule_set_rules(const schedule_rule_t *new_rules, int count)
+{
+    if (count < 0 || count > SCHEDULE_MAX_RULES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!rule_valid(&new_rules[i])) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    xSemaphoreTake(rules_mutex, portMAX_DELAY);
+    memcpy(rules, new_rules, count * sizeof(schedule_rule_t));
+    rule_count = count;
+    esp_err_t err = save_rules();
+    xSemaphoreGive(rules_mutex);
+
+    for (int i = 0; i < count; i++) {
+        ESP_LOGI(TAG, "Rule %d: output %d %02d:%02d-%02d:%02d days 0x%02x%s",
+                 i + 1, new_rules[i].output + 1,
+                 new_rules[i].on_min / 60, new_rules[i].on_min % 60,
+                 new_rules[i].off_min / 60, new_rules[i].off_min % 60,
+                 new_rules[i].days, new_rules[i].enabled ? "" : " (disabled)");
+    }
+
+    schedule_evaluate();
+    return err;
+}
+
+int schedule_get_rules(schedule_rule_t *out, int max_rules)
+{
+    xSemaphoreTake(rules_mutex, portMAX_DELAY);
+    int count = rule_count < max_rules ? rule_count : max_rules;
+    memcpy(out, rules, count * sizeof(schedule_rule_t));
+    xSemaphoreGive(rules_mutex);
+    return count;
+}
+
+esp_err_t schedule_set_timezone(const char *tz)
+{
+    if (tz == NULL || strlen(tz) == 0 || strlen(tz) >= SCHEDULE_TZ_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(rules_mutex, portMAX_DELAY);
+    strcpy(tz_string, tz);
+    setenv("TZ", tz_string, 1);
+    tzset();
+    esp_err_t err = save_rules();
+    xSemaphoreGive(rules_mutex);
+
+    ESP_LOGI(TAG, "Timezone set to %s", tz);
+    schedule_evaluate();
+    return err;
+}
+
+void schedule_get_timezone(char *tz, size_t len)
+{
+    xSemaphoreTake(rules_mutex, portMAX_DELAY);
+    strncpy(tz, tz_string, len - 1);
+    tz[len - 1] = '\0';
+    xSemaphoreGive(rules_mutex);
+}
+
+esp_err_t schedule_set_time(int64_t epoch_s)
+{
+    if (!clock_valid((time_t)epoch_s)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct timeval tv = {
+        .tv_sec = (time_t)epoch_s,
+        .tv_usec = 0
+    };
+    settimeofday(&tv, NULL);
+
+    // A later SNTP sync still takes over
+    if (time_source != SCHEDULE_TIME_SNTP) {
+        time_source = SCHEDULE_TIME_MANUAL;
+    }
+    ESP_LOGI(TAG, "Clock set manually to %lld", (long long)epoch_s);
+
+    schedule_evaluate();
+    return ESP_OK;
+}
+
+void schedule_refresh(void)
+{
+    if (rules_mutex != NULL) {
+        schedule_evaluate();
+    }
+}
+
+void schedule_get_status(schedule_status_t *status)
+{
+    status->source = time_source;
+    status->active_mask = schedule_mask;
+    status->on_bits = schedule_bits;
+    status->next_transition = next_transition;
+}
+
+const char *schedule_time_source_name(schedule_time_source_t source)
+{
+    return source <= SCHEDULE_TIME_SNTP ? source_names[source] : "unknown";
+}
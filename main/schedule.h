@@ -0,0 +1,56 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define SCHEDULE_NAMESPACE      "schedule"
+#define SCHEDULE_MAX_RULES      16
+#define SCHEDULE_TZ_MAX_LEN     48
+
+// Day bits of schedule_rule_t.days, Monday first
+#define SCHEDULE_DAY_MON        (1 << 0)
+#define SCHEDULE_DAY_SUN        (1 << 6)
+#define SCHEDULE_ALL_DAYS       0x7F
+
+// One weekly rule: ON from on_min to off_min (minutes after midnight) on
+// every day in 'days'. off_min < on_min runs past midnight into the next day.
+typedef struct {
+    uint8_t output;         // 0-based output
+    uint8_t days;           // SCHEDULE_DAY_* bits
+    uint16_t on_min;
+    uint16_t off_min;
+    uint8_t enabled;
+    uint8_t reserved;
+} schedule_rule_t;
+
+// Where the wall clock came from
+typedef enum {
+    SCHEDULE_TIME_NONE = 0,     // Not set: schedules are paused
+    SCHEDULE_TIME_MANUAL,       // Set through /api/time
+    SCHEDULE_TIME_SNTP
+} schedule_time_source_t;
+
+typedef struct {
+    schedule_time_source_t source;
+    uint32_t active_mask;       // Outputs with at least one enabled rule
+    uint32_t on_bits;           // Outputs the schedule wants ON right now
+    int64_t next_transition;    // Wall-clock time of the next change, 0 if none
+} schedule_status_t;
+
+// Function prototypes
+esp_err_t schedule_init(void);
+// Replace the whole rule table and save it to NVS
+esp_err_t schedule_set_rules(const schedule_rule_t *rules, int count);
+int schedule_get_rules(schedule_rule_t *rules, int max_rules);
+esp_err_t schedule_set_timezone(const char *tz);
+void schedule_get_timezone(char *tz, size_t len);
+// Manual clock fallback while SNTP is unreachable
+esp_err_t schedule_set_time(int64_t epoch_s);
+// Re-publish the schedule's claims, e.g. after an output's duty mode changed
+void schedule_refresh(void);
+void schedule_get_status(schedule_status_t *status);
+const char *schedule_time_source_name(schedule_time_source_t source);
+
+#endif // SCHEDULE_H
@@ -0,0 +1,256 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "time_base.h"
+#include "auto_board.h"
+#include "input_debounce.h"
+#include "input_profile.h"
+#include "input_sample.h"
+
+// Edge-to-debounced latency of input 1, before and after the move to
+// event-driven debouncing, on the same bouncing presses and releases.
+//  - before: a model of the input_task loop this replaced. It took one ISR
+//    event per pass off the queue, waiting up to 100 ms for one, ran
+//    debounce_inputs() and slept 10 ms. An input was committed once it had
+//    not changed for the debounce time at a pass.
+//  - after: input_debounce, input_profile and input_sample as built for the
+//    target, on the fake clock. The test stands in for input_task: it hands
+//    each edge to input_debounce_edges() and runs input_debounce_tick()
+//    whenever the fake esp_timer fires.
+// Both are reported in the firmware's histogram, the delay beyond the
+// configured debounce time from the last edge.
+
+#define PRESSES         1000
+#define MAX_EDGES       (PRESSES * 2 * 9)
+#define DEBOUNCE_MS     INPUT_DEBOUNCE_MS
+
+#define POLL_WAIT_US    100000      // xQueueReceive timeout of the old loop
+#define POLL_DELAY_US   10000       // vTaskDelay between its passes
+
+// Wakeups this long after the last edge, well past the slowest debounce
+// of either, are counted as idle ones
+#define IDLE_AFTER_US   250000
+
+typedef struct {
+    int64_t t_us;
+    bool level;
+} edge_t;
+
+typedef struct {
+    uint32_t changes;
+    uint32_t wakeups;
+    uint32_t idle_wakeups;
+    int64_t delay_total_us;
+    int64_t delay_max_us;
+    debounce_latency_stats_t hist;
+} result_t;
+
+static edge_t edges[MAX_EDGES];
+static int edge_count;
+static int64_t end_us;
+static int64_t idle_us;         // Time spent more than IDLE_AFTER_US after an edge
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL line %d: %s\n", __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static uint32_t rng_state = 0x2545f491;
+
+static uint32_t rng(uint32_t range)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state % range;
+}
+
+// Idle 0.2-1 s, then an odd number of edges 0.05-1.5 ms apart ending on
+// the new level, for a press and then a release
+static void make_edges(int64_t start_us)
+{
+    int64_t t = start_us;
+    bool level = true;      // Pulled up, contact open
+
+    edge_count = 0;
+    idle_us = 0;
+    for (int i = 0; i < PRESSES * 2; i++) {
+        int64_t gap = 200000 + rng(800000);
+        if (i > 0 && gap > IDLE_AFTER_US) {
+            idle_us += gap - IDLE_AFTER_US;
+        }
+        t += gap;
+        int bounces = (int)rng(5) * 2 + 1;
+        for (int b = 0; b < bounces; b++) {
+            level = !level;
+            edges[edge_count++] = (edge_t){ t, level };
+            t += 50 + rng(1450);
+        }
+    }
+    end_us = t + 1000000;
+    idle_us += end_us - t - IDLE_AFTER_US;
+}
+
+static void wakeup(result_t *res, int64_t now_us, int next)
+{
+    res->wakeups++;
+    if (next > 0 && now_us - edges[next - 1].t_us > IDLE_AFTER_US) {
+        res->idle_wakeups++;
+    }
+}
+
+static void record(result_t *res, int64_t now_us, int64_t last_edge_us)
+{
+    int64_t delay = now_us - last_edge_us;
+    uint32_t excess = delay > DEBOUNCE_MS * 1000 ? (uint32_t)(delay - DEBOUNCE_MS * 1000) : 0;
+
+    int bucket = 0;
+    while (bucket < DEBOUNCE_HIST_BUCKETS - 1 && excess >= debounce_hist_limits_us[bucket]) {
+        bucket++;
+    }
+    res->hist.buckets[bucket]++;
+    res->hist.samples++;
+    if (res->hist.samples == 1 || excess < res->hist.min_us) {
+        res->hist.min_us = excess;
+    }
+    if (excess > res->hist.max_us) {
+        res->hist.max_us = excess;
+    }
+
+    res->changes++;
+    res->delay_total_us += delay;
+    if (delay > res->delay_max_us) {
+        res->delay_max_us = delay;
+    }
+}
+
+static void run_poll(result_t *res, int64_t start_us)
+{
+    int64_t t = start_us;
+    int next = 0;
+    bool current = true, last = true, debounced = true;
+    int64_t last_change_ms = 0;
+
+    while (t < end_us) {
+        // xQueueReceive(input_event_queue, &event, pdMS_TO_TICKS(100))
+        if (next < edge_count && edges[next].t_us <= t) {
+            current = edges[next++].level;
+            last_change_ms = t / 1000;
+        } else {
+            int64_t wait_end = t + POLL_WAIT_US;
+            if (next < edge_count && edges[next].t_us <= wait_end) {
+                t = edges[next].t_us;
+                current = edges[next++].level;
+                last_change_ms = t / 1000;
+            } else {
+                t = wait_end;
+            }
+            wakeup(res, t, next);
+        }
+
+        // debounce_inputs()
+        int64_t now_ms = t / 1000;
+        if (current != last) {
+            last = current;
+            last_change_ms = now_ms;
+        } else if (now_ms - last_change_ms >= DEBOUNCE_MS && debounced != current) {
+            debounced = current;
+            record(res, t, edges[next - 1].t_us);
+        }
+
+        // vTaskDelay(pdMS_TO_TICKS(10))
+        t += POLL_DELAY_US;
+        wakeup(res, t, next);
+    }
+}
+
+static void run_event(result_t *res)
+{
+    uint32_t pin = 1UL << INPUT_1_GPIO;
+    uint32_t state = input_debounce_get_state() & 1;
+    int next = 0;
+
+    while (1) {
+        int64_t due = esp_timer_fake_next_due();
+        int64_t edge_us = next < edge_count ? edges[next].t_us : end_us;
+
+        if (due <= edge_us && due < end_us) {
+            esp_timer_fake_advance(due);
+            input_debounce_tick();
+        } else if (next < edge_count) {
+            esp_timer_fake_advance(edge_us);
+            if (edges[next].level) {
+                input_sample_fake_in |= pin;
+            } else {
+                input_sample_fake_in &= ~pin;
+            }
+            input_event_t event = { 0, edges[next].level, edge_us };
+            input_debounce_edges(&event, 1);
+            next++;
+        } else {
+            break;
+        }
+        wakeup(res, time_base_now_us(), next);
+
+        if ((input_debounce_get_state() & 1) != state) {
+            state ^= 1;
+            record(res, time_base_now_us(), edges[next - 1].t_us);
+        }
+    }
+    esp_timer_fake_advance(end_us);
+}
+
+static void print_result(const char *name, const result_t *res)
+{
+    printf("%-7s %4lu changes, delay avg %5.1f ms max %5.1f ms, %5.1f wakeups per change, %4.1f/s idle;"
+           " beyond %d ms:", name, (unsigned long)res->changes,
+           res->changes ? (double)res->delay_total_us / res->changes / 1000 : 0.0,
+           (double)res->delay_max_us / 1000,
+           res->changes ? (double)(res->wakeups - res->idle_wakeups) / res->changes : 0.0,
+           (double)res->idle_wakeups * 1e6 / idle_us, DEBOUNCE_MS);
+    for (int b = 0; b < DEBOUNCE_HIST_BUCKETS; b++) {
+        printf(" %lu", (unsigned long)res->hist.buckets[b]);
+    }
+    printf("\n");
+}
+
+int main(void)
+{
+    input_sample_fake_in = 1UL << INPUT_1_GPIO;
+    input_sample_init();
+    input_profile_init();
+    input_debounce_init();
+
+    int64_t start_us = time_base_now_us();
+    make_edges(start_us);
+
+    result_t before = { 0 }, after = { 0 };
+    run_poll(&before, start_us);
+    run_event(&after);
+
+    // The test's own histogram must match the one the firmware keeps
+    debounce_latency_stats_t hist;
+    input_debounce_get_latency(&hist);
+    CHECK(memcmp(hist.buckets, after.hist.buckets, sizeof(hist.buckets)) == 0);
+    CHECK(hist.max_us == after.hist.max_us);
+
+    printf("histogram buckets: <0.25 <0.5 <1 <2 <5 <10 <20 >=20 ms\n");
+    print_result("before", &before);
+    print_result("after", &after);
+
+    // Every press and release must come through exactly once
+    CHECK(before.changes == PRESSES * 2);
+    CHECK(after.changes == PRESSES * 2);
+    // No wakeups at all while every input is idle
+    CHECK(after.idle_wakeups == 0);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
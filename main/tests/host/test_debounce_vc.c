@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "input_debounce.h"
+
+// Microbenchmark of the vertical-counter debounce against the per-input
+// loop it replaced, at 5, 32 and 64 inputs (64 = two packed words, as two
+// expansion boards would need). Both must report the same flips on every
+// tick of the same noisy input stream.
+
+#define TICKS           200000
+#define MAX_WORDS       2
+
+// The old debounce_inputs(): one counter and a few branches per input
+typedef struct {
+    uint8_t stable[MAX_WORDS * 32];
+    uint8_t count[MAX_WORDS * 32];
+} debounce_loop_t;
+
+static int loop_update(debounce_loop_t *d, const uint32_t *sample, int inputs, uint32_t *flipped)
+{
+    int flips = 0;
+    for (int i = 0; i < inputs; i++) {
+        uint8_t level = (sample[i / 32] >> (i % 32)) & 1;
+        if (level == d->stable[i]) {
+            d->count[i] = 0;
+        } else if (++d->count[i] >= DEBOUNCE_VC_SAMPLES) {
+            d->stable[i] = level;
+            d->count[i] = 0;
+            flipped[i / 32] |= 1UL << (i % 32);
+            flips++;
+        }
+    }
+    return flips;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Inputs that mostly hold their level, with bursts of contact bounce
+static uint32_t *make_samples(int words)
+{
+    uint32_t *samples = malloc(sizeof(uint32_t) * TICKS * words);
+    uint32_t level[MAX_WORDS] = { 0 };
+    srand(1);
+    for (int t = 0; t < TICKS; t++) {
+        for (int w = 0; w < words; w++) {
+            if (rand() % 16 == 0) {
+                level[w] ^= 1UL << (rand() % 32);
+            }
+            uint32_t bounce = (rand() % 4 == 0) ? (uint32_t)rand() & (uint32_t)rand() : 0;
+            samples[t * words + w] = level[w] ^ bounce;
+        }
+    }
+    return samples;
+}
+
+static int run(int inputs)
+{
+    int words = (inputs + 31) / 32;
+    uint32_t mask[MAX_WORDS];
+    for (int w = 0; w < words; w++) {
+        int bits = inputs - w * 32;
+        mask[w] = bits >= 32 ? UINT32_MAX : (1UL << bits) - 1;
+    }
+    uint32_t *samples = make_samples(words);
+
+    // Correctness: the same flips on every tick
+    debounce_vc_t vc[MAX_WORDS];
+    debounce_loop_t loop = { 0 };
+    for (int w = 0; w < words; w++) {
+        debounce_vc_reset(&vc[w], 0);
+    }
+    int mismatches = 0;
+    long flips = 0;
+    for (int t = 0; t < TICKS; t++) {
+        uint32_t loop_flipped[MAX_WORDS] = { 0 };
+        flips += loop_update(&loop, &samples[t * words], inputs, loop_flipped);
+        for (int w = 0; w < words; w++) {
+            uint32_t vc_flipped = debounce_vc_update_masked(&vc[w], samples[t * words + w], mask[w]);
+            mismatches += vc_flipped != loop_flipped[w];
+        }
+    }
+
+    // Speed
+    volatile uint32_t sink = 0;
+    double start = now_s();
+    for (int t = 0; t < TICKS; t++) {
+        uint32_t flipped[MAX_WORDS] = { 0 };
+        loop_update(&loop, &samples[t * words], inputs, flipped);
+        sink ^= flipped[0];
+    }
+    double loop_ns = (now_s() - start) / TICKS * 1e9;
+
+    start = now_s();
+    for (int t = 0; t < TICKS; t++) {
+        for (int w = 0; w < words; w++) {
+            sink ^= debounce_vc_update_masked(&vc[w], samples[t * words + w], mask[w]);
+        }
+    }
+    double vc_ns = (now_s() - start) / TICKS * 1e9;
+
+    printf("%2d inputs: loop %6.1f ns/tick, vertical counter %5.1f ns/tick (%4.1fx), %ld flips%s\n",
+           inputs, loop_ns, vc_ns, loop_ns / vc_ns, flips, mismatches ? ", MISMATCH" : "");
+    free(samples);
+    return mismatches;
+}
+
+int main(void)
+{
+    int errors = 0;
+    errors += run(NUM_INPUTS);
+    errors += run(32);
+    errors += run(64);
+    return errors != 0;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "hotpath_audit.h"
+
+// Host build of the hot path audit (HOTPATH_AUDIT_HOST): stage timing,
+// allocations blamed on the stages open when they happen, and the cost of
+// one begin/end probe pair.
+
+#define SPIN_NS         20000
+#define SPIN_RUNS       50
+#define PROBE_PAIRS     1000000
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL line %d: %s\n", __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void spin(uint64_t ns)
+{
+    uint64_t end = now_ns() + ns;
+    while (now_ns() < end) {
+    }
+}
+
+static void check_timing(void)
+{
+    for (int i = 0; i < SPIN_RUNS; i++) {
+        uint32_t start = hotpath_audit_begin(HOTPATH_DEBOUNCE);
+        spin(SPIN_NS);
+        hotpath_audit_end(HOTPATH_DEBOUNCE, start);
+    }
+
+    hotpath_stage_stats_t stats;
+    hotpath_audit_get_stats(HOTPATH_DEBOUNCE, &stats);
+    printf("%-10s n:%lu min:%luns avg:%luns max:%luns\n", hotpath_audit_stage_name(HOTPATH_DEBOUNCE),
+           (unsigned long)stats.count, (unsigned long)stats.min_ns,
+           (unsigned long)stats.avg_ns, (unsigned long)stats.max_ns);
+    CHECK(stats.count == SPIN_RUNS);
+    CHECK(stats.min_ns >= SPIN_NS);
+    CHECK(stats.min_ns <= stats.avg_ns && stats.avg_ns <= stats.max_ns);
+    CHECK(stats.allocs == 0);
+}
+
+static void check_allocs(void)
+{
+    // Outside any stage: nobody to blame
+    hotpath_audit_note_alloc(8);
+
+    uint32_t scan = hotpath_audit_begin(HOTPATH_SCAN);
+    uint32_t write = hotpath_audit_begin(HOTPATH_OUTPUT_WRITE);
+    hotpath_audit_note_alloc(32);
+    hotpath_audit_end(HOTPATH_OUTPUT_WRITE, write);
+    hotpath_audit_note_alloc(16);
+    hotpath_audit_end(HOTPATH_SCAN, scan);
+
+    hotpath_audit_note_alloc(8);
+
+    hotpath_stage_stats_t stats;
+    hotpath_audit_get_stats(HOTPATH_SCAN, &stats);
+    CHECK(stats.count == 1 && stats.allocs == 2 && stats.alloc_bytes == 48);
+    hotpath_audit_get_stats(HOTPATH_OUTPUT_WRITE, &stats);
+    CHECK(stats.count == 1 && stats.allocs == 1 && stats.alloc_bytes == 32);
+    hotpath_audit_get_stats(HOTPATH_ISR, &stats);
+    CHECK(stats.count == 0 && stats.allocs == 0);
+    printf("allocs: scan 2 (48 B), output_write 1 (32 B), none outside a stage\n");
+}
+
+static void check_misc(void)
+{
+    hotpath_stage_stats_t stats;
+    memset(&stats, 0xff, sizeof(stats));
+    hotpath_audit_get_stats(HOTPATH_STAGE_COUNT, &stats);
+    CHECK(stats.count == 0 && stats.max_ns == 0 && stats.allocs == 0);
+
+    CHECK(strcmp(hotpath_audit_stage_name(HOTPATH_ISR), "isr") == 0);
+    CHECK(strcmp(hotpath_audit_stage_name(HOTPATH_STAGE_COUNT), "unknown") == 0);
+
+    // No tasks on the host
+    CHECK(hotpath_audit_stack_free("input_task") == 0);
+}
+
+static void bench_probe(void)
+{
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < PROBE_PAIRS; i++) {
+        uint32_t start = hotpath_audit_begin(HOTPATH_ISR);
+        hotpath_audit_end(HOTPATH_ISR, start);
+    }
+    uint64_t elapsed = now_ns() - t0;
+
+    hotpath_stage_stats_t stats;
+    hotpath_audit_get_stats(HOTPATH_ISR, &stats);
+    CHECK(stats.count == PROBE_PAIRS);
+    printf("probe pair: %.1f ns (host clock_gettime, not CCOUNT)\n", (double)elapsed / PROBE_PAIRS);
+}
+
+int main(void)
+{
+    check_timing();
+    check_allocs();
+    check_misc();
+    bench_probe();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
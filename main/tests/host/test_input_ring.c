@@ -0,0 +1,183 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "input_ring.h"
+
+// Stress test and benchmark of the ISR-to-input_task edge path: the
+// lock-free ring against a model of the 10-deep FreeRTOS queue it
+// replaced.
+//  - throughput: a producer thread standing in for gpio_isr_handler pushes
+//    numbered edges, retrying while full, and the consumer drains them in
+//    batches like input_task. Every edge must arrive once and in order.
+//  - burst: a chattering contactor fires a burst of edges while input_task
+//    is not running; the ring must keep what the queue dropped.
+
+#define EDGES           1000000
+#define QUEUE_DEPTH     10
+#define BURST_EDGES     48
+
+typedef struct {
+    const char *name;
+    bool (*push)(const input_event_t *event);
+    size_t (*pop)(input_event_t *events, size_t max_events);
+} edge_path_t;
+
+// xQueueSendFromISR/xQueueReceive: a critical section around a copy
+static input_event_t queue[QUEUE_DEPTH];
+static unsigned queue_head, queue_count;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_uint queue_overflows;
+
+static bool queue_push(const input_event_t *event)
+{
+    pthread_mutex_lock(&queue_lock);
+    bool ok = queue_count < QUEUE_DEPTH;
+    if (ok) {
+        queue[(queue_head + queue_count++) % QUEUE_DEPTH] = *event;
+    } else {
+        atomic_fetch_add(&queue_overflows, 1);
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return ok;
+}
+
+static size_t queue_pop(input_event_t *events, size_t max_events)
+{
+    // The old input_task received one event per call
+    (void)max_events;
+    pthread_mutex_lock(&queue_lock);
+    size_t count = queue_count > 0;
+    if (count) {
+        events[0] = queue[queue_head];
+        queue_head = (queue_head + 1) % QUEUE_DEPTH;
+        queue_count--;
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return count;
+}
+
+static const edge_path_t paths[] = {
+    { "freertos queue", queue_push, queue_pop },
+    { "spsc ring", input_ring_push, input_ring_pop_batch },
+};
+
+static const edge_path_t *path;
+static atomic_bool producer_done;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static input_event_t make_edge(uint32_t i)
+{
+    input_event_t event = {
+        .input_num = i % NUM_INPUTS,
+        .state = i & 1,
+        .timestamp_us = i
+    };
+    return event;
+}
+
+static void *producer(void *arg)
+{
+    for (uint32_t i = 0; i < EDGES; i++) {
+        input_event_t event = make_edge(i);
+        while (!path->push(&event)) {
+            sched_yield();      // Let the consumer run on a single-CPU host
+        }
+    }
+    atomic_store(&producer_done, true);
+    return NULL;
+}
+
+// Edges may be dropped when full, never duplicated or reordered
+static int check_batch(const input_event_t *batch, size_t count, int64_t *last)
+{
+    int errors = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (batch[i].timestamp_us <= *last || batch[i].input_num != batch[i].timestamp_us % NUM_INPUTS) {
+            errors++;
+        }
+        *last = batch[i].timestamp_us;
+    }
+    return errors;
+}
+
+static int run_throughput(const edge_path_t *p)
+{
+    path = p;
+    atomic_store(&producer_done, false);
+
+    pthread_t thread;
+    double start = now_s();
+    pthread_create(&thread, NULL, producer, NULL);
+
+    input_event_t batch[INPUT_RING_BATCH_SIZE];
+    uint32_t received = 0;
+    int64_t last = -1;
+    int errors = 0;
+    for (;;) {
+        bool done = atomic_load(&producer_done);
+        size_t count = p->pop(batch, INPUT_RING_BATCH_SIZE);
+        errors += check_batch(batch, count, &last);
+        received += count;
+        if (done && count == 0) {
+            break;
+        }
+        if (count == 0) {
+            sched_yield();
+        }
+    }
+    pthread_join(thread, NULL);
+    double elapsed = now_s() - start;
+
+    errors += received != EDGES;
+    printf("%-15s throughput %7.2f M edges/s%s\n", p->name, received / elapsed / 1e6, errors ? ", ERRORS" : "");
+    return errors;
+}
+
+static int run_burst(const edge_path_t *p, uint32_t expect)
+{
+    uint32_t accepted = 0;
+    for (uint32_t i = 0; i < BURST_EDGES; i++) {
+        input_event_t event = make_edge(EDGES + i);
+        accepted += p->push(&event);
+    }
+
+    input_event_t batch[INPUT_RING_BATCH_SIZE];
+    uint32_t received = 0;
+    int64_t last = -1;
+    int errors = 0;
+    size_t count;
+    while ((count = p->pop(batch, INPUT_RING_BATCH_SIZE)) > 0) {
+        errors += check_batch(batch, count, &last);
+        received += count;
+    }
+
+    errors += received != accepted || received != expect;
+    printf("%-15s burst of %d edges: %u kept, %u dropped%s\n", p->name, BURST_EDGES,
+           (unsigned)received, (unsigned)(BURST_EDGES - received), errors ? ", ERRORS" : "");
+    return errors;
+}
+
+int main(void)
+{
+    int errors = 0;
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        errors += run_throughput(&paths[i]);
+    }
+    errors += run_burst(&paths[0], QUEUE_DEPTH);
+    errors += run_burst(&paths[1], BURST_EDGES < INPUT_RING_SIZE ? BURST_EDGES : INPUT_RING_SIZE);
+
+    input_ring_stats_t stats;
+    input_ring_get_stats(&stats);
+    printf("ring: %u pushed, %u overflows, high water %u of %d\n",
+           (unsigned)stats.pushed, (unsigned)stats.overflows, (unsigned)stats.high_water, INPUT_RING_SIZE);
+    return errors != 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include "auto_board.h"
+#include "input_sample.h"
+
+// Input sampling on the fake GPIO.in register (INPUT_SAMPLE_FAKE_REG):
+// every snapshot must pack the configured pins into bit n = input n,
+// ignore every other GPIO, and agree with reading the pins one by one.
+
+#define RANDOM_SAMPLES  100000
+
+extern const gpio_num_t input_gpios[];
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL line %d: %s\n", __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static uint32_t rng_state = 0x9e3779b9;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// What gpio_get_level() on each pin in turn would have returned
+static uint32_t per_pin(uint32_t reg)
+{
+    uint32_t bits = 0;
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        bits |= ((reg >> input_gpios[i]) & 1UL) << i;
+    }
+    return bits;
+}
+
+int main(void)
+{
+    input_sample_init();
+
+    uint32_t gpio_mask = 0;
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        gpio_mask |= 1UL << input_gpios[i];
+    }
+    CHECK(input_sample_get_gpio_mask() == gpio_mask);
+
+    // One pin at a time lands on its own input bit
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        input_sample_fake_in = 1UL << input_gpios[i];
+        CHECK(input_sample_snapshot() == 1UL << i);
+    }
+
+    // Other GPIOs never leak in
+    input_sample_fake_in = ~gpio_mask;
+    CHECK(input_sample_snapshot() == 0);
+    input_sample_fake_in = UINT32_MAX;
+    CHECK(input_sample_snapshot() == (1UL << NUM_INPUTS) - 1);
+
+    int mismatches = 0;
+    for (int n = 0; n < RANDOM_SAMPLES; n++) {
+        uint32_t reg = rng();
+        input_sample_fake_in = reg;
+        if (input_sample_snapshot() != per_pin(reg)) {
+            mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+    printf("%d inputs on GPIO mask 0x%08lx, %d random registers sampled, %d mismatches\n",
+           NUM_INPUTS, (unsigned long)gpio_mask, RANDOM_SAMPLES, mismatches);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "logic_vm.h"
+#include "logic_thread.h"
+
+// Scan time of a 1k-instruction logic program: the reference interpreter
+// (logic_vm_exec) against the threaded code running every entry, and
+// against the threaded code as logic_vm_scan() runs it, skipping entries
+// whose sources did not change. All three must produce the same outputs
+// and registers.
+
+#define PROGRAM_INSNS   1000
+#define SCANS           20000
+
+static logic_program_t program;
+static logic_thread_t thread;
+static logic_vm_t vm_interp;
+static logic_vm_t vm_thread;
+static logic_vm_t vm_incremental;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Any readable bit: inputs, block outputs or markers an earlier rung wrote
+static uint8_t pick_source(int rungs)
+{
+    switch (rand() % 4) {
+        case 0:  return LOGIC_REG_IN + rand() % NUM_INPUTS;
+        case 1:  return LOGIC_REG_TIMER + rand() % LOGIC_MAX_TIMERS;
+        case 2:  return LOGIC_REG_COUNTER + rand() % LOGIC_MAX_COUNTERS;
+        default: return rungs > 0 ? LOGIC_REG_MARKER + rand() % (rungs < LOGIC_MAX_MARKERS ? rungs : LOGIC_MAX_MARKERS)
+                                  : LOGIC_REG_IN;
+    }
+}
+
+// A mix like a real ladder: rungs of 4-16 chained terms, each ending in a
+// marker that later rungs read, every timer and counter block once and
+// comparators on their values. The last rungs drive the outputs.
+static void build_program(void)
+{
+    memset(&program, 0, sizeof(program));
+    program.version = LOGIC_PROGRAM_VERSION;
+    for (int i = 0; i < LOGIC_MAX_CONSTS; i++) {
+        program.consts[i] = i * 50;
+    }
+    for (int t = 0; t < LOGIC_MAX_TIMERS; t++) {
+        program.timer_ms[t] = 100 + t * 100;
+    }
+    for (int c = 0; c < LOGIC_MAX_COUNTERS; c++) {
+        program.counter_pv[c] = 3 + c;
+    }
+
+    srand(21);
+    int rungs = 0;
+    int timers = 0;
+    int counters = 0;
+    int rung_left = 0;
+    uint8_t temp = LOGIC_REG_TEMP;
+    for (int i = 0; i < PROGRAM_INSNS; i++) {
+        logic_insn_t *insn = &program.code[i];
+        int kind = rand() % 100;
+        bool first = rung_left == 0;
+        if (first) {
+            rung_left = 4 + rand() % 13;
+        }
+
+        if (kind < 3 && timers < LOGIC_MAX_TIMERS) {
+            *insn = (logic_insn_t) { LOGIC_OP_TON + timers % 3, 0, pick_source(rungs), timers };
+            timers++;
+            continue;
+        }
+        if (kind < 5 && counters < LOGIC_MAX_COUNTERS) {
+            *insn = (logic_insn_t) { LOGIC_OP_CTU + counters % 2, pick_source(rungs), pick_source(rungs), counters };
+            counters++;
+            continue;
+        }
+
+        if (first) {
+            *insn = (logic_insn_t) { LOGIC_OP_GT + rand() % 6, 0, rand() % LOGIC_WORD_COUNT, rand() % LOGIC_MAX_CONSTS };
+        } else {
+            *insn = (logic_insn_t) { LOGIC_OP_AND + rand() % 7, 0, temp, pick_source(rungs) };
+        }
+
+        // The rung builds its result in one temporary and stores it last
+        if (--rung_left > 0 && i < PROGRAM_INSNS - 1) {
+            insn->d = temp;
+        } else if (i >= PROGRAM_INSNS - NUM_OUTPUTS * 8) {
+            insn->d = LOGIC_REG_OUT + rungs % NUM_OUTPUTS;
+            rungs++;
+        } else {
+            insn->d = LOGIC_REG_MARKER + rungs % LOGIC_MAX_MARKERS;
+            rungs++;
+        }
+    }
+    program.count = PROGRAM_INSNS;
+}
+
+int main(void)
+{
+    build_program();
+    if (logic_program_verify(&program) != ESP_OK) {
+        printf("generated program does not verify\n");
+        return 1;
+    }
+    logic_thread_stats_t stats;
+    if (logic_thread_compile(&program, &thread, &stats) != ESP_OK) {
+        printf("threading failed\n");
+        return 1;
+    }
+
+    // Inputs change every few scans, 1 ms per scan
+    static uint32_t inputs[SCANS];
+    for (int s = 0; s < SCANS; s++) {
+        inputs[s] = (s / 7) * 2654435761u >> 27;
+    }
+
+    int mismatches = 0;
+    logic_vm_reset(&vm_interp);
+    logic_vm_reset(&vm_thread);
+    logic_vm_reset(&vm_incremental);
+    for (int s = 0; s < SCANS; s++) {
+        uint32_t expect = logic_vm_exec(&vm_interp, &program, inputs[s], s);
+        uint32_t full = logic_thread_exec(&vm_thread, &program, &thread, inputs[s], s, true);
+        uint32_t incremental = logic_thread_exec(&vm_incremental, &program, &thread, inputs[s], s, s == 0);
+        mismatches += expect != full || memcmp(vm_interp.reg, vm_thread.reg, LOGIC_REG_TEMP) != 0;
+        mismatches += expect != incremental || memcmp(vm_interp.reg, vm_incremental.reg, LOGIC_REG_TEMP) != 0;
+    }
+
+    volatile uint32_t sink = 0;
+    logic_vm_reset(&vm_interp);
+    double start = now_s();
+    for (int s = 0; s < SCANS; s++) {
+        sink ^= logic_vm_exec(&vm_interp, &program, inputs[s], s);
+    }
+    double interp_us = (now_s() - start) / SCANS * 1e6;
+
+    logic_vm_reset(&vm_thread);
+    start = now_s();
+    for (int s = 0; s < SCANS; s++) {
+        sink ^= logic_thread_exec(&vm_thread, &program, &thread, inputs[s], s, true);
+    }
+    double thread_us = (now_s() - start) / SCANS * 1e6;
+
+    logic_vm_reset(&vm_incremental);
+    long evaluated = 0;
+    start = now_s();
+    for (int s = 0; s < SCANS; s++) {
+        sink ^= logic_thread_exec(&vm_incremental, &program, &thread, inputs[s], s, s == 0);
+        evaluated += vm_incremental.evaluated;
+    }
+    double incremental_us = (now_s() - start) / SCANS * 1e6;
+
+    printf("%d instructions -> %u threaded entries (%u folded, %u removed, %u fused, %lu bytes)\n",
+           program.count, stats.ops, stats.folded, stats.removed, stats.fused, (unsigned long)stats.code_bytes);
+    printf("interpreter %6.2f us/scan (%5.1f ns/insn)\n", interp_us, interp_us * 1000 / program.count);
+    printf("threaded    %6.2f us/scan (%5.1f ns/insn)\n", thread_us, thread_us * 1000 / program.count);
+    printf("incremental %6.2f us/scan (%ld of %u entries run on average)%s\n", incremental_us,
+           evaluated / SCANS, stats.ops, mismatches ? ", MISMATCH" : "");
+    return mismatches != 0;
+}
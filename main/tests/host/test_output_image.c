@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include "auto_board.h"
+#include "output_image.h"
+
+// Output image on the fake W1TS/W1TC registers (OUTPUT_IMAGE_FAKE_REG):
+// every apply must switch all of its changes with at most one W1TC and
+// one W1TS write, W1TC first (break before make), touch nothing else and
+// leave the register, the image and the requested state in agreement.
+
+#define RANDOM_APPLIES  100000
+
+// GPIOs that are not outputs, set before init to show they are never touched
+#define OTHER_GPIOS     ((1UL << 2) | (1UL << 4) | (1UL << 27))
+
+extern const gpio_num_t output_gpios[];
+
+static uint32_t gpio_mask = 0;
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL line %d: %s\n", __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static uint32_t rng_state = 0x6a09e667;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t to_gpio(uint32_t image)
+{
+    uint32_t bits = 0;
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        if (image & (1UL << i)) {
+            bits |= 1UL << output_gpios[i];
+        }
+    }
+    return bits;
+}
+
+// Apply and check the writes it made; returns false on the first bad one
+static bool apply_checked(uint32_t mask, uint32_t bits)
+{
+    uint32_t all = (1UL << NUM_OUTPUTS) - 1;
+    uint32_t before = output_image_get();
+    uint32_t after = (before & ~(mask & all)) | (bits & mask & all);
+    uint32_t turn_off = to_gpio(before & ~after);
+    uint32_t turn_on = to_gpio(after & ~before);
+
+    output_image_fake_write_count = 0;
+    output_image_apply(mask, bits);
+
+    uint32_t expected = (turn_off != 0) + (turn_on != 0);
+    bool ok = output_image_fake_write_count == expected;
+    uint32_t w = 0;
+    if (ok && turn_off) {
+        ok = !output_image_fake_writes[w].set && output_image_fake_writes[w].bits == turn_off;
+        w++;
+    }
+    if (ok && turn_on) {
+        ok = output_image_fake_writes[w].set && output_image_fake_writes[w].bits == turn_on;
+    }
+
+    return ok && output_image_get() == after &&
+           output_image_fake_out == (OTHER_GPIOS | to_gpio(after));
+}
+
+int main(void)
+{
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        gpio_mask |= 1UL << output_gpios[i];
+    }
+
+    // Init releases every output in one W1TC write
+    output_image_fake_out = OTHER_GPIOS | gpio_mask;
+    output_image_fake_write_count = 0;
+    output_image_init();
+    CHECK(output_image_fake_write_count == 1);
+    CHECK(!output_image_fake_writes[0].set && output_image_fake_writes[0].bits == gpio_mask);
+    CHECK(output_image_fake_out == OTHER_GPIOS);
+    CHECK(output_image_get() == 0);
+
+    // Star-delta changeover: star off and delta on in one apply, the
+    // release strictly before the drive
+    CHECK(apply_checked(0x1, 0x1));
+    CHECK(apply_checked(0x3, 0x2));
+    CHECK(output_image_get_state(1) && !output_image_get_state(0));
+
+    // No change, no write; outputs beyond NUM_OUTPUTS are ignored
+    CHECK(apply_checked(0x3, 0x2));
+    CHECK(apply_checked(UINT32_MAX << NUM_OUTPUTS, UINT32_MAX));
+    CHECK(apply_checked(UINT32_MAX, 0));
+
+    int bad = 0;
+    uint32_t writes = 0;
+    for (int n = 0; n < RANDOM_APPLIES; n++) {
+        uint32_t r = rng();
+        if (!apply_checked(r, r >> 8)) {
+            bad++;
+        }
+        writes += output_image_fake_write_count;
+    }
+    CHECK(bad == 0);
+    printf("%d outputs on GPIO mask 0x%08lx, %d random applies, %lu register writes, %d bad\n",
+           NUM_OUTPUTS, (unsigned long)gpio_mask, RANDOM_APPLIES, (unsigned long)writes, bad);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include "time_base.h"
+
+// Fast-forwards the fake clock across every 32-bit wrap the old code had:
+// esp_timer microseconds (~71.6 minutes), milliseconds and RTOS ticks
+// (~49.7 days). Deadlines set just before a wrap must still expire on
+// time and report the right remaining time on the far side of it.
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL line %d: %s at t=%" PRId64 " us\n", __LINE__, #cond, (int64_t)time_base_fake_us); \
+            failures++; \
+        } \
+    } while (0)
+
+// 'unit_us' is one count of the 32-bit counter that wraps at 'wrap_us'
+static void check_deadline_across(const char *name, int64_t unit_us)
+{
+    int64_t wrap_us = unit_us << 32;
+
+    // 1.5 s deadline set 1 s before the wrap
+    time_base_fake_us = wrap_us - 1000000;
+    int64_t start_ms = time_base_now_ms();
+    int64_t start_ticks = time_base_now_ticks();
+    time_deadline_t deadline = time_deadline_in_ms(1500);
+
+    CHECK(!time_deadline_passed(deadline));
+    CHECK(time_deadline_remaining_ms(deadline) == 1500);
+    CHECK(time_deadline_remaining_ticks(deadline) == pdMS_TO_TICKS(1500));
+
+    // Step through the wrap 1 ms at a time
+    int64_t fired_us = 0;
+    for (int step = 0; step < 2000 && fired_us == 0; step++) {
+        time_base_fake_us += 1000;
+        CHECK(time_base_now_ms() > start_ms);
+        CHECK(time_base_now_ticks() >= start_ticks);
+        if (time_deadline_passed(deadline)) {
+            fired_us = time_base_fake_us;
+        } else {
+            CHECK(time_deadline_remaining_ms(deadline) <= 1500);
+        }
+    }
+    CHECK(fired_us - (wrap_us - 1000000) == 1500000);
+    CHECK(time_deadline_remaining_us(deadline) == 0);
+    CHECK(time_deadline_remaining_ticks(deadline) == 0);
+    CHECK(time_base_since_us(wrap_us - 1000000) == 1500000);
+
+    // What the old 32-bit timestamps did at the same point
+    uint32_t old_start = (uint32_t)((wrap_us - 1000000) / unit_us);
+    uint32_t old_now = (uint32_t)(time_base_fake_us / unit_us);
+    printf("%-22s fired after %" PRId64 " ms; the 32-bit count went %" PRIu32 " -> %" PRIu32 "\n",
+           name, (fired_us - (wrap_us - 1000000)) / 1000, old_start, old_now);
+}
+
+int main(void)
+{
+    check_deadline_across("32-bit microseconds", 1);
+    check_deadline_across("32-bit milliseconds", 1000);
+    check_deadline_across("32-bit RTOS ticks", TIME_BASE_US_PER_TICK);
+
+    // Ten years of uptime still round-trips
+    time_base_fake_us = 10LL * 365 * 24 * 3600 * 1000000;
+    time_deadline_t deadline = time_deadline_in_ms(UINT32_MAX);
+    CHECK(time_deadline_remaining_ms(deadline) == UINT32_MAX);
+    CHECK(time_deadline_remaining_ticks(deadline) == portMAX_DELAY - 1);
+    time_base_fake_us = deadline;
+    CHECK(time_deadline_passed(deadline));
+
+    printf("%s\n", failures ? "FAILED" : "all deadlines on time");
+    return failures != 0;
+}
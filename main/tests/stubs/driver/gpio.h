@@ -0,0 +1,24 @@
+#ifndef GPIO_H
+#define GPIO_H
+
+// Host stub: pin numbers only, for the definitions in auto_board.h
+
+#include "esp_err.h"
+#include "esp_attr.h"
+
+typedef int gpio_num_t;
+
+#define GPIO_NUM_2      2
+#define GPIO_NUM_4      4
+#define GPIO_NUM_5      5
+#define GPIO_NUM_12     12
+#define GPIO_NUM_13     13
+#define GPIO_NUM_14     14
+#define GPIO_NUM_18     18
+#define GPIO_NUM_19     19
+#define GPIO_NUM_21     21
+#define GPIO_NUM_25     25
+#define GPIO_NUM_26     26
+#define GPIO_NUM_27     27
+
+#endif // GPIO_H
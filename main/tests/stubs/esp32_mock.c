@@ -0,0 +1,265 @@
+#include <string.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+
+// Host fakes for the ESP-IDF and FreeRTOS calls the modules under test
+// make. Tests are single-threaded, so mutexes always succeed and a task
+// notification is dropped.
+
+// Driven by the tests, see time_base.h
+volatile int64_t time_base_fake_us = 0;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    return code == ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    static int dummy;
+    return (SemaphoreHandle_t)&dummy;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    (void)sem;
+    (void)ticks;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    (void)sem;
+    return pdTRUE;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    time_base_fake_us += (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(time_base_fake_us / (portTICK_PERIOD_MS * 1000));
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    (void)task;
+    (void)value;
+    (void)action;
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *woken)
+{
+    (void)woken;
+    return xTaskNotify(task, value, action);
+}
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    (void)name;
+    return NULL;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    (void)task;
+    return 0;
+}
+
+// esp_timer on the fake clock: a few timers, fired by esp_timer_fake_advance()
+#define MOCK_TIMERS         8
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    bool used;
+    bool running;
+    int64_t due_us;
+    uint64_t period_us;     // 0 for one-shot
+};
+
+static struct esp_timer timers[MOCK_TIMERS];
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle)
+{
+    for (int i = 0; i < MOCK_TIMERS; i++) {
+        if (!timers[i].used) {
+            timers[i] = (struct esp_timer){ .callback = args->callback, .arg = args->arg, .used = true };
+            *out_handle = &timers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    if (timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->running = true;
+    timer->due_us = time_base_fake_us + (int64_t)timeout_us;
+    timer->period_us = period_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    return timer_start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->running = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (timer->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->used = false;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return time_base_fake_us;
+}
+
+static struct esp_timer *next_timer(void)
+{
+    struct esp_timer *next = NULL;
+    for (int i = 0; i < MOCK_TIMERS; i++) {
+        if (timers[i].running && (next == NULL || timers[i].due_us < next->due_us)) {
+            next = &timers[i];
+        }
+    }
+    return next;
+}
+
+int64_t esp_timer_fake_next_due(void)
+{
+    struct esp_timer *next = next_timer();
+    return next != NULL ? next->due_us : INT64_MAX;
+}
+
+void esp_timer_fake_advance(int64_t until_us)
+{
+    struct esp_timer *timer;
+    while ((timer = next_timer()) != NULL && timer->due_us <= until_us) {
+        time_base_fake_us = timer->due_us;
+        if (timer->period_us != 0) {
+            timer->due_us += (int64_t)timer->period_us;
+        } else {
+            timer->running = false;
+        }
+        timer->callback(timer->arg);
+    }
+    if (until_us > time_base_fake_us) {
+        time_base_fake_us = until_us;
+    }
+}
+
+// In-memory NVS: a few keys, namespaces ignored
+#define MOCK_NVS_KEYS       8
+#define MOCK_NVS_BLOB       4096
+
+static struct {
+    char key[16];
+    size_t length;
+    uint8_t data[MOCK_NVS_BLOB];
+} nvs_keys[MOCK_NVS_KEYS];
+
+static int nvs_find(const char *key, bool create)
+{
+    for (int i = 0; i < MOCK_NVS_KEYS; i++) {
+        if (nvs_keys[i].key[0] != '\0' && strncmp(nvs_keys[i].key, key, sizeof(nvs_keys[i].key)) == 0) {
+            return i;
+        }
+    }
+    for (int i = 0; create && i < MOCK_NVS_KEYS; i++) {
+        if (nvs_keys[i].key[0] == '\0') {
+            strncpy(nvs_keys[i].key, key, sizeof(nvs_keys[i].key) - 1);
+            return i;
+        }
+    }
+    return -1;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle)
+{
+    (void)name;
+    (void)mode;
+    *handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    (void)handle;
+    int i = nvs_find(key, false);
+    if (i < 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    nvs_keys[i].key[0] = '\0';
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out, size_t *length)
+{
+    (void)handle;
+    int i = nvs_find(key, false);
+    if (i < 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out == NULL) {
+        *length = nvs_keys[i].length;
+        return ESP_OK;
+    }
+    if (*length < nvs_keys[i].length) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out, nvs_keys[i].data, nvs_keys[i].length);
+    *length = nvs_keys[i].length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    (void)handle;
+    int i = nvs_find(key, true);
+    if (i < 0 || length > MOCK_NVS_BLOB) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(nvs_keys[i].data, value, length);
+    nvs_keys[i].length = length;
+    return ESP_OK;
+}
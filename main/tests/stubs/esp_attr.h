@@ -0,0 +1,12 @@
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+// Host stub: placement attributes mean nothing off target
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define NOINIT_ATTR
+
+#endif // ESP_ATTR_H
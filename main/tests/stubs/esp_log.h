@@ -0,0 +1,27 @@
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+// Host stub: logging goes to stderr with HOST_TEST_VERBOSE, nowhere otherwise
+
+#include <stdio.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_LOG_NONE, ESP_LOG_ERROR, ESP_LOG_WARN, ESP_LOG_INFO, ESP_LOG_DEBUG, ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+#ifdef HOST_TEST_VERBOSE
+#define HOST_LOG(tag, fmt, ...)         fprintf(stderr, "%s: " fmt "\n", tag, ##__VA_ARGS__)
+#else
+#define HOST_LOG(tag, fmt, ...)         do { (void)(tag); } while (0)
+#endif
+
+#define ESP_LOGE(tag, fmt, ...)         HOST_LOG(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...)         HOST_LOG(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...)         HOST_LOG(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...)         HOST_LOG(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...)         HOST_LOG(tag, fmt, ##__VA_ARGS__)
+#define ESP_EARLY_LOGW(tag, fmt, ...)   HOST_LOG(tag, fmt, ##__VA_ARGS__)
+#define ESP_DRAM_LOGW(tag, fmt, ...)    HOST_LOG(tag, fmt, ##__VA_ARGS__)
+
+#endif // ESP_LOG_H
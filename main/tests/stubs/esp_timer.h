@@ -0,0 +1,40 @@
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+// Host stub: timers run on time_base_fake_us. Nothing fires by itself; a
+// test moves the clock with esp_timer_fake_advance() and the timers due on
+// the way run their callbacks.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+int64_t esp_timer_get_time(void);
+
+// Expiry of the earliest running timer, INT64_MAX when none is running
+int64_t esp_timer_fake_next_due(void);
+// Move time_base_fake_us forward to 'until_us', firing every timer due on the way
+void esp_timer_fake_advance(int64_t until_us);
+
+#endif // ESP_TIMER_H
@@ -0,0 +1,38 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+// Host stub: the types and macros the modules under test use. Everything
+// runs in one thread, so critical sections are no-ops.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_attr.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define pdTRUE                          1
+#define pdFALSE                         0
+#define pdPASS                          pdTRUE
+#define pdFAIL                          pdFALSE
+#define portMAX_DELAY                   0xffffffffu
+#define configTICK_RATE_HZ              1000
+#define portTICK_PERIOD_MS              (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)               ((TickType_t)(ms) * configTICK_RATE_HZ / 1000)
+#define portYIELD_FROM_ISR(...)         do { } while (0)
+
+typedef struct {
+    uint32_t owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define portENTER_CRITICAL(mux)         do { (void)(mux); } while (0)
+#define portEXIT_CRITICAL(mux)          do { (void)(mux); } while (0)
+#define portENTER_CRITICAL_ISR(mux)     do { (void)(mux); } while (0)
+#define portEXIT_CRITICAL_ISR(mux)      do { (void)(mux); } while (0)
+#define portENTER_CRITICAL_SAFE(mux)    do { (void)(mux); } while (0)
+#define portEXIT_CRITICAL_SAFE(mux)     do { (void)(mux); } while (0)
+
+#endif // FREERTOS_H
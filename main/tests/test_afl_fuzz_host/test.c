@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "logic_st.h"
+#include "logic_thread.h"
+#include "timer_wheel.h"
+#include "scan_cycle.h"
+
+// Reads one structured-text source from stdin and compiles it. A program
+// that compiles is then run through the interpreter and the threaded code
+// side by side; any difference aborts, so AFL records it as a crash.
+
+#define MAX_SOURCE      8192
+#define SCANS           16
+
+static char source[MAX_SOURCE];
+static logic_program_t program;
+static logic_thread_t thread;
+static logic_vm_t vm_ref;
+static logic_vm_t vm_thread;
+
+// The scan asks these modules to wake it; nothing to do on the host
+timer_wheel_handle_t timer_wheel_add(uint32_t delay_ms, timer_wheel_cb_t cb, void *arg)
+{
+    (void)delay_ms;
+    (void)cb;
+    (void)arg;
+    return 1;
+}
+
+bool timer_wheel_cancel(timer_wheel_handle_t handle)
+{
+    (void)handle;
+    return true;
+}
+
+void scan_cycle_notify(uint32_t event)
+{
+    (void)event;
+}
+
+int main(void)
+{
+    size_t len = 0;
+    ssize_t n;
+    while (len < sizeof(source) && (n = read(STDIN_FILENO, source + len, sizeof(source) - len)) > 0) {
+        len += n;
+    }
+
+    // Compile straight from a heap copy of the exact size, so reading past
+    // the end is caught without a terminator to stop at
+    char *src = malloc(len ? len : 1);
+    memcpy(src, source, len);
+    char err[96] = "";
+    esp_err_t ret = logic_st_compile(src, len, &program, err, sizeof(err));
+    free(src);
+#ifdef INSTR_IS_OFF
+    printf("compile: %s%s%s\n", ret == ESP_OK ? "ok" : "error", ret == ESP_OK ? "" : ", ", err);
+#endif
+    if (ret != ESP_OK) {
+        return 0;
+    }
+
+    logic_thread_stats_t stats;
+    if (logic_thread_compile(&program, &thread, &stats) != ESP_OK) {
+        abort();            // A verified program always threads
+    }
+
+    logic_vm_reset(&vm_ref);
+    logic_vm_reset(&vm_thread);
+    int64_t now_ms = 0;
+    for (int scan = 0; scan < SCANS; scan++) {
+        // Input patterns and time steps come from the source bytes, so
+        // AFL can steer them too
+        uint8_t seed = len ? (uint8_t)source[scan % len] : 0;
+        uint32_t inputs = seed ^ (uint32_t)scan;
+        now_ms += (seed & 0x0f) * 250;
+
+        uint32_t expect = logic_vm_exec(&vm_ref, &program, inputs, now_ms);
+        uint32_t got = logic_thread_exec(&vm_thread, &program, &thread, inputs, now_ms, scan == 0);
+        if (expect != got) {
+            fprintf(stderr, "scan %d: interpreter 0x%08x, threaded 0x%08x\n", scan, (unsigned)expect, (unsigned)got);
+            abort();
+        }
+    }
+#ifdef INSTR_IS_OFF
+    printf("%d instructions, %d threaded entries, %d scans agree\n", program.count, stats.ops, SCANS);
+#endif
+    return 0;
+}
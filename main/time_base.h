@@ -0,0 +1,81 @@
+#ifndef TIME_BASE_H
+#define TIME_BASE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+
+// Shared monotonic time base. Everything is kept as signed 64-bit
+// microseconds since boot (esp_timer), which does not wrap for ~292,000
+// years; milliseconds and RTOS ticks are derived from it rather than
+// stored in 32 bits, so nothing overflows after 49.7 days of uptime.
+//
+// Deadlines are absolute time_base_now_us() values. Host builds define
+// TIME_BASE_FAKE_CLOCK and drive time_base_fake_us to fast-forward time.
+
+#ifdef TIME_BASE_FAKE_CLOCK
+extern volatile int64_t time_base_fake_us;
+#define TIME_BASE_READ_US()     (time_base_fake_us)
+#else
+#include "esp_timer.h"
+#define TIME_BASE_READ_US()     esp_timer_get_time()
+#endif
+
+#define TIME_BASE_US_PER_TICK   (1000000 / configTICK_RATE_HZ)
+
+typedef int64_t time_deadline_t;
+
+// Safe from ISRs and IRAM code
+static inline int64_t IRAM_ATTR time_base_now_us(void)
+{
+    return TIME_BASE_READ_US();
+}
+
+static inline int64_t time_base_now_ms(void)
+{
+    return time_base_now_us() / 1000;
+}
+
+// RTOS ticks since boot, without xTaskGetTickCount()'s 32-bit wrap
+static inline int64_t time_base_now_ticks(void)
+{
+    return time_base_now_us() / TIME_BASE_US_PER_TICK;
+}
+
+static inline int64_t time_base_since_us(int64_t then_us)
+{
+    return time_base_now_us() - then_us;
+}
+
+static inline time_deadline_t time_deadline_in_ms(uint32_t delay_ms)
+{
+    return time_base_now_us() + (int64_t)delay_ms * 1000;
+}
+
+static inline bool time_deadline_passed(time_deadline_t deadline)
+{
+    return time_base_now_us() >= deadline;
+}
+
+static inline int64_t time_deadline_remaining_us(time_deadline_t deadline)
+{
+    int64_t remaining = deadline - time_base_now_us();
+    return remaining > 0 ? remaining : 0;
+}
+
+// Rounded up, so a deadline 1 us away still reports 1 ms left
+static inline uint32_t time_deadline_remaining_ms(time_deadline_t deadline)
+{
+    int64_t remaining_ms = (time_deadline_remaining_us(deadline) + 999) / 1000;
+    return remaining_ms < UINT32_MAX ? (uint32_t)remaining_ms : UINT32_MAX;
+}
+
+// For vTaskDelay() and friends, rounded up and capped below portMAX_DELAY
+static inline TickType_t time_deadline_remaining_ticks(time_deadline_t deadline)
+{
+    int64_t ticks = (time_deadline_remaining_us(deadline) + TIME_BASE_US_PER_TICK - 1) / TIME_BASE_US_PER_TICK;
+    return ticks < (int64_t)portMAX_DELAY ? (TickType_t)ticks : portMAX_DELAY - 1;
+}
+
+#endif // TIME_BASE_H
@@ -0,0 +1,267 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "timer_wheel.h"
+
+// Fallback definition for IntelliSense
+#ifndef CONFIG_LOG_MAXIMUM_LEVEL
+#define CONFIG_LOG_MAXIMUM_LEVEL ESP_LOG_VERBOSE
+#endif
+
+static const char *TAG = "TIMER_WHEEL";
+
+#define L0_BITS     8
+#define LN_BITS     6
+#define L0_SIZE     (1 << L0_BITS)
+#define LN_SIZE     (1 << LN_BITS)
+#define L0_MASK     (L0_SIZE - 1)
+#define LN_MASK     (LN_SIZE - 1)
+#define LEVELS      4
+#define NUM_SLOTS   (L0_SIZE + (LEVELS - 1) * LN_SIZE)
+
+// Slot of level n (n >= 1) that the current tick falls in
+#define LN_INDEX(now, n)    (((now) >> (L0_BITS + ((n) - 1) * LN_BITS)) & LN_MASK)
+
+#define NIL         (-1)
+
+typedef struct {
+    int16_t prev;
+    int16_t next;
+    uint16_t slot;          // List the entry is on
+    uint16_t generation;    // Bumped on release so stale handles miss
+    bool in_use;
+    uint32_t expires;       // Absolute tick
+    timer_wheel_cb_t callback;
+    void *arg;
+} wheel_entry_t;
+
+static wheel_entry_t entries[TIMER_WHEEL_MAX_TIMERS];
+static int16_t slots[NUM_SLOTS];            // Head of each slot list
+static int16_t free_list = NIL;
+static uint32_t active_count = 0;
+
+// Next tick to be processed
+static uint32_t wheel_now = 0;
+
+static esp_timer_handle_t tick_timer = NULL;
+static bool tick_running = false;
+
+// add/cancel come from tasks, ticks from the esp_timer task
+static portMUX_TYPE wheel_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline timer_wheel_handle_t make_handle(int index)
+{
+    return ((uint32_t)entries[index].generation << 8) | (uint32_t)(index + 1);
+}
+
+static inline int handle_index(timer_wheel_handle_t handle)
+{
+    int index = (int)(handle & 0xFF) - 1;
+    if (index < 0 || index >= TIMER_WHEEL_MAX_TIMERS ||
+        !entries[index].in_use || entries[index].generation != (uint16_t)(handle >> 8)) {
+        return NIL;
+    }
+    return index;
+}
+
+static void list_push(uint16_t slot, int index)
+{
+    wheel_entry_t *e = &entries[index];
+    e->slot = slot;
+    e->prev = NIL;
+    e->next = slots[slot];
+    if (slots[slot] != NIL) {
+        entries[slots[slot]].prev = index;
+    }
+    slots[slot] = index;
+}
+
+static void list_unlink(int index)
+{
+    wheel_entry_t *e = &entries[index];
+    if (e->prev != NIL) {
+        entries[e->prev].next = e->next;
+    } else {
+        slots[e->slot] = e->next;
+    }
+    if (e->next != NIL) {
+        entries[e->next].prev = e->prev;
+    }
+}
+
+// Pick the slot from how far away the expiry is, relative to wheel_now
+static void wheel_insert(int index)
+{
+    uint32_t expires = entries[index].expires;
+    int32_t delta = (int32_t)(expires - wheel_now);
+    uint16_t slot;
+
+    if (delta < 0) {
+        slot = wheel_now & L0_MASK;
+    } else if (delta < L0_SIZE) {
+        slot = expires & L0_MASK;
+    } else if (delta < (1L << (L0_BITS + LN_BITS))) {
+        slot = L0_SIZE + LN_INDEX(expires, 1);
+    } else if (delta < (1L << (L0_BITS + 2 * LN_BITS))) {
+        slot = L0_SIZE + LN_SIZE + LN_INDEX(expires, 2);
+    } else {
+        slot = L0_SIZE + 2 * LN_SIZE + LN_INDEX(expires, 3);
+    }
+    list_push(slot, index);
+}
+
+// Move every timer of one upper-level slot down to where it now belongs
+static uint32_t cascade(int level, uint32_t index)
+{
+    uint16_t slot = L0_SIZE + (level - 1) * LN_SIZE + index;
+    int16_t entry = slots[slot];
+    slots[slot] = NIL;
+
+    while (entry != NIL) {
+        int16_t next = entries[entry].next;
+        wheel_insert(entry);
+        entry = next;
+    }
+    return index;
+}
+
+static void release_entry(int index)
+{
+    entries[index].in_use = false;
+    entries[index].generation++;
+    entries[index].next = free_list;
+    free_list = index;
+    active_count--;
+}
+
+static void tick_callback(void *arg)
+{
+    timer_wheel_cb_t callbacks[TIMER_WHEEL_MAX_TIMERS];
+    void *args[TIMER_WHEEL_MAX_TIMERS];
+    timer_wheel_handle_t handles[TIMER_WHEEL_MAX_TIMERS];
+    int fired = 0;
+
+    portENTER_CRITICAL(&wheel_lock);
+    uint32_t index = wheel_now & L0_MASK;
+    if (index == 0 &&
+        cascade(1, LN_INDEX(wheel_now, 1)) == 0 &&
+        cascade(2, LN_INDEX(wheel_now, 2)) == 0) {
+        cascade(3, LN_INDEX(wheel_now, 3));
+    }
+    wheel_now++;
+
+    // Everything left on this level-0 slot is due now
+    int16_t entry = slots[index];
+    slots[index] = NIL;
+    while (entry != NIL) {
+        int16_t next = entries[entry].next;
+        callbacks[fired] = entries[entry].callback;
+        args[fired] = entries[entry].arg;
+        handles[fired] = make_handle(entry);
+        fired++;
+        release_entry(entry);
+        entry = next;
+    }
+
+    if (active_count == 0 && tick_running) {
+        esp_timer_stop(tick_timer);
+        tick_running = false;
+    }
+    portEXIT_CRITICAL(&wheel_lock);
+
+    // Callbacks may add or cancel timers, so they run unlocked
+    for (int i = 0; i < fired; i++) {
+        callbacks[i](handles[i], args[i]);
+    }
+}
+
+esp_err_t timer_wheel_init(void)
+{
+    for (int i = 0; i < NUM_SLOTS; i++) {
+        slots[i] = NIL;
+    }
+    free_list = NIL;
+    for (int i = TIMER_WHEEL_MAX_TIMERS - 1; i >= 0; i--) {
+        memset(&entries[i], 0, sizeof(entries[i]));
+        entries[i].next = free_list;
+        free_list = i;
+    }
+    active_count = 0;
+
+    esp_timer_create_args_t timer_args = {
+        .callback = tick_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "timer_wheel"
+    };
+
+    esp_err_t ret = esp_timer_create(&timer_args, &tick_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create wheel tick: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Timing wheel ready (%d ms tick, %d timers)", TIMER_WHEEL_TICK_MS, TIMER_WHEEL_MAX_TIMERS);
+    return ESP_OK;
+}
+
+timer_wheel_handle_t timer_wheel_add(uint32_t delay_ms, timer_wheel_cb_t callback, void *arg)
+{
+    // Round up so the timer fires on the tick that ends the delay
+    uint32_t ticks = (delay_ms + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    if (ticks > TIMER_WHEEL_MAX_TICKS || callback == NULL || tick_timer == NULL) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&wheel_lock);
+    int index = free_list;
+    if (index == NIL) {
+        portEXIT_CRITICAL(&wheel_lock);
+        return 0;
+    }
+    free_list = entries[index].next;
+
+    // The tick only runs while something is armed; starting it here
+    // makes the first tick land exactly one period after this call. A
+    // running tick is already part way through its period, so that
+    // partial period does not count towards the delay.
+    bool start_tick = !tick_running;
+    tick_running = true;
+
+    wheel_entry_t *e = &entries[index];
+    e->in_use = true;
+    e->callback = callback;
+    e->arg = arg;
+    e->expires = wheel_now + ticks - (start_tick ? 1 : 0);
+    wheel_insert(index);
+    active_count++;
+    timer_wheel_handle_t handle = make_handle(index);
+    portEXIT_CRITICAL(&wheel_lock);
+
+    if (start_tick) {
+        esp_timer_start_periodic(tick_timer, TIMER_WHEEL_TICK_MS * 1000);
+    }
+    return handle;
+}
+
+bool timer_wheel_cancel(timer_wheel_handle_t handle)
+{
+    portENTER_CRITICAL(&wheel_lock);
+    int index = handle_index(handle);
+    if (index != NIL) {
+        list_unlink(index);
+        release_entry(index);
+    }
+    portEXIT_CRITICAL(&wheel_lock);
+
+    return index != NIL;
+}
+
+uint32_t timer_wheel_active_count(void)
+{
+    return active_count;
+}
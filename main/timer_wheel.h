@@ -0,0 +1,35 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Hierarchical timing wheel driven by a single periodic esp_timer.
+//
+// Level 0 has 256 slots of one tick, levels 1-3 have 64 slots each
+// covering 256, 16384 and 1048576 ticks; timers on an upper level are
+// cascaded down as the wheel turns. Insert and cancel are O(1).
+// A timer fires on the first tick at or after the end of its delay, so
+// it is never early and at most one tick (10 ms) late.
+
+#define TIMER_WHEEL_TICK_MS     10
+#define TIMER_WHEEL_MAX_TIMERS  32
+#define TIMER_WHEEL_MAX_TICKS   ((1UL << 26) - 1)      // ~7.7 days at 10 ms
+#define TIMER_WHEEL_MAX_MS      ((uint64_t)TIMER_WHEEL_MAX_TICKS * TIMER_WHEEL_TICK_MS)
+
+// Handle of a running timer; 0 is never a valid handle
+typedef uint32_t timer_wheel_handle_t;
+
+// Runs in the esp_timer task, without the wheel lock held
+typedef void (*timer_wheel_cb_t)(timer_wheel_handle_t handle, void *arg);
+
+// Function prototypes
+esp_err_t timer_wheel_init(void);
+// One-shot timer after delay_ms; returns 0 when the pool is full
+timer_wheel_handle_t timer_wheel_add(uint32_t delay_ms, timer_wheel_cb_t callback, void *arg);
+// Returns false if the timer already fired or was cancelled
+bool timer_wheel_cancel(timer_wheel_handle_t handle);
+uint32_t timer_wheel_active_count(void);
+
+#endif // TIMER_WHEEL_H
@@ -1,6 +1,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
@@ -17,6 +18,28 @@
 #include "web_server.h"
 #include "auto_board.h"
 #include "wifi_config.h"
+#include "input_ring.h"
+#include "input_debounce.h"
+#include "scan_cycle.h"
+#include "timer_wheel.h"
+#include "output_timer.h"
+#include "input_counter.h"
+#include "edge_capture.h"
+#include "input_storm.h"
+#include "input_profile.h"
+#include "hotpath_audit.h"
+#include "output_image.h"
+#include "output_sched.h"
+#include "output_duty.h"
+#include "output_guard.h"
+#include "output_arbiter.h"
+#include "schedule.h"
+#include "retain.h"
+#include "logic_vm.h"
+#include "logic_rules.h"
+#include "logic_st.h"
+#include "io_map.h"
+#include "time_base.h"
 
 static const char *TAG = "WEB_SERVER";
 
@@ -26,14 +49,21 @@ const char* WIFI_PASS = "YOUR_WIFI_PASSWORD";
 
 // Global variables
 static httpd_handle_t server = NULL;
-static output_timer_t output_timers[NUM_OUTPUTS];
-extern bool output_states[];
 extern const gpio_num_t output_gpios[];  // Declare external GPIO array
 
-// Manual control flags - when true, disable automatic input-to-output logic
-static bool manual_control_active[NUM_OUTPUTS] = {false};
-static uint32_t manual_control_timeout[NUM_OUTPUTS] = {0};
-#define MANUAL_CONTROL_TIMEOUT_MS 300000  // 5 minutes timeout for manual control
+// Manual control is a claim in the arbiter's MANUAL slot; the deadline
+// of each claim lives here, guarded by manual_lock
+static time_deadline_t manual_control_deadline[NUM_OUTPUTS] = {0};
+static portMUX_TYPE manual_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// One-shot timer armed for the next manual-control expiry
+static esp_timer_handle_t deadline_timer = NULL;
+static void schedule_output_deadline(void);
+static void deadline_timer_callback(void *arg);
+#define CAPTURE_BATCH 16                   // Edges per chunk of the /api/capture dump
+#define SCHEDULE_MAX_BODY 2048             // Largest accepted /api/schedule body
+#define LOGIC_MAX_BODY 16384               // Largest accepted /api/logic body
+#define IO_MAP_MAX_BODY 4096               // Largest accepted /api/iomap body
 
 // Simple HTML page with enhanced interactivity
 static const char* simple_html_page = 
@@ -303,9 +333,23 @@ static esp_err_t status_handler(httpd_req_t *req);
 static esp_err_t toggle_handler(httpd_req_t *req);
 static esp_err_t timer_handler(httpd_req_t *req);
 static esp_err_t cancel_timer_handler(httpd_req_t *req);
+static esp_err_t duty_handler(httpd_req_t *req);
 static esp_err_t settings_handler(httpd_req_t *req);
 static esp_err_t wifi_connect_handler(httpd_req_t *req);
 static esp_err_t wifi_reset_handler(httpd_req_t *req);
+static esp_err_t capture_handler(httpd_req_t *req);
+static esp_err_t input_config_get_handler(httpd_req_t *req);
+static esp_err_t input_config_set_handler(httpd_req_t *req);
+static esp_err_t audit_handler(httpd_req_t *req);
+static esp_err_t schedule_get_handler(httpd_req_t *req);
+static esp_err_t schedule_set_handler(httpd_req_t *req);
+static esp_err_t time_set_handler(httpd_req_t *req);
+static esp_err_t retain_get_handler(httpd_req_t *req);
+static esp_err_t retain_set_handler(httpd_req_t *req);
+static esp_err_t logic_get_handler(httpd_req_t *req);
+static esp_err_t logic_set_handler(httpd_req_t *req);
+static esp_err_t iomap_get_handler(httpd_req_t *req);
+static esp_err_t iomap_set_handler(httpd_req_t *req);
 
 // Helper function to get client IP address (simplified for ESP-IDF compatibility)
 static const char* get_client_ip(httpd_req_t *req)
@@ -398,21 +442,13 @@ esp_err_t init_wifi_station(void)
     ESP_ERROR_CHECK(esp_wifi_start());
 
     ESP_LOGI(TAG, "WiFi initialization completed. Connecting to %s...", WIFI_SSID);
-    
-    // Initialize timers
-    for (int i = 0; i < NUM_OUTPUTS; i++) {
-        output_timers[i].is_active = false;
-        output_timers[i].start_time = 0;
-        output_timers[i].duration_minutes = 0;
-        output_timers[i].output_num = i;
-    }
 
     return ESP_OK;
 }
 
 static esp_err_t root_handler(httpd_req_t *req)
 {
-    uint32_t start_time = esp_timer_get_time() / 1000; // microseconds to milliseconds
+    int64_t start_us = time_base_now_us();
     ESP_LOGI(TAG, "Root handler called");
     
     // Check available memory
@@ -437,15 +473,20 @@ static esp_err_t root_handler(httpd_req_t *req)
     }
     
     // Send each output block
+    uint32_t output_bits = output_image_get();
     for (int i = 0; i < NUM_OUTPUTS; i++) {
-        const char* status_class = output_states[i] ? "on" : "off";
-        const char* status_text = output_states[i] ? "ACTIVE" : "INACTIVE";
-        const char* button_class = output_states[i] ? "btn-off" : "btn-on";
-        const char* button_text = output_states[i] ? "Turn OFF" : "Turn ON";
+        bool is_on = (output_bits & (1UL << i)) != 0;
+        const char* status_class = is_on ? "on" : "off";
+        const char* status_text = is_on ? "ACTIVE" : "INACTIVE";
+        const char* button_class = is_on ? "btn-off" : "btn-on";
+        const char* button_text = is_on ? "Turn OFF" : "Turn ON";
+        
+        output_timer_info_t timer;
+        output_timer_get_info(i, &timer);
         
         char timer_info[100] = "";
-        if (output_timers[i].is_active) {
-            uint32_t remaining = get_remaining_timer_minutes(i);
+        if (timer.count > 0) {
+            uint32_t remaining = (timer.next_remaining_ms + 59999) / 60000;
             snprintf(timer_info, sizeof(timer_info), "<p>Timer: %lu min remaining</p>", remaining);
         }
         
@@ -491,7 +532,7 @@ static esp_err_t root_handler(httpd_req_t *req)
             status_class, // status class
             status_text, // status text
             i + 1, // timer-info id
-            output_timers[i].is_active ? "display:block" : "display:none", // timer visibility
+            timer.count > 0 ? "display:block" : "display:none", // timer visibility
             timer_info, // timer info text
             i + 1, // button id
             button_class, // button class
@@ -530,8 +571,7 @@ static esp_err_t root_handler(httpd_req_t *req)
     // End chunked response
     ret = httpd_resp_send_chunk(req, NULL, 0);
     
-    uint32_t end_time = esp_timer_get_time() / 1000;
-    uint32_t response_time = end_time - start_time;
+    uint32_t response_time = (uint32_t)(time_base_since_us(start_us) / 1000);
     
     ESP_LOGI(TAG, "=== TOTAL HTTP RESPONSE SIZE: %zu bytes ===", total_response_size);
     ESP_LOGI(TAG, "=== RESPONSE TIME: %lu ms ===", response_time);
@@ -554,13 +594,38 @@ static esp_err_t status_handler(httpd_req_t *req)
     for (int i = 0; i < NUM_OUTPUTS; i++) {
         cJSON *output = cJSON_CreateObject();
         cJSON_AddNumberToObject(output, "id", i + 1);
-        cJSON_AddBoolToObject(output, "state", output_states[i]);
-        cJSON_AddBoolToObject(output, "timer_active", output_timers[i].is_active);
+        cJSON_AddBoolToObject(output, "state", output_image_get_state(i));
+        output_timer_info_t timer;
+        output_timer_get_info(i, &timer);
+        cJSON_AddBoolToObject(output, "timer_active", timer.count > 0);
+        cJSON_AddNumberToObject(output, "timers", timer.count);
+        cJSON_AddBoolToObject(output, "timer_holding", timer.holding);
+        cJSON_AddNumberToObject(output, "timer_remaining_ms", timer.next_remaining_ms);
+        
+        output_duty_config_t duty;
+        output_duty_get(i, &duty);
+        cJSON_AddStringToObject(output, "mode", output_duty_mode_name(duty.mode));
+        cJSON_AddNumberToObject(output, "duty", duty.duty_permille / 10.0);
+        cJSON_AddNumberToObject(output, "cycle_s", duty.cycle_s);
+        
+        cJSON_AddStringToObject(output, "owner", output_arbiter_level_name(output_arbiter_get_owner(i)));
+        
+        output_guard_info_t guard;
+        output_guard_get_info(i, &guard);
+        cJSON_AddStringToObject(output, "held_by", output_guard_reason_name(guard.reason));
+        if (guard.reason != OUTPUT_GUARD_NONE) {
+            cJSON_AddBoolToObject(output, "held_state", guard.wanted);
+            cJSON_AddNumberToObject(output, "held_ms", guard.wait_ms);
+        }
+        cJSON *delays = cJSON_CreateObject();
+        for (int r = OUTPUT_GUARD_MIN_ON; r < OUTPUT_GUARD_REASON_COUNT; r++) {
+            cJSON_AddNumberToObject(delays, output_guard_reason_name(r), guard.delayed[r]);
+        }
+        cJSON_AddItemToObject(output, "guard_delays", delays);
         
-        if (output_timers[i].is_active) {
-            uint32_t remaining = get_remaining_timer_minutes(i);
-            cJSON_AddNumberToObject(output, "timer_remaining", remaining);
-            cJSON_AddNumberToObject(output, "timer_duration", output_timers[i].duration_minutes);
+        if (timer.count > 0) {
+            cJSON_AddNumberToObject(output, "timer_remaining", (timer.next_remaining_ms + 59999) / 60000);
+            cJSON_AddNumberToObject(output, "timer_duration", (timer.next_duration_ms + 59999) / 60000);
         } else {
             cJSON_AddNumberToObject(output, "timer_remaining", 0);
             cJSON_AddNumberToObject(output, "timer_duration", 0);
@@ -570,22 +635,123 @@ static esp_err_t status_handler(httpd_req_t *req)
     }
     
     cJSON_AddItemToObject(json, "outputs", outputs);
+    
+    // Inputs: debounced level, or pulse count and rate for counter inputs
+    cJSON *inputs = cJSON_CreateArray();
+    uint32_t input_bits = input_debounce_get_state();
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        cJSON *input = cJSON_CreateObject();
+        cJSON_AddNumberToObject(input, "id", i + 1);
+        
+        input_counter_info_t counter;
+        input_counter_get_info(i, &counter);
+        if (counter.source != INPUT_COUNTER_NONE) {
+            cJSON_AddStringToObject(input, "mode", counter.source == INPUT_COUNTER_PCNT ? "pcnt" : "isr_counter");
+            cJSON_AddNumberToObject(input, "count", counter.count);
+            cJSON_AddNumberToObject(input, "frequency_hz", counter.frequency_mhz / 1000.0);
+            cJSON_AddBoolToObject(input, "rate_active", counter.rate_active);
+        } else {
+            cJSON_AddStringToObject(input, "mode", "level");
+            cJSON_AddBoolToObject(input, "active", (input_bits & (1UL << i)) != 0);
+            
+            input_storm_info_t storm;
+            input_storm_get_info(i, &storm);
+            cJSON_AddBoolToObject(input, "storm_masked", storm.masked);
+            cJSON_AddNumberToObject(input, "storm_count", storm.storm_count);
+        }
+        
+        cJSON_AddItemToArray(inputs, input);
+    }
+    cJSON_AddItemToObject(json, "inputs", inputs);
     cJSON_AddStringToObject(json, "status", "ok");
-    cJSON_AddNumberToObject(json, "timestamp", esp_timer_get_time() / 1000000);
+    cJSON_AddNumberToObject(json, "timestamp", time_base_now_us() / 1000000);
     
     // Add system information for real-time corner
     cJSON *system_info = cJSON_CreateObject();
     cJSON_AddNumberToObject(system_info, "free_heap", heap_caps_get_free_size(MALLOC_CAP_8BIT));
-    cJSON_AddNumberToObject(system_info, "uptime_seconds", esp_timer_get_time() / 1000000);
+    cJSON_AddNumberToObject(system_info, "uptime_seconds", time_base_now_us() / 1000000);
     cJSON_AddNumberToObject(system_info, "total_requests", server_stats.total_requests);
     cJSON_AddBoolToObject(system_info, "wifi_connected", wifi_config_is_connected());
     
     // Count active timers
-    int active_timers = 0;
-    for (int i = 0; i < NUM_OUTPUTS; i++) {
-        if (output_timers[i].is_active) active_timers++;
+    cJSON_AddNumberToObject(system_info, "active_timers", timer_wheel_active_count());
+    
+    // Input edge ring health
+    input_ring_stats_t ring_stats;
+    input_ring_get_stats(&ring_stats);
+    cJSON_AddNumberToObject(system_info, "input_edges", ring_stats.pushed);
+    cJSON_AddNumberToObject(system_info, "input_edges_dropped", ring_stats.overflows);
+    cJSON_AddNumberToObject(system_info, "input_ring_high_water", ring_stats.high_water);
+    cJSON_AddNumberToObject(system_info, "storm_masked_inputs", input_storm_get_mask());
+    
+    // Edge-to-debounced latency beyond DEBOUNCE_TIME_MS
+    debounce_latency_stats_t latency;
+    input_debounce_get_latency(&latency);
+    cJSON *debounce_info = cJSON_CreateObject();
+    cJSON_AddNumberToObject(debounce_info, "samples", latency.samples);
+    cJSON_AddNumberToObject(debounce_info, "excess_min_us", latency.min_us);
+    cJSON_AddNumberToObject(debounce_info, "excess_max_us", latency.max_us);
+    cJSON *hist = cJSON_CreateArray();
+    for (int i = 0; i < DEBOUNCE_HIST_BUCKETS; i++) {
+        cJSON_AddItemToArray(hist, cJSON_CreateNumber(latency.buckets[i]));
     }
-    cJSON_AddNumberToObject(system_info, "active_timers", active_timers);
+    cJSON_AddItemToObject(debounce_info, "histogram", hist);
+    cJSON_AddItemToObject(system_info, "debounce", debounce_info);
+    
+    // PLC scan cycle timing
+    scan_stats_t scan;
+    scan_cycle_get_stats(&scan);
+    cJSON *scan_info = cJSON_CreateObject();
+    cJSON_AddNumberToObject(scan_info, "period_us", scan.period_us);
+    cJSON_AddNumberToObject(scan_info, "count", scan.scan_count);
+    cJSON_AddNumberToObject(scan_info, "min_us", scan.min_us);
+    cJSON_AddNumberToObject(scan_info, "avg_us", scan.avg_us);
+    cJSON_AddNumberToObject(scan_info, "max_us", scan.max_us);
+    cJSON_AddNumberToObject(scan_info, "overruns", scan.overruns);
+    cJSON_AddBoolToObject(scan_info, "tick_running", scan.tick_running);
+    cJSON_AddNumberToObject(scan_info, "tick_scans", scan.tick_scans);
+    cJSON_AddNumberToObject(scan_info, "input_scans", scan.input_scans);
+    cJSON_AddNumberToObject(scan_info, "command_scans", scan.command_scans);
+    cJSON_AddNumberToObject(scan_info, "timer_scans", scan.timer_scans);
+    cJSON_AddItemToObject(system_info, "scan", scan_info);
+    
+    output_sched_stats_t sched;
+    output_sched_get_stats(&sched);
+    cJSON *sched_info = cJSON_CreateObject();
+    cJSON_AddBoolToObject(sched_info, "enabled", sched.enabled);
+    cJSON_AddBoolToObject(sched_info, "signal_ok", sched.signal_ok);
+    cJSON_AddNumberToObject(sched_info, "crossings", sched.zero_crossings);
+    cJSON_AddNumberToObject(sched_info, "crossing_rate_hz", sched.crossing_rate_mhz / 1000.0);
+    cJSON_AddNumberToObject(sched_info, "scheduled", sched.scheduled);
+    cJSON_AddNumberToObject(sched_info, "latency_min_us", sched.latency_min_us);
+    cJSON_AddNumberToObject(sched_info, "latency_avg_us", sched.latency_avg_us);
+    cJSON_AddNumberToObject(sched_info, "latency_max_us", sched.latency_max_us);
+    cJSON_AddNumberToObject(sched_info, "missed_windows", sched.missed_windows);
+    cJSON_AddNumberToObject(sched_info, "fallbacks", sched.fallbacks);
+    cJSON_AddItemToObject(system_info, "zero_cross", sched_info);
+    
+    schedule_status_t schedule;
+    schedule_get_status(&schedule);
+    cJSON *schedule_info = cJSON_CreateObject();
+    cJSON_AddStringToObject(schedule_info, "time_source", schedule_time_source_name(schedule.source));
+    cJSON_AddNumberToObject(schedule_info, "scheduled_outputs", schedule.active_mask);
+    cJSON_AddNumberToObject(schedule_info, "scheduled_on", schedule.on_bits);
+    cJSON_AddNumberToObject(schedule_info, "next_transition", (double)schedule.next_transition);
+    cJSON_AddItemToObject(system_info, "schedule", schedule_info);
+    
+    logic_vm_status_t logic;
+    logic_vm_get_status(&logic);
+    cJSON *logic_info = cJSON_CreateObject();
+    cJSON_AddBoolToObject(logic_info, "loaded", logic.loaded);
+    cJSON_AddNumberToObject(logic_info, "instructions", logic.insn_count);
+    cJSON_AddNumberToObject(logic_info, "outputs", logic.out_mask);
+    cJSON_AddNumberToObject(logic_info, "ops", logic.thread_ops);
+    cJSON_AddNumberToObject(logic_info, "code_bytes", logic.code_bytes);
+    cJSON_AddNumberToObject(logic_info, "evaluated", logic.evaluated);
+    cJSON_AddNumberToObject(logic_info, "scan_us", logic.last_us);
+    cJSON_AddNumberToObject(logic_info, "scan_avg_us", logic.avg_us);
+    cJSON_AddNumberToObject(logic_info, "scan_max_us", logic.max_us);
+    cJSON_AddItemToObject(system_info, "logic", logic_info);
     
     cJSON_AddItemToObject(json, "system", system_info);
     
@@ -616,10 +782,10 @@ static esp_err_t toggle_handler(httpd_req_t *req)
         ESP_LOGI(TAG, "Parsed output number: %d (from URI: %s)", output_num, req->uri);
         
         if (output_num >= 0 && output_num < NUM_OUTPUTS) {
-            bool new_state = !output_states[output_num];
+            bool new_state = !output_image_get_state(output_num);
             ESP_LOGI(TAG, "Toggling Output %d from %s to %s", 
                      output_num + 1, 
-                     output_states[output_num] ? "ON" : "OFF",
+                     new_state ? "OFF" : "ON",
                      new_state ? "ON" : "OFF");
             
             web_set_output(output_num, new_state);
@@ -653,31 +819,53 @@ static esp_err_t timer_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
     
-    cJSON *minutes_json = cJSON_GetObjectItem(json, "minutes");
-    if (!cJSON_IsNumber(minutes_json)) {
+    const char* uri = req->uri;
+    char* output_num_str = strstr(uri, "/output/");
+    int output_num = output_num_str ? atoi(output_num_str + 8) - 1 : -1;
+    if (output_num < 0 || output_num >= NUM_OUTPUTS) {
         cJSON_Delete(json);
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid minutes");
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid output");
         return ESP_FAIL;
     }
     
-    int minutes = (int)cJSON_GetNumberValue(minutes_json);
-    cJSON_Delete(json);
-    
-    const char* uri = req->uri;
-    char* output_num_str = strstr(uri, "/output/");
-    if (output_num_str) {
-        output_num_str += 8;
-        int output_num = atoi(output_num_str) - 1;
+    // {"minutes": n} is the original ON-for-n-minutes timer
+    cJSON *minutes_json = cJSON_GetObjectItem(json, "minutes");
+    if (cJSON_IsNumber(minutes_json)) {
+        int minutes = (int)cJSON_GetNumberValue(minutes_json);
+        cJSON_Delete(json);
         
-        if (output_num >= 0 && output_num < NUM_OUTPUTS && minutes > 0 && minutes <= MAX_TIMER_DURATION_MINUTES) {
+        if (minutes > 0 && minutes <= MAX_TIMER_DURATION_MINUTES) {
             web_set_output_timer(output_num, minutes);
             httpd_resp_send(req, "OK", 2);
             return ESP_OK;
         }
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid minutes");
+        return ESP_FAIL;
     }
     
-    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid parameters");
-    return ESP_FAIL;
+    // {"type": "pulse|on_delay|off_delay|cycle", "on_s": x, "off_s": y}
+    cJSON *type_json = cJSON_GetObjectItem(json, "type");
+    cJSON *on_json = cJSON_GetObjectItem(json, "on_s");
+    cJSON *off_json = cJSON_GetObjectItem(json, "off_s");
+    int type = cJSON_IsString(type_json) ? output_timer_type_from_name(cJSON_GetStringValue(type_json)) : -1;
+    double on_s = cJSON_IsNumber(on_json) ? cJSON_GetNumberValue(on_json) : 0;
+    double off_s = cJSON_IsNumber(off_json) ? cJSON_GetNumberValue(off_json) : 0;
+    cJSON_Delete(json);
+    
+    int timer_id = -1;
+    if (type >= 0 && on_s > 0 && on_s * 1000 <= TIMER_WHEEL_MAX_MS && off_s >= 0 && off_s * 1000 <= TIMER_WHEEL_MAX_MS) {
+        timer_id = output_timer_start(output_num, type, (uint32_t)(on_s * 1000), (uint32_t)(off_s * 1000));
+    }
+    if (timer_id < 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid timer");
+        return ESP_FAIL;
+    }
+    
+    char response[32];
+    snprintf(response, sizeof(response), "{\"id\":%d}", timer_id);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, response);
+    return ESP_OK;
 }
 
 static esp_err_t cancel_timer_handler(httpd_req_t *req)
@@ -699,6 +887,69 @@ static esp_err_t cancel_timer_handler(httpd_req_t *req)
     return ESP_FAIL;
 }
 
+static esp_err_t duty_handler(httpd_req_t *req)
+{
+    char content[100];
+    size_t content_len = req->content_len < sizeof(content) - 1 ? req->content_len : sizeof(content) - 1;
+    
+    int received = httpd_req_recv(req, content, content_len);
+    if (received <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
+        return ESP_FAIL;
+    }
+    content[received] = '\0';
+    
+    const char* uri = req->uri;
+    char* output_num_str = strstr(uri, "/output/");
+    int output_num = output_num_str ? atoi(output_num_str + 8) - 1 : -1;
+    if (output_num < 0 || output_num >= NUM_OUTPUTS) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid output");
+        return ESP_FAIL;
+    }
+    
+    cJSON *json = cJSON_Parse(content);
+    if (!json) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+    
+    // Start from the current settings so partial updates are allowed;
+    // setting a duty without a mode switches to time-proportional
+    output_duty_config_t config;
+    output_duty_get(output_num, &config);
+    
+    cJSON *duty_json = cJSON_GetObjectItem(json, "duty");
+    if (cJSON_IsNumber(duty_json)) {
+        double duty = cJSON_GetNumberValue(duty_json);
+        config.duty_permille = (duty < 0 || duty > 100) ? OUTPUT_DUTY_MAX + 1 : (uint16_t)(duty * 10 + 0.5);
+        if (config.mode == OUTPUT_MODE_ONOFF) {
+            config.mode = OUTPUT_MODE_TIME_PROP;
+        }
+    }
+    cJSON *cycle_json = cJSON_GetObjectItem(json, "cycle_s");
+    if (cJSON_IsNumber(cycle_json)) {
+        int cycle_s = (int)cJSON_GetNumberValue(cycle_json);
+        config.cycle_s = (cycle_s < 0 || cycle_s > 255) ? 0 : (uint8_t)cycle_s;
+    }
+    cJSON *mode_json = cJSON_GetObjectItem(json, "mode");
+    if (cJSON_IsString(mode_json)) {
+        int mode = output_duty_mode_from_name(cJSON_GetStringValue(mode_json));
+        config.mode = mode < 0 ? OUTPUT_MODE_COUNT : (uint8_t)mode;
+    }
+    cJSON_Delete(json);
+    
+    if (output_duty_set(output_num, &config) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid duty settings");
+        return ESP_FAIL;
+    }
+    // A duty output runs inside its scheduled window, so re-claim it
+    schedule_refresh();
+    scan_cycle_notify(SCAN_EVENT_COMMAND);
+    
+    httpd_resp_send(req, "OK", 2);
+    return ESP_OK;
+}
+
 static esp_err_t settings_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "Settings page request from %s", get_client_ip(req));
@@ -791,6 +1042,61 @@ static esp_err_t settings_handler(httpd_req_t *req)
     
     httpd_resp_send_chunk(req, wifi_form, strlen(wifi_form));
     
+    // Input debounce profiles, filled in from /api/inputs/config
+    const char *profile_form = 
+        "<h2>Input Debounce Profiles</h2>"
+        "<div id='profiles'>Loading...</div>"
+        "<div id='profile_status'></div>";
+    
+    httpd_resp_send_chunk(req, profile_form, strlen(profile_form));
+    
+    const char *profile_js = 
+        "<script>"
+        "function loadProfiles(){"
+        "fetch('/api/inputs/config').then(r=>r.json()).then(list=>{"
+        "let h='<table><tr><th>Input</th><th>ms</th><th>Active</th><th>Filter</th><th>Samples</th><th></th></tr>';"
+        "list.forEach(p=>{"
+        "h+='<tr><td>IN'+p.id+'</td>'"
+        "+'<td><input id=\"ms'+p.id+'\" type=\"number\" min=\"2\" max=\"5000\" value=\"'+p.debounce_ms+'\" style=\"width:70px\"></td>'"
+        "+'<td><select id=\"al'+p.id+'\"><option value=\"1\"'+(p.active_low?' selected':'')+'>Low</option>'"
+        "+'<option value=\"0\"'+(p.active_low?'':' selected')+'>High</option></select></td>'"
+        "+'<td><select id=\"f'+p.id+'\">'+['integrating','lockout','majority'].map(f=>'<option'+(f==p.filter?' selected':'')+'>'+f+'</option>').join('')+'</select></td>'"
+        "+'<td><input id=\"n'+p.id+'\" type=\"number\" min=\"3\" max=\"7\" step=\"2\" value=\"'+p.samples+'\" style=\"width:50px\"></td>'"
+        "+'<td><button type=\"button\" onclick=\"saveProfile('+p.id+')\">Save</button></td></tr>';});"
+        "document.getElementById('profiles').innerHTML=h+'</table>';"
+        "}).catch(e=>{document.getElementById('profiles').innerHTML='Failed to load profiles';});}"
+        "function saveProfile(id){"
+        "const body={id:id,"
+        "debounce_ms:parseInt(document.getElementById('ms'+id).value),"
+        "active_low:document.getElementById('al'+id).value=='1',"
+        "filter:document.getElementById('f'+id).value,"
+        "samples:parseInt(document.getElementById('n'+id).value)};"
+        "fetch('/api/inputs/config',{method:'POST',headers:{'Content-Type':'application/json'},body:JSON.stringify(body)})"
+        ".then(r=>{document.getElementById('profile_status').innerHTML=r.ok?"
+        "'<div class=\"status success\">IN'+id+' saved</div>':'<div class=\"status error\">Invalid profile for IN'+id+'</div>';})"
+        ".catch(e=>{document.getElementById('profile_status').innerHTML='<div class=\"status error\">Request failed</div>';});}"
+        "loadProfiles();"
+        "</script>";
+    
+    httpd_resp_send_chunk(req, profile_js, strlen(profile_js));
+    
+    // Structured-text logic, compiled on the board by /api/logic
+    const char *logic_form = 
+        "<h2>Logic Expressions</h2>"
+        "<textarea id='st' rows='6' style='width:100%;font-family:monospace' "
+        "placeholder='OUT2 = IN1 &amp; !IN3 | (T1.Q &amp; IN5)'></textarea>"
+        "<button type='button' onclick='uploadLogic()'>Upload Logic</button>"
+        "<div id='logic_status'></div>"
+        "<script>"
+        "function uploadLogic(){"
+        "fetch('/api/logic',{method:'POST',headers:{'Content-Type':'text/plain'},body:document.getElementById('st').value})"
+        ".then(r=>r.text().then(t=>{document.getElementById('logic_status').innerHTML=r.ok?"
+        "'<div class=\"status success\">Logic installed</div>':'<div class=\"status error\">'+t+'</div>';}))"
+        ".catch(e=>{document.getElementById('logic_status').innerHTML='<div class=\"status error\">Request failed</div>';});}"
+        "</script>";
+    
+    httpd_resp_send_chunk(req, logic_form, strlen(logic_form));
+    
     // JavaScript and closing tags
     const char *settings_js = 
         "<script>"
@@ -952,6 +1258,677 @@ static esp_err_t wifi_reset_handler(httpd_req_t *req)
     return ret;
 }
 
+static esp_err_t capture_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "Edge capture dump request from %s", get_client_ip(req));
+    
+    // Optional query: format=csv|bin, since=<seq>
+    char query[64] = "";
+    char value[16];
+    bool binary = false;
+    uint32_t cursor = 0;
+    
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "format", value, sizeof(value)) == ESP_OK) {
+            binary = (strcmp(value, "bin") == 0);
+        }
+        if (httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+            cursor = strtoul(value, NULL, 10);
+        }
+    }
+    
+    // Snapshot the end so a busy input cannot keep the dump running forever
+    uint32_t end = edge_capture_get_head();
+    if (end - cursor > EDGE_CAPTURE_SIZE) {
+        cursor = end - EDGE_CAPTURE_SIZE;
+    }
+    
+    httpd_resp_set_type(req, binary ? "application/octet-stream" : "text/csv");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    
+    esp_err_t ret = ESP_OK;
+    if (!binary) {
+        ret = httpd_resp_sendstr_chunk(req, "seq,timestamp_us,input,level\n");
+    }
+    
+    // Stream in small batches; nothing is allocated on the heap and the
+    // buffers stay small enough for the 4 KB httpd stack
+    edge_capture_entry_t entries[CAPTURE_BATCH];
+    char line_buf[CAPTURE_BATCH * 40];
+    size_t total_entries = 0;
+    
+    while (ret == ESP_OK && (int32_t)(end - cursor) > 0) {
+        size_t count = edge_capture_read(&cursor, end, entries, CAPTURE_BATCH);
+        if (count == 0) {
+            // Everything left before end was overwritten while we read it
+            break;
+        }
+        total_entries += count;
+        
+        if (binary) {
+            ret = httpd_resp_send_chunk(req, (const char *)entries, count * sizeof(edge_capture_entry_t));
+        } else {
+            size_t len = 0;
+            for (size_t i = 0; i < count; i++) {
+                len += snprintf(line_buf + len, sizeof(line_buf) - len, "%lu,%lld,%u,%u\n",
+                                entries[i].seq, entries[i].timestamp_us,
+                                entries[i].input_num + 1, entries[i].level);
+            }
+            ret = httpd_resp_send_chunk(req, line_buf, len);
+        }
+    }
+    
+    if (ret == ESP_OK) {
+        ret = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    
+    ESP_LOGI(TAG, "Edge capture dump sent: %zu edges (%s)", total_entries, binary ? "bin" : "csv");
+    return ret;
+}
+
+static esp_err_t input_config_get_handler(httpd_req_t *req)
+{
+    cJSON *json = cJSON_CreateArray();
+    
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        input_profile_t profile;
+        input_profile_get(i, &profile);
+        
+        cJSON *input = cJSON_CreateObject();
+        cJSON_AddNumberToObject(input, "id", i + 1);
+        cJSON_AddNumberToObject(input, "debounce_ms", profile.debounce_ms);
+        cJSON_AddBoolToObject(input, "active_low", profile.active_low);
+        cJSON_AddStringToObject(input, "filter", input_profile_filter_name(profile.filter));
+        cJSON_AddNumberToObject(input, "samples", profile.samples);
+        cJSON_AddItemToArray(json, input);
+    }
+    
+    char *json_string = cJSON_Print(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    esp_err_t ret = httpd_resp_send(req, json_string, strlen(json_string));
+    
+    free(json_string);
+    cJSON_Delete(json);
+    return ret;
+}
+
+static esp_err_t input_config_set_handler(httpd_req_t *req)
+{
+    char content[160];
+    size_t content_len = req->content_len < sizeof(content) - 1 ? req->content_len : sizeof(content) - 1;
+    
+    int received = httpd_req_recv(req, content, content_len);
+    if (received <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
+        return ESP_FAIL;
+    }
+    content[received] = '\0';
+    
+    cJSON *json = cJSON_Parse(content);
+    if (!json) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+    
+    cJSON *id_json = cJSON_GetObjectItem(json, "id");
+    if (!cJSON_IsNumber(id_json)) {
+        cJSON_Delete(json);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid input id");
+        return ESP_FAIL;
+    }
+    int input_num = (int)cJSON_GetNumberValue(id_json) - 1;
+    
+    // Start from the current profile so partial updates are allowed
+    input_profile_t profile = {0};
+    input_profile_get(input_num, &profile);
+    
+    cJSON *item = cJSON_GetObjectItem(json, "debounce_ms");
+    if (cJSON_IsNumber(item)) {
+        profile.debounce_ms = (uint16_t)cJSON_GetNumberValue(item);
+    }
+    item = cJSON_GetObjectItem(json, "active_low");
+    if (cJSON_IsBool(item)) {
+        profile.active_low = cJSON_IsTrue(item);
+    }
+    item = cJSON_GetObjectItem(json, "samples");
+    if (cJSON_IsNumber(item)) {
+        profile.samples = (uint8_t)cJSON_GetNumberValue(item);
+    }
+    item = cJSON_GetObjectItem(json, "filter");
+    if (cJSON_IsString(item)) {
+        int filter = input_profile_filter_from_name(cJSON_GetStringValue(item));
+        profile.filter = filter < 0 ? INPUT_FILTER_COUNT : (uint8_t)filter;
+    }
+    cJSON_Delete(json);
+    
+    esp_err_t err = input_profile_set(input_num, &profile);
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid profile");
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Input %d profile applied but not saved: %s", input_num + 1, esp_err_to_name(err));
+    }
+    
+    httpd_resp_send(req, "OK", 2);
+    return ESP_OK;
+}
+
+static esp_err_t audit_handler(httpd_req_t *req)
+{
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "enabled", hotpath_audit_enabled());
+    
+    if (hotpath_audit_enabled()) {
+        cJSON *stages = cJSON_CreateArray();
+        for (int i = 0; i < HOTPATH_STAGE_COUNT; i++) {
+            hotpath_stage_stats_t stats;
+            hotpath_audit_get_stats(i, &stats);
+            
+            cJSON *stage = cJSON_CreateObject();
+            cJSON_AddStringToObject(stage, "stage", hotpath_audit_stage_name(i));
+            cJSON_AddNumberToObject(stage, "count", stats.count);
+            cJSON_AddNumberToObject(stage, "min_ns", stats.min_ns);
+            cJSON_AddNumberToObject(stage, "avg_ns", stats.avg_ns);
+            cJSON_AddNumberToObject(stage, "max_ns", stats.max_ns);
+            cJSON_AddNumberToObject(stage, "allocs", stats.allocs);
+            cJSON_AddNumberToObject(stage, "alloc_bytes", stats.alloc_bytes);
+            cJSON_AddItemToArray(stages, stage);
+        }
+        cJSON_AddItemToObject(json, "stages", stages);
+        
+        cJSON *stack = cJSON_CreateObject();
+        cJSON_AddNumberToObject(stack, "input_task", hotpath_audit_stack_free("input_task"));
+        cJSON_AddNumberToObject(stack, "scan_task", hotpath_audit_stack_free("scan_task"));
+        cJSON_AddItemToObject(json, "stack_free_bytes", stack);
+    }
+    
+    char *json_string = cJSON_Print(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    esp_err_t ret = httpd_resp_send(req, json_string, strlen(json_string));
+    
+    free(json_string);
+    cJSON_Delete(json);
+    return ret;
+}
+
+// "HH:MM" to minutes after midnight, -1 if malformed
+static int parse_hhmm(const char *text)
+{
+    int hours, minutes;
+    if (text == NULL || sscanf(text, "%d:%d", &hours, &minutes) != 2 ||
+        hours < 0 || hours > 23 || minutes < 0 || minutes > 59) {
+        return -1;
+    }
+    return hours * 60 + minutes;
+}
+
+static esp_err_t schedule_get_handler(httpd_req_t *req)
+{
+    schedule_status_t status;
+    schedule_get_status(&status);
+    char tz[SCHEDULE_TZ_MAX_LEN];
+    schedule_get_timezone(tz, sizeof(tz));
+    
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "time_source", schedule_time_source_name(status.source));
+    cJSON_AddNumberToObject(json, "time", (double)time(NULL));
+    cJSON_AddStringToObject(json, "tz", tz);
+    cJSON_AddNumberToObject(json, "next_transition", (double)status.next_transition);
+    
+    schedule_rule_t rules[SCHEDULE_MAX_RULES];
+    int count = schedule_get_rules(rules, SCHEDULE_MAX_RULES);
+    cJSON *rule_array = cJSON_CreateArray();
+    for (int i = 0; i < count; i++) {
+        char on[6], off[6];
+        snprintf(on, sizeof(on), "%02d:%02d", rules[i].on_min / 60, rules[i].on_min % 60);
+        snprintf(off, sizeof(off), "%02d:%02d", rules[i].off_min / 60, rules[i].off_min % 60);
+        
+        cJSON *rule = cJSON_CreateObject();
+        cJSON_AddNumberToObject(rule, "output", rules[i].output + 1);
+        cJSON_AddNumberToObject(rule, "days", rules[i].days);
+        cJSON_AddStringToObject(rule, "on", on);
+        cJSON_AddStringToObject(rule, "off", off);
+        cJSON_AddBoolToObject(rule, "enabled", rules[i].enabled);
+        cJSON_AddItemToArray(rule_array, rule);
+    }
+    cJSON_AddItemToObject(json, "rules", rule_array);
+    
+    char *json_string = cJSON_Print(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    esp_err_t ret = httpd_resp_send(req, json_string, strlen(json_string));
+    
+    free(json_string);
+    cJSON_Delete(json);
+    return ret;
+}
+
+static esp_err_t schedule_set_handler(httpd_req_t *req)
+{
+    // A full rule table is too big for the httpd stack
+    if (req->content_len == 0 || req->content_len > SCHEDULE_MAX_BODY) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid body size");
+        return ESP_FAIL;
+    }
+    
+    char *content = malloc(req->content_len + 1);
+    if (content == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    
+    int received = httpd_req_recv(req, content, req->content_len);
+    if (received <= 0) {
+        free(content);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
+        return ESP_FAIL;
+    }
+    content[received] = '\0';
+    
+    cJSON *json = cJSON_Parse(content);
+    free(content);
+    if (!json) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+    
+    cJSON *tz_json = cJSON_GetObjectItem(json, "tz");
+    if (cJSON_IsString(tz_json) && schedule_set_timezone(cJSON_GetStringValue(tz_json)) == ESP_ERR_INVALID_ARG) {
+        cJSON_Delete(json);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid timezone");
+        return ESP_FAIL;
+    }
+    
+    // Rules are optional so the timezone can be changed on its own
+    cJSON *rule_array = cJSON_GetObjectItem(json, "rules");
+    if (cJSON_IsArray(rule_array)) {
+        schedule_rule_t rules[SCHEDULE_MAX_RULES];
+        int count = 0;
+        bool valid = cJSON_GetArraySize(rule_array) <= SCHEDULE_MAX_RULES;
+        
+        cJSON *item;
+        cJSON_ArrayForEach(item, rule_array) {
+            if (!valid) {
+                break;
+            }
+            cJSON *output = cJSON_GetObjectItem(item, "output");
+            cJSON *days = cJSON_GetObjectItem(item, "days");
+            cJSON *enabled = cJSON_GetObjectItem(item, "enabled");
+            int on_min = parse_hhmm(cJSON_GetStringValue(cJSON_GetObjectItem(item, "on")));
+            int off_min = parse_hhmm(cJSON_GetStringValue(cJSON_GetObjectItem(item, "off")));
+            
+            if (!cJSON_IsNumber(output) || !cJSON_IsNumber(days) || on_min < 0 || off_min < 0) {
+                valid = false;
+                break;
+            }
+            rules[count++] = (schedule_rule_t) {
+                .output = (uint8_t)(cJSON_GetNumberValue(output) - 1),
+                .days = (uint8_t)cJSON_GetNumberValue(days),
+                .on_min = (uint16_t)on_min,
+                .off_min = (uint16_t)off_min,
+                .enabled = !cJSON_IsFalse(enabled)
+            };
+        }
+        
+        esp_err_t err = valid ? schedule_set_rules(rules, count) : ESP_ERR_INVALID_ARG;
+        if (err == ESP_ERR_INVALID_ARG) {
+            cJSON_Delete(json);
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid rules");
+            return ESP_FAIL;
+        } else if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Schedule applied but not saved: %s", esp_err_to_name(err));
+        }
+    }
+    cJSON_Delete(json);
+    
+    httpd_resp_send(req, "OK", 2);
+    return ESP_OK;
+}
+
+static esp_err_t time_set_handler(httpd_req_t *req)
+{
+    char content[64];
+    size_t content_len = req->content_len < sizeof(content) - 1 ? req->content_len : sizeof(content) - 1;
+    
+    int received = httpd_req_recv(req, content, content_len);
+    if (received <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
+        return ESP_FAIL;
+    }
+    content[received] = '\0';
+    
+    cJSON *json = cJSON_Parse(content);
+    if (!json) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+    
+    cJSON *epoch = cJSON_GetObjectItem(json, "epoch");
+    esp_err_t err = cJSON_IsNumber(epoch) ? schedule_set_time((int64_t)cJSON_GetNumberValue(epoch)) : ESP_ERR_INVALID_ARG;
+    cJSON_Delete(json);
+    
+    if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid epoch");
+        return ESP_FAIL;
+    }
+    
+    httpd_resp_send(req, "OK", 2);
+    return ESP_OK;
+}
+
+static esp_err_t retain_get_handler(httpd_req_t *req)
+{
+    retain_stats_t stats;
+    retain_get_stats(&stats);
+    
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "restored_from", retain_source_name(stats.source));
+    cJSON_AddNumberToObject(json, "restored_outputs", stats.restored_outputs);
+    cJSON_AddNumberToObject(json, "restored_manual", stats.restored_manual);
+    cJSON_AddNumberToObject(json, "restored_timers", stats.restored_timers);
+    cJSON_AddNumberToObject(json, "downtime_ms", stats.downtime_ms);
+    cJSON_AddNumberToObject(json, "restore_us", stats.restore_us);
+    cJSON_AddNumberToObject(json, "captures", stats.captures);
+    cJSON_AddNumberToObject(json, "journal_writes", stats.journal_writes);
+    cJSON_AddNumberToObject(json, "journal_errors", stats.journal_errors);
+    
+    cJSON *outputs = cJSON_CreateArray();
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        cJSON *output = cJSON_CreateObject();
+        cJSON_AddNumberToObject(output, "id", i + 1);
+        cJSON_AddStringToObject(output, "policy", retain_policy_name(retain_get_policy(i)));
+        cJSON_AddItemToArray(outputs, output);
+    }
+    cJSON_AddItemToObject(json, "outputs", outputs);
+    
+    char *json_string = cJSON_Print(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    esp_err_t ret = httpd_resp_send(req, json_string, strlen(json_string));
+    
+    free(json_string);
+    cJSON_Delete(json);
+    return ret;
+}
+
+static esp_err_t retain_set_handler(httpd_req_t *req)
+{
+    char content[64];
+    size_t content_len = req->content_len < sizeof(content) - 1 ? req->content_len : sizeof(content) - 1;
+    
+    int received = httpd_req_recv(req, content, content_len);
+    if (received <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
+        return ESP_FAIL;
+    }
+    content[received] = '\0';
+    
+    cJSON *json = cJSON_Parse(content);
+    if (!json) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+    
+    cJSON *id_json = cJSON_GetObjectItem(json, "id");
+    cJSON *policy_json = cJSON_GetObjectItem(json, "policy");
+    int policy = cJSON_IsString(policy_json) ? retain_policy_from_name(cJSON_GetStringValue(policy_json)) : -1;
+    int output_num = cJSON_IsNumber(id_json) ? (int)cJSON_GetNumberValue(id_json) - 1 : -1;
+    cJSON_Delete(json);
+    
+    if (policy < 0 || output_num < 0 || output_num >= NUM_OUTPUTS) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid output or policy");
+        return ESP_FAIL;
+    }
+    
+    esp_err_t err = retain_set_policy(output_num, policy);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Output %d retention applied but not saved: %s", output_num + 1, esp_err_to_name(err));
+    }
+    
+    httpd_resp_send(req, "OK", 2);
+    return ESP_OK;
+}
+
+static esp_err_t logic_get_handler(httpd_req_t *req)
+{
+    logic_vm_status_t status;
+    logic_vm_get_status(&status);
+    
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "loaded", status.loaded);
+    cJSON_AddNumberToObject(json, "instructions", status.insn_count);
+    cJSON_AddNumberToObject(json, "outputs", status.out_mask);
+    cJSON_AddNumberToObject(json, "scans", status.scans);
+    cJSON_AddNumberToObject(json, "scan_us", status.last_us);
+    cJSON_AddNumberToObject(json, "scan_avg_us", status.avg_us);
+    cJSON_AddNumberToObject(json, "evaluated", status.evaluated);
+    cJSON_AddNumberToObject(json, "scan_max_us", status.max_us);
+    
+    // What the optimiser made of the bytecode
+    cJSON *compiled = cJSON_CreateObject();
+    cJSON_AddNumberToObject(compiled, "ops", status.thread_ops);
+    cJSON_AddNumberToObject(compiled, "folded", status.folded);
+    cJSON_AddNumberToObject(compiled, "removed", status.removed);
+    cJSON_AddNumberToObject(compiled, "fused", status.fused);
+    cJSON_AddNumberToObject(compiled, "code_bytes", status.code_bytes);
+    cJSON_AddItemToObject(json, "compiled", compiled);
+    
+    // Live block values, so a program can be followed from the web UI
+    cJSON *timers = cJSON_CreateArray();
+    for (int i = 0; i < LOGIC_MAX_TIMERS; i++) {
+        int32_t elapsed_ms;
+        bool q = logic_vm_get_timer(i, &elapsed_ms);
+        cJSON *timer = cJSON_CreateObject();
+        cJSON_AddBoolToObject(timer, "q", q);
+        cJSON_AddNumberToObject(timer, "et_ms", elapsed_ms);
+        cJSON_AddItemToArray(timers, timer);
+    }
+    cJSON_AddItemToObject(json, "timers", timers);
+    
+    cJSON *counters = cJSON_CreateArray();
+    for (int i = 0; i < LOGIC_MAX_COUNTERS; i++) {
+        int32_t value;
+        bool q = logic_vm_get_counter(i, &value);
+        cJSON *counter = cJSON_CreateObject();
+        cJSON_AddBoolToObject(counter, "q", q);
+        cJSON_AddNumberToObject(counter, "cv", value);
+        cJSON_AddItemToArray(counters, counter);
+    }
+    cJSON_AddItemToObject(json, "counters", counters);
+    
+    uint64_t markers = 0;
+    for (int i = 0; i < LOGIC_MAX_MARKERS; i++) {
+        markers |= (uint64_t)logic_vm_get_marker(i) << i;
+    }
+    char markers_hex[19];
+    snprintf(markers_hex, sizeof(markers_hex), "0x%016llx", (unsigned long long)markers);
+    cJSON_AddStringToObject(json, "markers", markers_hex);
+    
+    char *json_string = cJSON_Print(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    esp_err_t ret = httpd_resp_send(req, json_string, strlen(json_string));
+    
+    free(json_string);
+    cJSON_Delete(json);
+    return ret;
+}
+
+static esp_err_t logic_set_handler(httpd_req_t *req)
+{
+    if (req->content_len == 0 || req->content_len > LOGIC_MAX_BODY) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid body size");
+        return ESP_FAIL;
+    }
+    
+    char *content = malloc(req->content_len + 1);
+    if (content == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    
+    // Large bodies arrive in several chunks
+    size_t total = 0;
+    while (total < req->content_len) {
+        int received = httpd_req_recv(req, content + total, req->content_len - total);
+        if (received <= 0) {
+            free(content);
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
+            return ESP_FAIL;
+        }
+        total += received;
+    }
+    content[total] = '\0';
+    
+    // The compiled program is too big for the httpd stack
+    logic_program_t *program = malloc(sizeof(logic_program_t));
+    if (program == NULL) {
+        free(content);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    
+    // A JSON object carries rungs; anything else is structured text,
+    // compiled straight from the body without building a tree
+    char err[96];
+    esp_err_t ret;
+    if (content[strspn(content, " \t\r\n")] != '{') {
+        ret = logic_st_compile(content, total, program, err, sizeof(err));
+        free(content);
+    } else {
+        cJSON *json = cJSON_Parse(content);
+        free(content);
+        if (!json) {
+            free(program);
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+            return ESP_FAIL;
+        }
+        ret = logic_rules_compile(cJSON_GetObjectItem(json, "rungs"), program, err, sizeof(err));
+        cJSON_Delete(json);
+    }
+    if (ret != ESP_OK) {
+        free(program);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, err);
+        return ESP_FAIL;
+    }
+    
+    ret = logic_vm_install(program);
+    free(program);
+    if (ret == ESP_ERR_INVALID_ARG || ret == ESP_ERR_INVALID_STATE) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Program rejected");
+        return ESP_FAIL;
+    }
+    scan_cycle_notify(SCAN_EVENT_COMMAND);
+    
+    httpd_resp_send(req, "OK", 2);
+    return ESP_OK;
+}
+
+static esp_err_t iomap_get_handler(httpd_req_t *req)
+{
+    io_map_link_t links[IO_MAP_MAX_LINKS];
+    int count = io_map_get_links(links, IO_MAP_MAX_LINKS);
+    
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "enabled", CONTROL_MODE_DIRECT);
+    cJSON_AddNumberToObject(json, "latched", io_map_get_latched());
+    
+    cJSON *link_array = cJSON_CreateArray();
+    for (int i = 0; i < count; i++) {
+        cJSON *link = cJSON_CreateObject();
+        cJSON_AddNumberToObject(link, "input", links[i].input + 1);
+        cJSON_AddNumberToObject(link, "output", links[i].output + 1);
+        cJSON_AddStringToObject(link, "mode", io_map_mode_name(links[i].mode));
+        cJSON_AddBoolToObject(link, "invert", links[i].invert);
+        cJSON_AddItemToArray(link_array, link);
+    }
+    cJSON_AddItemToObject(json, "links", link_array);
+    
+    char *json_string = cJSON_Print(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    esp_err_t ret = httpd_resp_send(req, json_string, strlen(json_string));
+    
+    free(json_string);
+    cJSON_Delete(json);
+    return ret;
+}
+
+static esp_err_t iomap_set_handler(httpd_req_t *req)
+{
+    // A full link table is too big for the httpd stack
+    if (req->content_len == 0 || req->content_len > IO_MAP_MAX_BODY) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid body size");
+        return ESP_FAIL;
+    }
+    
+    char *content = malloc(req->content_len + 1);
+    if (content == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    
+    int received = httpd_req_recv(req, content, req->content_len);
+    if (received <= 0) {
+        free(content);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
+        return ESP_FAIL;
+    }
+    content[received] = '\0';
+    
+    cJSON *json = cJSON_Parse(content);
+    free(content);
+    if (!json) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+    
+    // The whole table is replaced; an empty array unmaps every output
+    cJSON *link_array = cJSON_GetObjectItem(json, "links");
+    io_map_link_t links[IO_MAP_MAX_LINKS];
+    int count = 0;
+    bool valid = cJSON_IsArray(link_array) && cJSON_GetArraySize(link_array) <= IO_MAP_MAX_LINKS;
+    
+    cJSON *item;
+    cJSON_ArrayForEach(item, link_array) {
+        if (!valid) {
+            break;
+        }
+        cJSON *input = cJSON_GetObjectItem(item, "input");
+        cJSON *output = cJSON_GetObjectItem(item, "output");
+        cJSON *mode_json = cJSON_GetObjectItem(item, "mode");
+        // Mode defaults to level so a plain {input, output} pair works
+        int mode = cJSON_IsString(mode_json) ? io_map_mode_from_name(cJSON_GetStringValue(mode_json)) :
+                   mode_json == NULL ? IO_MAP_LEVEL : -1;
+        
+        if (!cJSON_IsNumber(input) || !cJSON_IsNumber(output) || mode < 0 ||
+            cJSON_GetNumberValue(input) < 1 || cJSON_GetNumberValue(output) < 1) {
+            valid = false;
+            break;
+        }
+        links[count++] = (io_map_link_t) {
+            .input = (uint8_t)(cJSON_GetNumberValue(input) - 1),
+            .output = (uint8_t)(cJSON_GetNumberValue(output) - 1),
+            .mode = (uint8_t)mode,
+            .invert = cJSON_IsTrue(cJSON_GetObjectItem(item, "invert"))
+        };
+    }
+    cJSON_Delete(json);
+    
+    esp_err_t err = valid ? io_map_set_links(links, count) : ESP_ERR_INVALID_ARG;
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid links");
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Input-output links applied but not saved: %s", esp_err_to_name(err));
+    }
+    
+    httpd_resp_send(req, "OK", 2);
+    return ESP_OK;
+}
+
 // Web server task
 void web_server_task(void *pvParameters)
 {
@@ -970,7 +1947,7 @@ void web_server_task(void *pvParameters)
             }
             
             // Manual control is not active, check if output should be turned off
-            if (output_states[i]) {
+            if (output_image_get_state(i)) {
                 ESP_LOGI(TAG, "Turning OFF Output %d (manual control timeout)", i + 1);
                 web_set_output(i, false);
             }
@@ -989,10 +1966,25 @@ esp_err_t start_web_server(void)
         ESP_LOGW(TAG, "Web server is already running");
         return ESP_OK;
     }
+    
+    // Manual-control expiry wakes the scan task through this timer
+    if (deadline_timer == NULL) {
+        esp_timer_create_args_t deadline_args = {
+            .callback = deadline_timer_callback,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "output_deadline"
+        };
+        if (esp_timer_create(&deadline_args, &deadline_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create output deadline timer");
+        }
+        // Manual control restored at boot was set before the timer existed
+        schedule_output_deadline();
+    }
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = WEB_SERVER_PORT;
-    config.max_uri_handlers = 22;  // Reduced: 1+1+15+1+2+2 = 22 handlers needed
+    config.max_uri_handlers = 36;  // 34 registered, with a little headroom
     
     // Optimize for stability
     config.stack_size = 4096;
@@ -1024,7 +2016,7 @@ esp_err_t start_web_server(void)
         
         // Register specific handlers for each output
         for (int i = 1; i <= NUM_OUTPUTS; i++) {
-            char toggle_uri[32], timer_uri[32], cancel_uri[32];
+            char toggle_uri[32], timer_uri[32], cancel_uri[32], duty_uri[32];
             
             // Toggle URI
             snprintf(toggle_uri, sizeof(toggle_uri), "/api/output/%d/toggle", i);
@@ -1058,6 +2050,17 @@ esp_err_t start_web_server(void)
             };
             httpd_register_uri_handler(server, &cancel);
             ESP_LOGI(TAG, "Registered cancel URI: %s", cancel_uri);
+            
+            // Duty URI
+            snprintf(duty_uri, sizeof(duty_uri), "/api/output/%d/duty", i);
+            httpd_uri_t duty = {
+                .uri = strdup(duty_uri),
+                .method = HTTP_POST,
+                .handler = duty_handler,
+                .user_ctx = NULL
+            };
+            httpd_register_uri_handler(server, &duty);
+            ESP_LOGI(TAG, "Registered duty URI: %s", duty_uri);
         }
         
         // Settings page
@@ -1090,6 +2093,124 @@ esp_err_t start_web_server(void)
         httpd_register_uri_handler(server, &wifi_reset_uri);
         ESP_LOGI(TAG, "Registered WiFi reset URI: %s", "/api/wifi/reset");
         
+        // Edge capture dump
+        httpd_uri_t capture_uri = {
+            .uri = "/api/capture",
+            .method = HTTP_GET,
+            .handler = capture_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &capture_uri);
+        ESP_LOGI(TAG, "Registered edge capture URI: %s", "/api/capture");
+        
+        // Input debounce profiles
+        httpd_uri_t input_config_get_uri = {
+            .uri = "/api/inputs/config",
+            .method = HTTP_GET,
+            .handler = input_config_get_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &input_config_get_uri);
+        
+        httpd_uri_t input_config_set_uri = {
+            .uri = "/api/inputs/config",
+            .method = HTTP_POST,
+            .handler = input_config_set_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &input_config_set_uri);
+        ESP_LOGI(TAG, "Registered input config URI: %s", "/api/inputs/config");
+        
+        // Hot path audit breakdown
+        httpd_uri_t audit_uri = {
+            .uri = "/api/audit",
+            .method = HTTP_GET,
+            .handler = audit_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &audit_uri);
+        ESP_LOGI(TAG, "Registered audit URI: %s", "/api/audit");
+        
+        // Weekly output schedules and the manual clock fallback
+        httpd_uri_t schedule_get_uri = {
+            .uri = "/api/schedule",
+            .method = HTTP_GET,
+            .handler = schedule_get_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &schedule_get_uri);
+        
+        httpd_uri_t schedule_set_uri = {
+            .uri = "/api/schedule",
+            .method = HTTP_POST,
+            .handler = schedule_set_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &schedule_set_uri);
+        
+        httpd_uri_t time_set_uri = {
+            .uri = "/api/time",
+            .method = HTTP_POST,
+            .handler = time_set_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &time_set_uri);
+        ESP_LOGI(TAG, "Registered schedule URIs: %s, %s", "/api/schedule", "/api/time");
+        
+        // Output retention policy and restore report
+        httpd_uri_t retain_get_uri = {
+            .uri = "/api/retain",
+            .method = HTTP_GET,
+            .handler = retain_get_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &retain_get_uri);
+        
+        httpd_uri_t retain_set_uri = {
+            .uri = "/api/retain",
+            .method = HTTP_POST,
+            .handler = retain_set_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &retain_set_uri);
+        ESP_LOGI(TAG, "Registered retention URI: %s", "/api/retain");
+        
+        // Logic program for CONTROL_MODE_CUSTOM
+        httpd_uri_t logic_get_uri = {
+            .uri = "/api/logic",
+            .method = HTTP_GET,
+            .handler = logic_get_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &logic_get_uri);
+        
+        httpd_uri_t logic_set_uri = {
+            .uri = "/api/logic",
+            .method = HTTP_POST,
+            .handler = logic_set_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &logic_set_uri);
+        ESP_LOGI(TAG, "Registered logic URI: %s", "/api/logic");
+        
+        // Input-output mapping table for CONTROL_MODE_DIRECT
+        httpd_uri_t iomap_get_uri = {
+            .uri = "/api/iomap",
+            .method = HTTP_GET,
+            .handler = iomap_get_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &iomap_get_uri);
+        
+        httpd_uri_t iomap_set_uri = {
+            .uri = "/api/iomap",
+            .method = HTTP_POST,
+            .handler = iomap_set_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &iomap_set_uri);
+        ESP_LOGI(TAG, "Registered input-output mapping URI: %s", "/api/iomap");
+        
         ESP_LOGI(TAG, "Web server started on port %d", WEB_SERVER_PORT);
         return ESP_OK;
     }
@@ -1121,48 +2242,42 @@ void web_set_output(uint8_t output_num, bool state)
     if (output_num < NUM_OUTPUTS) {
         ESP_LOGI(TAG, "Web: Setting Output %d to %s", output_num + 1, state ? "ON" : "OFF");
         
-        set_output(output_num, state);
-        
-        // Set manual control flag and timeout - very aggressive
-        manual_control_active[output_num] = true;
-        manual_control_timeout[output_num] = esp_timer_get_time() / 1000;
+        // Manual control claims the output until its deadline; the next
+        // scan resolves it against the other sources
+        uint32_t bit = 1UL << output_num;
+        portENTER_CRITICAL(&manual_lock);
+        manual_control_deadline[output_num] = time_deadline_in_ms(MANUAL_CONTROL_TIMEOUT_MS);
+        output_arbiter_request(OUTPUT_ARBITER_MANUAL, bit, state ? bit : 0);
+        portEXIT_CRITICAL(&manual_lock);
         
-        // Also log the current GPIO state for debugging
-        ESP_LOGI(TAG, "Web: Output %d set to %s (Manual control active) - GPIO state: %d", 
-                 output_num + 1, 
-                 state ? "ON" : "OFF",
-                 gpio_get_level(output_gpios[output_num]));
+        schedule_output_deadline();
+        scan_cycle_notify(SCAN_EVENT_COMMAND);
     }
 }
 
 void web_set_output_timer(uint8_t output_num, uint32_t duration_minutes)
 {
     if (output_num < NUM_OUTPUTS && duration_minutes > 0 && duration_minutes <= MAX_TIMER_DURATION_MINUTES) {
-        output_timers[output_num].is_active = true;
-        output_timers[output_num].start_time = esp_timer_get_time() / 1000000;
-        output_timers[output_num].duration_minutes = duration_minutes;
-        output_timers[output_num].output_num = output_num;
-        
-        // Set manual control flag to prevent automatic input control
-        manual_control_active[output_num] = true;
-        manual_control_timeout[output_num] = esp_timer_get_time() / 1000;
-        
-        web_set_output(output_num, true);
-        
-        ESP_LOGI(TAG, "Web: Timer set for Output %d - %lu minutes", output_num + 1, duration_minutes);
+        // A pulse holds the output ON and hands it back to the inputs when it ends
+        if (output_timer_start(output_num, OUTPUT_TIMER_PULSE, duration_minutes * 60000, 0) > 0) {
+            ESP_LOGI(TAG, "Web: Timer set for Output %d - %lu minutes", output_num + 1, duration_minutes);
+        }
     }
 }
 
 void web_cancel_timer(uint8_t output_num)
 {
     if (output_num < NUM_OUTPUTS) {
-        output_timers[output_num].is_active = false;
-        output_timers[output_num].start_time = 0;
-        output_timers[output_num].duration_minutes = 0;
+        output_timer_cancel_output(output_num);
         
-        // Clear manual control flag to allow automatic input control again
-        manual_control_active[output_num] = false;
-        manual_control_timeout[output_num] = 0;
+        // Drop manual control too, so automatic control takes over again
+        portENTER_CRITICAL(&manual_lock);
+        output_arbiter_release(OUTPUT_ARBITER_MANUAL, 1UL << output_num);
+        manual_control_deadline[output_num] = 0;
+        portEXIT_CRITICAL(&manual_lock);
+        
+        schedule_output_deadline();
+        scan_cycle_notify(SCAN_EVENT_COMMAND);
         
         ESP_LOGI(TAG, "Web: Timer cancelled for Output %d", output_num + 1);
     }
@@ -1171,21 +2286,18 @@ void web_cancel_timer(uint8_t output_num)
 bool get_output_state(uint8_t output_num)
 {
     if (output_num < NUM_OUTPUTS) {
-        return output_states[output_num];
+        return output_image_get_state(output_num);
     }
     return false;
 }
 
 uint32_t get_remaining_timer_minutes(uint8_t output_num)
 {
-    if (output_num < NUM_OUTPUTS && output_timers[output_num].is_active) {
-        uint32_t current_time = esp_timer_get_time() / 1000000;
-        uint32_t elapsed_time = current_time - output_timers[output_num].start_time;
-        uint32_t total_duration_seconds = output_timers[output_num].duration_minutes * 60;
-        
-        if (elapsed_time < total_duration_seconds) {
-            uint32_t remaining_seconds = total_duration_seconds - elapsed_time;
-            return (remaining_seconds + 59) / 60; // Round up to next minute
+    if (output_num < NUM_OUTPUTS) {
+        output_timer_info_t timer;
+        output_timer_get_info(output_num, &timer);
+        if (timer.count > 0) {
+            return (timer.next_remaining_ms + 59999) / 60000; // Round up to next minute
         }
     }
     return 0;
@@ -1193,29 +2305,97 @@ uint32_t get_remaining_timer_minutes(uint8_t output_num)
 
 void process_timers(void)
 {
+    // Output timers fire from the timing wheel; only manual control expires here
     for (int i = 0; i < NUM_OUTPUTS; i++) {
-        if (output_timers[i].is_active) {
-            uint32_t current_time = esp_timer_get_time() / 1000000;
-            uint32_t elapsed_time = current_time - output_timers[i].start_time;
-            uint32_t total_duration_seconds = output_timers[i].duration_minutes * 60;
-            
-            if (elapsed_time >= total_duration_seconds) {
-                // Timer expired
-                ESP_LOGI(TAG, "Timer expired for Output %d", i + 1);
-                
-                output_timers[i].is_active = false;
-                output_timers[i].start_time = 0;
-                output_timers[i].duration_minutes = 0;
-                
-                // Turn off the output
-                web_set_output(i, false);
-                
-                // Clear manual control flag
-                manual_control_active[i] = false;
-                manual_control_timeout[i] = 0;
-            }
+        is_manual_control_active(i);
+    }
+    
+    schedule_output_deadline();
+}
+
+static void deadline_timer_callback(void *arg)
+{
+    scan_cycle_notify(SCAN_EVENT_TIMER);
+}
+
+// Arm deadline_timer for the earliest manual-control expiry, so the scan
+// task is woken exactly when an override ends instead of polling
+static void schedule_output_deadline(void)
+{
+    if (deadline_timer == NULL) {
+        return;
+    }
+    
+    time_deadline_t next = INT64_MAX;
+    
+    portENTER_CRITICAL(&manual_lock);
+    uint32_t manual = output_arbiter_get_claims(OUTPUT_ARBITER_MANUAL);
+    for (uint32_t bits = manual; bits; bits &= bits - 1) {
+        int i = __builtin_ctz(bits);
+        if (manual_control_deadline[i] < next) {
+            next = manual_control_deadline[i];
         }
     }
+    portEXIT_CRITICAL(&manual_lock);
+    
+    esp_timer_stop(deadline_timer);
+    if (next != INT64_MAX) {
+        int64_t delay_us = time_deadline_remaining_us(next);
+        esp_timer_start_once(deadline_timer, delay_us > 0 ? delay_us : 1);
+    }
+}
+
+void web_clear_manual_control(uint8_t output_num)
+{
+    if (output_num >= NUM_OUTPUTS) {
+        return;
+    }
+    
+    uint32_t bit = 1UL << output_num;
+    portENTER_CRITICAL(&manual_lock);
+    bool active = (output_arbiter_get_claims(OUTPUT_ARBITER_MANUAL) & bit) != 0;
+    output_arbiter_release(OUTPUT_ARBITER_MANUAL, bit);
+    manual_control_deadline[output_num] = 0;
+    portEXIT_CRITICAL(&manual_lock);
+    
+    if (active) {
+        schedule_output_deadline();
+        scan_cycle_notify(SCAN_EVENT_COMMAND);
+        ESP_LOGI(TAG, "Manual control cleared for Output %d", output_num + 1);
+    }
+}
+
+uint32_t web_get_manual_remaining_ms(uint8_t output_num)
+{
+    if (output_num >= NUM_OUTPUTS) {
+        return 0;
+    }
+    
+    portENTER_CRITICAL(&manual_lock);
+    bool active = (output_arbiter_get_claims(OUTPUT_ARBITER_MANUAL) & (1UL << output_num)) != 0;
+    time_deadline_t deadline = manual_control_deadline[output_num];
+    portEXIT_CRITICAL(&manual_lock);
+    
+    return active ? time_deadline_remaining_ms(deadline) : 0;
+}
+
+void web_restore_manual_control(uint8_t output_num, bool state, uint32_t remaining_ms)
+{
+    if (output_num < NUM_OUTPUTS && remaining_ms > 0) {
+        if (remaining_ms > MANUAL_CONTROL_TIMEOUT_MS) {
+            remaining_ms = MANUAL_CONTROL_TIMEOUT_MS;
+        }
+        
+        // The override ends when it would have without the reset
+        uint32_t bit = 1UL << output_num;
+        portENTER_CRITICAL(&manual_lock);
+        manual_control_deadline[output_num] = time_deadline_in_ms(remaining_ms);
+        output_arbiter_request(OUTPUT_ARBITER_MANUAL, bit, state ? bit : 0);
+        portEXIT_CRITICAL(&manual_lock);
+        
+        schedule_output_deadline();
+        scan_cycle_notify(SCAN_EVENT_COMMAND);
+    }
 }
 
 bool is_manual_control_active(uint8_t output_num)
@@ -1224,20 +2404,23 @@ bool is_manual_control_active(uint8_t output_num)
         return false;
     }
     
-    if (!manual_control_active[output_num]) {
-        return false;
+    // Deadline check and release in one step, so a command arriving
+    // meanwhile is never released with the old deadline
+    uint32_t bit = 1UL << output_num;
+    portENTER_CRITICAL(&manual_lock);
+    bool active = (output_arbiter_get_claims(OUTPUT_ARBITER_MANUAL) & bit) != 0;
+    bool expired = active && time_deadline_passed(manual_control_deadline[output_num]);
+    if (expired) {
+        output_arbiter_release(OUTPUT_ARBITER_MANUAL, bit);
+        manual_control_deadline[output_num] = 0;
     }
+    portEXIT_CRITICAL(&manual_lock);
     
-    // Check timeout
-    uint32_t current_time = esp_timer_get_time() / 1000;
-    if (current_time - manual_control_timeout[output_num] > MANUAL_CONTROL_TIMEOUT_MS) {
-        manual_control_active[output_num] = false;
-        manual_control_timeout[output_num] = 0;
+    if (expired) {
         ESP_LOGI(TAG, "Manual control timeout for Output %d", output_num + 1);
         return false;
     }
-    
-    return true;
+    return active;
 }
 
 void web_server_monitor_task(void *arg)
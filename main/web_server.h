@@ -6,15 +6,8 @@
 
 // Web server configuration
 #define WEB_SERVER_PORT 80
-#define MAX_TIMER_DURATION_MINUTES 1440  // 24 hours max
-
-// Timer structure for outputs
-typedef struct {
-    bool is_active;
-    uint32_t start_time;
-    uint32_t duration_minutes;
-    uint8_t output_num;
-} output_timer_t;
+#define MAX_TIMER_DURATION_MINUTES 10080 // 7 days, within the timing wheel range
+#define MANUAL_CONTROL_TIMEOUT_MS 300000  // 5 minutes timeout for manual control
 
 // Function prototypes
 esp_err_t init_wifi_station(void);
@@ -27,6 +20,12 @@ bool get_output_state(uint8_t output_num);
 uint32_t get_remaining_timer_minutes(uint8_t output_num);
 void process_timers(void);
 bool is_manual_control_active(uint8_t output_num);
+// Hand an output back to automatic control (schedule edges, cancel)
+void web_clear_manual_control(uint8_t output_num);
+// Manual control time left, 0 when the output is not under manual control
+uint32_t web_get_manual_remaining_ms(uint8_t output_num);
+// Put an output back under manual control after a reset
+void web_restore_manual_control(uint8_t output_num, bool state, uint32_t remaining_ms);
 void web_server_monitor_task(void *arg);
 
 // WiFi credentials (you should modify these)